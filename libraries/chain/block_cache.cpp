@@ -0,0 +1,85 @@
+#include <sophiatx/chain/block_cache.hpp>
+
+namespace sophiatx { namespace chain {
+
+template< typename Tag, typename Key >
+optional< signed_block > block_cache::fetch( const Key& key )
+{
+   std::lock_guard< std::mutex > lock( _mtx );
+   optional< signed_block > result;
+
+   auto& idx = _blocks.get< Tag >();
+   auto itr = idx.find( key );
+   if( itr == idx.end() )
+   {
+      ++_misses;
+      return result;
+   }
+
+   ++_hits;
+   _blocks.relocate( _blocks.begin(), _blocks.project< 0 >( itr ) );
+   result = itr->block;
+   return result;
+}
+
+optional< signed_block > block_cache::fetch_by_number( uint32_t block_num )
+{
+   return fetch< by_num >( block_num );
+}
+
+optional< signed_block > block_cache::fetch_by_id( const block_id_type& id )
+{
+   return fetch< by_block_id >( id );
+}
+
+void block_cache::insert( const signed_block& b )
+{
+   std::lock_guard< std::mutex > lock( _mtx );
+   if( _capacity == 0 )
+      return;
+
+   auto inserted = _blocks.push_front( cached_block( b ) );
+   if( inserted.second )
+      _bytes += inserted.first->size;
+   else
+      _blocks.relocate( _blocks.begin(), inserted.first );
+
+   evict();
+}
+
+void block_cache::clear()
+{
+   std::lock_guard< std::mutex > lock( _mtx );
+   _blocks.clear();
+   _bytes = 0;
+}
+
+void block_cache::set_capacity( uint64_t capacity )
+{
+   std::lock_guard< std::mutex > lock( _mtx );
+   _capacity = capacity;
+   evict();
+}
+
+void block_cache::evict()
+{
+   while( _bytes > _capacity )
+   {
+      _bytes -= _blocks.back().size;
+      _blocks.pop_back();
+   }
+}
+
+block_cache_stats block_cache::get_stats()const
+{
+   std::lock_guard< std::mutex > lock( _mtx );
+   block_cache_stats result;
+   result.hits = _hits;
+   result.misses = _misses;
+   result.size = _blocks.size();
+   result.bytes = _bytes;
+   result.capacity = _capacity;
+   return result;
+}
+
+} } // sophiatx::chain
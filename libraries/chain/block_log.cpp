@@ -1,11 +1,28 @@
 #include <sophiatx/chain/block_log.hpp>
+#include <sophiatx/chain/util/bounded_queue.hpp>
+#include <sophiatx/chain/util/file_io.hpp>
 #include <fstream>
+#include <fc/compress/zlib.hpp>
 #include <fc/io/raw.hpp>
 
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/interprocess/sync/scoped_lock.hpp>
 #include <boost/interprocess/sync/lock_options.hpp>
 
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+
 #define LOG_READ  (std::ios::in | std::ios::binary)
 #define LOG_WRITE (std::ios::out | std::ios::binary | std::ios::app)
 
@@ -16,8 +33,175 @@ namespace sophiatx { namespace chain {
    boost::interprocess::defer_lock_type defer_lock;
 
    namespace detail {
+      namespace bip = boost::interprocess;
+
+      /// Start of a compressed block log, followed by the format version and reserved flags (u32 each)
+      const char block_log_magic[ 8 ] = { 'S', 'P', 'H', 'X', 'B', 'L', 'O', 'G' };
+      const uint64_t block_log_header_size = sizeof( block_log_magic ) + 2 * sizeof( uint32_t );
+      /// Compressed records start with the stored size and the packed size of the block (u32 each)
+      const uint64_t block_record_header_size = 2 * sizeof( uint32_t );
+      /// Blocks written synchronously are flushed at the latest after this many appends
+      const size_t max_unflushed_blocks = 1000;
+
+      /** @return the record of the block as written to a block log of given version, without the trailing position */
+      std::vector< char > pack_block_record( const signed_block& b, uint32_t version )
+      {
+         auto packed = fc::raw::pack_to_vector( b );
+         if( version == block_log::legacy_version )
+            return packed;
+
+         auto compressed = fc::zlib_compress( packed.data(), packed.size() );
+         // blocks which do not shrink are stored as they are, the sizes tell them apart
+         bool store_compressed = compressed.size() < packed.size();
+         uint32_t stored_size = store_compressed ? compressed.size() : packed.size();
+         uint32_t packed_size = packed.size();
+
+         std::vector< char > record( block_record_header_size + stored_size );
+         std::memcpy( record.data(), &stored_size, sizeof( stored_size ) );
+         std::memcpy( record.data() + sizeof( stored_size ), &packed_size, sizeof( packed_size ) );
+         std::memcpy( record.data() + block_record_header_size, store_compressed ? compressed.data() : packed.data(), stored_size );
+         return record;
+      }
+
+      /**
+       * Inflates the compressed block record at the start of data
+       * @return the packed block
+       */
+      std::vector< char > read_compressed_block_record( const char* data, uint64_t available, uint64_t& record_size )
+      {
+         FC_ASSERT( available >= block_record_header_size, "Unexpected end of block log" );
+         uint32_t stored_size, packed_size;
+         std::memcpy( &stored_size, data, sizeof( stored_size ) );
+         std::memcpy( &packed_size, data + sizeof( stored_size ), sizeof( packed_size ) );
+         FC_ASSERT( available - block_record_header_size >= stored_size, "Unexpected end of block log" );
+
+         const char* stored = data + block_record_header_size;
+         record_size = block_record_header_size + stored_size;
+
+         if( stored_size == packed_size )
+            return std::vector< char >( stored, stored + stored_size );
+
+         std::vector< char > packed( packed_size );
+         fc::zlib_decompress( stored, stored_size, packed.data(), packed.size() );
+         return packed;
+      }
+
+      /**
+       * Unpacks the block record at the start of data
+       * @return size of the record, without the trailing position
+       */
+      uint64_t unpack_block_record( const char* data, uint64_t available, uint32_t version, signed_block& b )
+      {
+         if( version == block_log::legacy_version )
+         {
+            fc::datastream< const char* > ds( data, available );
+            fc::raw::unpack( ds, b, 0 );
+            return ds.tellp();
+         }
+
+         uint64_t record_size;
+         auto packed = read_compressed_block_record( data, available, record_size );
+         fc::datastream< const char* > ds( packed.data(), packed.size() );
+         fc::raw::unpack( ds, b, 0 );
+         return record_size;
+      }
+
+      struct block_log_append_item
+      {
+         uint32_t             block_num = 0;
+         uint64_t             pos = 0;
+         std::vector< char >  data;
+      };
+
+      struct block_log_unwritten_block
+      {
+         uint64_t             pos = 0;
+         uint64_t             next_pos = 0;
+         signed_block         block;
+      };
+
+      /**
+       * Read only mappings of the block file and the index file. The mapped regions reach beyond the end of the
+       * files, so appended data becomes readable without remapping until the capacity is exhausted.
+       */
+      struct block_log_mapping
+      {
+         block_log_mapping( const fc::path& block_file, const fc::path& index_file, uint64_t block_size, uint64_t index_size )
+            : block_file_mapping( block_file.generic_string().c_str(), bip::read_only ),
+              index_file_mapping( index_file.generic_string().c_str(), bip::read_only ),
+              block_region( block_file_mapping, bip::read_only, 0, capacity_for( block_size ) ),
+              index_region( index_file_mapping, bip::read_only, 0, capacity_for( index_size ) )
+         {}
+
+         static uint64_t capacity_for( uint64_t size )
+         {
+            return size + std::max< uint64_t >( size / 4, 64 * 1024 * 1024 );
+         }
+
+         const char* block_data()const { return static_cast< const char* >( block_region.get_address() ); }
+         const char* index_data()const { return static_cast< const char* >( index_region.get_address() ); }
+
+         bip::file_mapping    block_file_mapping;
+         bip::file_mapping    index_file_mapping;
+         bip::mapped_region   block_region;
+         bip::mapped_region   index_region;
+      };
+
+      /**
+       * Background writer of the block log. Appended blocks are queued together with their precomputed
+       * positions, written through separate file descriptors and synced whenever the queue runs empty.
+       */
+      class block_log_appender {
+         public:
+            /// called with the new sizes of the block file and the index file after a block is written
+            typedef std::function< void( uint64_t, uint64_t ) > written_callback;
+
+            block_log_appender( const fc::path& block_file, const fc::path& index_file, size_t queue_size, uint32_t head_num,
+                                written_callback on_written );
+            ~block_log_appender();
+
+            /** Queues the block, waits while the queue is full */
+            void append( const signed_block& b, uint64_t pos, std::vector< char >&& data );
+
+            void fence();
+
+            /** @return the queued block at given number or position (with the position of the next one), if it has not been written yet */
+            optional< signed_block > find_block( uint32_t block_num )const;
+            optional< std::pair< signed_block, uint64_t > > find_block_at( uint64_t pos )const;
+            uint64_t                 find_block_pos( uint32_t block_num )const;
+
+            uint32_t                 durable_head_num()const;
+            block_log_append_metrics get_metrics()const;
+
+         private:
+            void run();
+            void check_error()const;
+
+            int                                    _block_fd = -1;
+            int                                    _index_fd = -1;
+            util::bounded_queue< block_log_append_item > _queue;
+            written_callback                       _on_written;
+
+            mutable std::mutex                     _mtx;
+            std::condition_variable                _durable_cv;
+            /// Blocks appended but not written yet, by block number
+            std::map< uint32_t, block_log_unwritten_block > _unwritten;
+            uint32_t                               _appended_num = 0;
+            uint32_t                               _durable_num = 0;
+            std::string                            _error;
+            block_log_append_metrics               _metrics;
+
+            std::thread                            _thread;
+      };
+
       class block_log_impl {
          public:
+            ~block_log_impl()
+            {
+               // the appender publishes to the mappings, it has to finish the queued blocks before they go away
+               appender.reset();
+            }
+
             optional< signed_block > head;
             block_id_type            head_id;
             std::fstream             block_stream;
@@ -31,6 +215,120 @@ namespace sophiatx { namespace chain {
 
             boost::mutex             mtx;
 
+            std::unique_ptr< block_log_appender > appender;
+            uint64_t                 append_pos = 0;         ///< end of the block file including queued blocks
+            uint32_t                 flushed_num = 0;        ///< last block flushed when writing synchronously
+
+            /// Blocks written synchronously but not flushed yet, by block number. Readers find them here until
+            /// flush() publishes them through the mapping.
+            std::map< uint32_t, block_log_unwritten_block > unflushed;
+            mutable std::mutex       unflushed_mtx;
+
+            optional< signed_block > find_unflushed( uint32_t block_num )const
+            {
+               std::lock_guard< std::mutex > lock( unflushed_mtx );
+               optional< signed_block > result;
+               auto itr = unflushed.find( block_num );
+               if( itr != unflushed.end() )
+                  result = itr->second.block;
+               return result;
+            }
+
+            optional< std::pair< signed_block, uint64_t > > find_unflushed_at( uint64_t pos )const
+            {
+               std::lock_guard< std::mutex > lock( unflushed_mtx );
+               optional< std::pair< signed_block, uint64_t > > result;
+               for( const auto& item : unflushed )
+               {
+                  if( item.second.pos == pos )
+                  {
+                     result = std::make_pair( item.second.block, item.second.next_pos );
+                     break;
+                  }
+               }
+               return result;
+            }
+
+            uint64_t find_unflushed_pos( uint32_t block_num )const
+            {
+               std::lock_guard< std::mutex > lock( unflushed_mtx );
+               auto itr = unflushed.find( block_num );
+               return itr == unflushed.end() ? block_log::npos : itr->second.pos;
+            }
+
+            /** Flushes the streams and makes the blocks written since the last flush readable through the mapping */
+            void flush_unflushed()
+            {
+               block_stream.flush();
+               index_stream.flush();
+
+               std::lock_guard< std::mutex > lock( unflushed_mtx );
+               if( unflushed.empty() )
+                  return;
+
+               auto last = unflushed.rbegin();
+               publish( last->second.next_pos, uint64_t( last->first ) * sizeof( last->second.pos ) );
+               unflushed.clear();
+            }
+
+            uint32_t                 version = block_log::legacy_version;
+            uint64_t                 first_block_pos = 0;    ///< block records start after the header of the file
+
+            /** Reads the block record at the current position of the block stream, including the trailing position */
+            signed_block read_block_record( uint64_t& pos )
+            {
+               signed_block b;
+               if( version == block_log::legacy_version )
+               {
+                  fc::raw::unpack( block_stream, b, 0 );
+               }
+               else
+               {
+                  std::vector< char > record( block_record_header_size );
+                  block_stream.read( record.data(), record.size() );
+                  uint32_t stored_size;
+                  std::memcpy( &stored_size, record.data(), sizeof( stored_size ) );
+                  record.resize( block_record_header_size + stored_size );
+                  block_stream.read( record.data() + block_record_header_size, stored_size );
+                  unpack_block_record( record.data(), record.size(), version, b );
+               }
+               block_stream.read( (char*)&pos, sizeof( pos ) );
+               return b;
+            }
+
+            /// Readers load the published sizes first and the mapping after them, the writer stores them in
+            /// the opposite order. A replaced mapping stays alive until its last reader releases it.
+            std::shared_ptr< const block_log_mapping > mapping;
+            std::atomic< uint64_t >  block_size{ 0 };         ///< readable bytes of the block file
+            std::atomic< uint64_t >  index_size{ 0 };         ///< readable bytes of the index file
+
+            std::shared_ptr< const block_log_mapping > load_mapping()const
+            {
+               return std::atomic_load( &mapping );
+            }
+
+            void remap( uint64_t new_block_size, uint64_t new_index_size )
+            {
+               std::atomic_store( &mapping, std::shared_ptr< const block_log_mapping >(
+                  std::make_shared< block_log_mapping >( block_file, index_file, new_block_size, new_index_size ) ) );
+               block_size.store( new_block_size, std::memory_order_release );
+               index_size.store( new_index_size, std::memory_order_release );
+            }
+
+            /** Makes the files readable up to given sizes, remaps them when they outgrow the mapped regions */
+            void publish( uint64_t new_block_size, uint64_t new_index_size )
+            {
+               auto current = load_mapping();
+               if( !current || new_block_size > current->block_region.get_size() || new_index_size > current->index_region.get_size() )
+               {
+                  remap( new_block_size, new_index_size );
+                  return;
+               }
+
+               block_size.store( new_block_size, std::memory_order_release );
+               index_size.store( new_index_size, std::memory_order_release );
+            }
+
             inline void check_block_read()
             {
                try
@@ -87,6 +385,179 @@ namespace sophiatx { namespace chain {
                FC_LOG_AND_RETHROW()
             }
       };
+
+      block_log_appender::block_log_appender( const fc::path& block_file, const fc::path& index_file, size_t queue_size, uint32_t head_num,
+                                              written_callback on_written )
+         : _queue( queue_size ), _on_written( std::move( on_written ) ), _appended_num( head_num ), _durable_num( head_num )
+      {
+         _metrics.durable_head = head_num;
+
+         _block_fd = ::open( block_file.generic_string().c_str(), O_WRONLY | O_APPEND );
+         FC_ASSERT( _block_fd >= 0, "Cannot open block log for writing", ("file", block_file) );
+         _index_fd = ::open( index_file.generic_string().c_str(), O_WRONLY | O_APPEND );
+         if( _index_fd < 0 )
+         {
+            ::close( _block_fd );
+            FC_THROW( "Cannot open block log index for writing", ("file", index_file) );
+         }
+
+         _thread = std::thread( [this]() { run(); } );
+      }
+
+      block_log_appender::~block_log_appender()
+      {
+         // writes out everything queued before stopping
+         _queue.close();
+         _thread.join();
+         ::close( _block_fd );
+         ::close( _index_fd );
+      }
+
+      void block_log_appender::append( const signed_block& b, uint64_t pos, std::vector< char >&& data )
+      {
+         check_error();
+
+         block_log_append_item item;
+         item.block_num = b.block_num();
+         item.pos = pos;
+         item.data = std::move( data );
+
+         {
+            std::lock_guard< std::mutex > lock( _mtx );
+            auto& unwritten = _unwritten[ item.block_num ];
+            unwritten.pos = pos;
+            unwritten.next_pos = pos + item.data.size() + sizeof( pos );
+            unwritten.block = b;
+            _appended_num = item.block_num;
+         }
+
+         FC_ASSERT( _queue.push( std::move( item ) ), "Block log appender is closed" );
+
+         std::lock_guard< std::mutex > lock( _mtx );
+         _metrics.max_queue_depth = std::max< uint32_t >( _metrics.max_queue_depth, _queue.size() );
+      }
+
+      void block_log_appender::fence()
+      {
+         std::unique_lock< std::mutex > lock( _mtx );
+         _durable_cv.wait( lock, [&]() { return _durable_num >= _appended_num || !_error.empty(); } );
+         lock.unlock();
+         check_error();
+      }
+
+      optional< signed_block > block_log_appender::find_block( uint32_t block_num )const
+      {
+         std::lock_guard< std::mutex > lock( _mtx );
+         optional< signed_block > result;
+         auto itr = _unwritten.find( block_num );
+         if( itr != _unwritten.end() )
+            result = itr->second.block;
+         return result;
+      }
+
+      optional< std::pair< signed_block, uint64_t > > block_log_appender::find_block_at( uint64_t pos )const
+      {
+         std::lock_guard< std::mutex > lock( _mtx );
+         optional< std::pair< signed_block, uint64_t > > result;
+         for( const auto& item : _unwritten )
+         {
+            if( item.second.pos == pos )
+            {
+               result = std::make_pair( item.second.block, item.second.next_pos );
+               break;
+            }
+         }
+         return result;
+      }
+
+      uint64_t block_log_appender::find_block_pos( uint32_t block_num )const
+      {
+         std::lock_guard< std::mutex > lock( _mtx );
+         auto itr = _unwritten.find( block_num );
+         return itr == _unwritten.end() ? block_log::npos : itr->second.pos;
+      }
+
+      uint32_t block_log_appender::durable_head_num()const
+      {
+         std::lock_guard< std::mutex > lock( _mtx );
+         return _durable_num;
+      }
+
+      block_log_append_metrics block_log_appender::get_metrics()const
+      {
+         std::lock_guard< std::mutex > lock( _mtx );
+         block_log_append_metrics result = _metrics;
+         result.queue_depth = _unwritten.size();
+         return result;
+      }
+
+      void block_log_appender::check_error()const
+      {
+         std::lock_guard< std::mutex > lock( _mtx );
+         FC_ASSERT( _error.empty(), "Block log appender failed: ${e}", ("e", _error) );
+      }
+
+      void block_log_appender::run()
+      {
+         block_log_append_item item;
+         uint32_t written_num = durable_head_num();
+         uint32_t synced_num = written_num;
+         auto synced_at = fc::time_point::now();
+
+         try
+         {
+            while( _queue.pop( item ) )
+            {
+               util::write_all( _block_fd, item.data.data(), item.data.size() );
+               util::write_all( _block_fd, (const char*)&item.pos, sizeof( item.pos ) );
+               util::write_all( _index_fd, (const char*)&item.pos, sizeof( item.pos ) );
+               written_num = item.block_num;
+               _on_written( item.pos + item.data.size() + sizeof( item.pos ), uint64_t( item.block_num ) * sizeof( item.pos ) );
+
+               {
+                  // the block can be read from the files now
+                  std::lock_guard< std::mutex > lock( _mtx );
+                  _unwritten.erase( item.block_num );
+               }
+
+               // syncs once the queue drains, a queue which never drains while catching up is synced periodically
+               // so the durable head and with it the irreversible state keep moving
+               if( _queue.size() && written_num - synced_num < block_log::max_unsynced_blocks
+                   && fc::time_point::now() - synced_at < fc::milliseconds( block_log::max_sync_interval_ms ) )
+                  continue;
+
+               auto start = fc::time_point::now();
+               FC_ASSERT( ::fsync( _block_fd ) == 0 && ::fsync( _index_fd ) == 0, "Error syncing block log: ${e}", ("e", strerror( errno )) );
+               auto latency = fc::time_point::now() - start;
+               synced_num = written_num;
+               synced_at = start;
+
+               {
+                  std::lock_guard< std::mutex > lock( _mtx );
+                  _durable_num = written_num;
+                  _metrics.durable_head = written_num;
+                  _metrics.sync_count++;
+                  _metrics.last_sync_latency = latency;
+                  _metrics.max_sync_latency = std::max( _metrics.max_sync_latency, latency );
+                  _metrics.total_sync_latency += latency;
+               }
+               _durable_cv.notify_all();
+            }
+         }
+         catch( const fc::exception& e )
+         {
+            elog( "Block log appender failed: ${e}", ("e", e.to_detail_string()) );
+            std::lock_guard< std::mutex > lock( _mtx );
+            _error = e.to_string();
+         }
+         catch( const std::exception& e )
+         {
+            elog( "Block log appender failed: ${e}", ("e", e.what()) );
+            std::lock_guard< std::mutex > lock( _mtx );
+            _error = e.what();
+         }
+         _durable_cv.notify_all();
+      }
    }
 
    block_log::block_log()
@@ -101,8 +572,11 @@ namespace sophiatx { namespace chain {
       flush();
    }
 
-   void block_log::open( const fc::path& file )
+   void block_log::open( const fc::path& file, size_t append_queue_size, bool compress )
    {
+      my->appender.reset();
+      my->unflushed.clear();
+
       if( my->block_stream.is_open() )
          my->block_stream.close();
       if( my->index_stream.is_open() )
@@ -137,7 +611,42 @@ namespace sophiatx { namespace chain {
       auto log_size = fc::file_size( my->block_file );
       auto index_size = fc::file_size( my->index_file );
 
-      if( log_size )
+      my->version = legacy_version;
+      my->first_block_pos = 0;
+
+      if( log_size >= detail::block_log_header_size )
+      {
+         my->check_block_read();
+
+         char header[ detail::block_log_header_size ];
+         my->block_stream.seekg( 0 );
+         my->block_stream.read( header, sizeof( header ) );
+
+         // a legacy log starts with the first block, whose previous id is zero
+         if( std::memcmp( header, detail::block_log_magic, sizeof( detail::block_log_magic ) ) == 0 )
+         {
+            std::memcpy( &my->version, header + sizeof( detail::block_log_magic ), sizeof( my->version ) );
+            FC_ASSERT( my->version == compressed_version, "Unsupported block log version", ("version", my->version) );
+            my->first_block_pos = detail::block_log_header_size;
+         }
+      }
+      else if( !log_size && compress )
+      {
+         my->check_block_write();
+
+         uint32_t version = compressed_version;
+         uint32_t flags = 0;
+         my->block_stream.write( detail::block_log_magic, sizeof( detail::block_log_magic ) );
+         my->block_stream.write( (char*)&version, sizeof( version ) );
+         my->block_stream.write( (char*)&flags, sizeof( flags ) );
+         my->block_stream.flush();
+
+         my->version = version;
+         my->first_block_pos = detail::block_log_header_size;
+         log_size = detail::block_log_header_size;
+      }
+
+      if( log_size > my->first_block_pos )
       {
          ilog( "Log is nonempty" );
          my->head = read_head();
@@ -182,10 +691,30 @@ namespace sophiatx { namespace chain {
          my->index_stream.open( my->index_file.generic_string().c_str(), LOG_WRITE );
          my->index_write = true;
       }
+
+      my->flushed_num = my->head ? my->head->block_num() : 0;
+
+      my->block_stream.flush();
+      my->index_stream.flush();
+      // the index file may have been recreated, so the files are always mapped anew
+      my->remap( fc::file_size( my->block_file ), fc::file_size( my->index_file ) );
+
+      if( append_queue_size )
+      {
+         // the streams are not used from now on, the appender writes through its own descriptors
+         my->check_block_read();
+         my->check_index_read();
+         my->append_pos = my->block_size.load();
+         auto impl = my.get();
+         my->appender.reset( new detail::block_log_appender( my->block_file, my->index_file, append_queue_size, my->flushed_num,
+            [impl]( uint64_t block_size, uint64_t index_size ) { impl->publish( block_size, index_size ); } ) );
+      }
    }
 
    void block_log::close()
    {
+      // writes out and syncs the queued blocks before the files are closed
+      my->appender.reset();
       my.reset( new detail::block_log_impl() );
    }
 
@@ -205,6 +734,22 @@ namespace sophiatx { namespace chain {
             lock.lock();;
          }
 
+         if( my->appender )
+         {
+            uint32_t head_num = my->head ? my->head->block_num() : 0;
+            FC_ASSERT( b.block_num() == head_num + 1, "Append to block log occuring at wrong position.",
+               ( "block_num", b.block_num() )( "expected", head_num + 1 ) );
+
+            uint64_t pos = my->append_pos;
+            auto data = detail::pack_block_record( b, my->version );
+            my->append_pos += data.size() + sizeof( pos );
+            my->appender->append( b, pos, std::move( data ) );
+            my->head = b;
+            my->head_id = b.id();
+
+            return pos;
+         }
+
          my->check_block_write();
          my->check_index_write();
 
@@ -212,13 +757,25 @@ namespace sophiatx { namespace chain {
          FC_ASSERT( static_cast<uint64_t>(my->index_stream.tellp()) == sizeof( uint64_t ) * ( b.block_num() - 1 ),
             "Append to index file occuring at wrong position.",
             ( "position", (uint64_t) my->index_stream.tellp() )( "expected",( b.block_num() - 1 ) * sizeof( uint64_t ) ) );
-         auto data = fc::raw::pack_to_vector( b );
+         auto data = detail::pack_block_record( b, my->version );
          my->block_stream.write( data.data(), data.size() );
          my->block_stream.write( (char*)&pos, sizeof( pos ) );
          my->index_stream.write( (char*)&pos, sizeof( pos ) );
+
+         {
+            // readers see the files through the mapping, which does not reach the data until it is flushed
+            std::lock_guard< std::mutex > unflushed_lock( my->unflushed_mtx );
+            auto& unflushed = my->unflushed[ b.block_num() ];
+            unflushed.pos = pos;
+            unflushed.next_pos = pos + data.size() + sizeof( pos );
+            unflushed.block = b;
+         }
          my->head = b;
          my->head_id = b.id();
 
+         if( my->unflushed.size() >= detail::max_unflushed_blocks )
+            my->flush_unflushed();
+
          return pos;
       }
       FC_LOG_AND_RETHROW()
@@ -233,19 +790,42 @@ namespace sophiatx { namespace chain {
                lock.lock();;
             }
 
-      my->block_stream.flush();
-      my->index_stream.flush();
+      // the background appender syncs on its own
+      if( my->appender )
+         return;
+
+      my->flush_unflushed();
+      my->flushed_num = my->head ? my->head->block_num() : 0;
    }
 
-   std::pair< signed_block, uint64_t > block_log::read_block( uint64_t pos )const
+   void block_log::fence()
    {
-      scoped_lock lock( my->mtx, defer_lock );
+      if( my->appender )
+         my->appender->fence();
+      else
+         flush();
+   }
 
-      if( my->use_locking )
-      {
-         lock.lock();;
-      }
+   uint32_t block_log::durable_head_num()const
+   {
+      if( my->appender )
+         return my->appender->durable_head_num();
+
+      return my->flushed_num;
+   }
 
+   block_log_append_metrics block_log::get_append_metrics()const
+   {
+      if( my->appender )
+         return my->appender->get_metrics();
+
+      block_log_append_metrics result;
+      result.durable_head = my->flushed_num;
+      return result;
+   }
+
+   std::pair< signed_block, uint64_t > block_log::read_block( uint64_t pos )const
+   {
       return read_block_helper( pos );
    }
 
@@ -253,12 +833,26 @@ namespace sophiatx { namespace chain {
    {
       try
       {
-         my->check_block_read();
+         if( my->appender )
+         {
+            auto queued = my->appender->find_block_at( pos );
+            if( queued )
+               return std::move( *queued );
+         }
+         else
+         {
+            auto unflushed = my->find_unflushed_at( pos );
+            if( unflushed )
+               return std::move( *unflushed );
+         }
+
+         uint64_t size = my->block_size.load( std::memory_order_acquire );
+         FC_ASSERT( pos >= my->first_block_pos && pos < size, "Block position is outside of block log.", ("pos", pos)("size", size) );
+         auto mapping = my->load_mapping();
 
-         my->block_stream.seekg( pos );
          std::pair<signed_block,uint64_t> result;
-         fc::raw::unpack( my->block_stream, result.first, 0 );
-         result.second = uint64_t(my->block_stream.tellg()) + 8;
+         uint64_t record_size = detail::unpack_block_record( mapping->block_data() + pos, size - pos, my->version, result.first );
+         result.second = pos + record_size + sizeof( pos );
          return result;
       }
       FC_LOG_AND_RETHROW()
@@ -268,14 +862,12 @@ namespace sophiatx { namespace chain {
    {
       try
       {
-         scoped_lock lock( my->mtx, defer_lock );
+         optional< signed_block > b;
 
-         if( my->use_locking )
-         {
-            lock.lock();;
-         }
+         b = my->appender ? my->appender->find_block( block_num ) : my->find_unflushed( block_num );
+         if( b )
+            return b;
 
-         optional< signed_block > b;
          uint64_t pos = get_block_pos_helper( block_num );
          if( pos != npos )
          {
@@ -287,15 +879,55 @@ namespace sophiatx { namespace chain {
       FC_LOG_AND_RETHROW()
    }
 
-   uint64_t block_log::get_block_pos( uint32_t block_num ) const
+   optional< std::vector< char > > block_log::read_packed_block_by_num( uint32_t block_num )const
    {
-      scoped_lock lock( my->mtx, defer_lock );
-
-      if( my->use_locking )
+      try
       {
-         lock.lock();;
+         optional< std::vector< char > > result;
+
+         auto queued = my->appender ? my->appender->find_block( block_num ) : my->find_unflushed( block_num );
+         if( queued )
+         {
+            result = fc::raw::pack_to_vector( *queued );
+            return result;
+         }
+
+         uint64_t pos = get_block_pos_helper( block_num );
+         if( pos == npos )
+            return result;
+
+         uint64_t next_pos = get_block_pos_helper( block_num + 1 );
+         uint64_t size = my->block_size.load( std::memory_order_acquire );
+         FC_ASSERT( pos >= my->first_block_pos && pos < size, "Block position is outside of block log.", ("pos", pos)("size", size) );
+         auto mapping = my->load_mapping();
+         const char* data = mapping->block_data() + pos;
+
+         if( my->version != legacy_version )
+         {
+            uint64_t record_size;
+            result = detail::read_compressed_block_record( data, size - pos, record_size );
+         }
+         else if( next_pos != npos )
+         {
+            // a legacy record is not prefixed by its size, it ends with the position preceding the next record
+            FC_ASSERT( next_pos > pos + sizeof( pos ), "Corrupted block log index", ("pos", pos)("next_pos", next_pos) );
+            result = std::vector< char >( data, data + ( next_pos - pos - sizeof( pos ) ) );
+         }
+         else
+         {
+            // the head block of a legacy log has to be unpacked to find its end
+            signed_block b;
+            uint64_t record_size = detail::unpack_block_record( data, size - pos, my->version, b );
+            result = std::vector< char >( data, data + record_size );
+         }
+
+         return result;
       }
+      FC_LOG_AND_RETHROW()
+   }
 
+   uint64_t block_log::get_block_pos( uint32_t block_num ) const
+   {
       return get_block_pos_helper( block_num );
    }
 
@@ -303,13 +935,23 @@ namespace sophiatx { namespace chain {
    {
       try
       {
-         my->check_index_read();
-
-         if( !( my->head.valid() && block_num <= protocol::block_header::num_from_id( my->head_id ) && block_num > 0 ) )
+         if( block_num == 0 )
             return npos;
-         my->index_stream.seekg( sizeof( uint64_t ) * ( block_num - 1 ) );
+
+         uint64_t queued_pos = my->appender ? my->appender->find_block_pos( block_num ) : my->find_unflushed_pos( block_num );
+         if( queued_pos != npos )
+            return queued_pos;
+
          uint64_t pos;
-         my->index_stream.read( (char*)&pos, sizeof( pos ) );
+         if( uint64_t( block_num ) * sizeof( pos ) > my->index_size.load( std::memory_order_acquire ) )
+            return npos;
+
+         // the block file is published before the index, so its size covers every indexed block
+         uint64_t size = my->block_size.load( std::memory_order_acquire );
+         auto mapping = my->load_mapping();
+         std::memcpy( &pos, mapping->index_data() + sizeof( pos ) * ( block_num - 1 ), sizeof( pos ) );
+         FC_ASSERT( pos >= my->first_block_pos && pos < size, "Corrupted block log index",
+            ("block_num", block_num)("pos", pos)("size", size) );
          return pos;
       }
       FC_LOG_AND_RETHROW()
@@ -331,7 +973,10 @@ namespace sophiatx { namespace chain {
          uint64_t pos;
          my->block_stream.seekg( -sizeof(pos), std::ios::end );
          my->block_stream.read( (char*)&pos, sizeof(pos) );
-         return read_block_helper( pos ).first;
+
+         // the file is not mapped yet when the head is read on open
+         my->block_stream.seekg( pos );
+         return my->read_block_record( pos );
       }
       FC_LOG_AND_RETHROW()
    }
@@ -358,28 +1003,31 @@ namespace sophiatx { namespace chain {
          my->index_stream.open( my->index_file.generic_string().c_str(), LOG_WRITE );
          my->index_write = true;
 
-         uint64_t pos = 0;
+         uint64_t pos = my->first_block_pos;
          uint64_t end_pos;
          my->check_block_read();
 
          my->block_stream.seekg( -sizeof( uint64_t), std::ios::end );
          my->block_stream.read( (char*)&end_pos, sizeof( end_pos ) );
-         signed_block tmp;
 
          my->block_stream.seekg( pos );
 
          while( pos < end_pos )
          {
-            fc::raw::unpack( my->block_stream, tmp, 0 );
-            my->block_stream.read( (char*)&pos, sizeof( pos ) );
+            my->read_block_record( pos );
             my->index_stream.write( (char*)&pos, sizeof( pos ) );
          }
       }
       FC_LOG_AND_RETHROW()
    }
 
+   uint32_t block_log::version()const
+   {
+      return my->version;
+   }
+
    void block_log::set_locking( bool use_locking )
    {
-      my->use_locking = true;
+      my->use_locking = use_locking;
    }
 } } // sophiatx::chain
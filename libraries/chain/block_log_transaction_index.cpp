@@ -0,0 +1,386 @@
+#include <sophiatx/chain/block_log_transaction_index.hpp>
+#include <sophiatx/chain/util/file_io.hpp>
+
+#include <fc/io/raw.hpp>
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace sophiatx { namespace chain {
+
+namespace bip = boost::interprocess;
+
+using util::write_all;
+using util::read_all;
+
+namespace {
+   const char transaction_index_magic[ 8 ] = { 'S', 'P', 'H', 'X', 'T', 'R', 'X', 'I' };
+   const uint32_t transaction_index_version = 1;
+   const char transaction_hash_magic[ 8 ] = { 'S', 'P', 'H', 'X', 'T', 'R', 'X', 'H' };
+   const uint32_t transaction_hash_version = 1;
+}
+
+block_log_transaction_index::~block_log_transaction_index()
+{
+   close();
+}
+
+void block_log_transaction_index::open( const fc::path& file, const block_log& log )
+{ try {
+   close();
+
+   std::lock_guard< std::mutex > lock( _mtx );
+   _log = &log;
+   _file = file;
+   _fd = ::open( file.generic_string().c_str(), O_RDWR | O_CREAT, 0644 );
+   FC_ASSERT( _fd >= 0, "Cannot open block log transaction index: ${e}", ("e", strerror( errno )) );
+
+   _size = fc::file_size( file );
+   uint32_t log_head = log.head() ? log.head()->block_num() : 0;
+
+   bool valid = _size >= header_size;
+   if( valid )
+   {
+      char header[ header_size ];
+      read_all( _fd, header, header_size, 0 );
+
+      uint32_t version;
+      std::memcpy( &version, header + sizeof( transaction_index_magic ), sizeof( version ) );
+      std::memcpy( &_head, header + sizeof( transaction_index_magic ) + sizeof( version ), sizeof( _head ) );
+      valid = std::memcmp( header, transaction_index_magic, sizeof( transaction_index_magic ) ) == 0
+              && version == transaction_index_version;
+   }
+
+   if( !valid || _head > log_head )
+   {
+      ilog( "Block log transaction index does not match the block log, rebuilding it" );
+      FC_ASSERT( ::ftruncate( _fd, 0 ) == 0, "Cannot truncate block log transaction index: ${e}", ("e", strerror( errno )) );
+
+      char header[ header_size ] = {};
+      std::memcpy( header, transaction_index_magic, sizeof( transaction_index_magic ) );
+      std::memcpy( header + sizeof( transaction_index_magic ), &transaction_index_version, sizeof( transaction_index_version ) );
+      write_all( _fd, header, header_size, 0 );
+      _size = header_size;
+      _head = 0;
+   }
+
+   _mapping.reset( new bip::file_mapping( file.generic_string().c_str(), bip::read_only ) );
+   remap( _size );
+
+   // records of blocks after the recorded head are left by an interrupted append, they are indexed again
+   uint64_t records = ( _size - header_size ) / record_size;
+   while( records )
+   {
+      uint32_t block_num;
+      std::memcpy( &block_num, record_data( records - 1 ) + sizeof( transaction_id_type ), sizeof( block_num ) );
+      if( block_num <= _head )
+         break;
+      --records;
+   }
+
+   if( _size != header_size + records * record_size )
+   {
+      _size = header_size + records * record_size;
+      FC_ASSERT( ::ftruncate( _fd, _size ) == 0, "Cannot truncate block log transaction index: ${e}", ("e", strerror( errno )) );
+   }
+
+   open_hash( records );
+
+   if( _head < log_head )
+   {
+      ilog( "Indexing transactions of blocks ${f} - ${l}", ("f", _head + 1)("l", log_head) );
+
+      for( uint32_t block_num = _head + 1; block_num <= log_head; ++block_num )
+      {
+         auto b = log.read_block_by_num( block_num );
+         FC_ASSERT( b.valid(), "Block ${n} is missing in block log", ("n", block_num) );
+         index_block( *b );
+
+         if( block_num % 100000 == 0 )
+         {
+            write_head( block_num );
+            ilog( "   ${n} of ${l}", ("n", block_num)("l", log_head) );
+         }
+      }
+
+      write_head( log_head );
+   }
+} FC_CAPTURE_AND_RETHROW( (file) ) }
+
+void block_log_transaction_index::close()
+{
+   std::lock_guard< std::mutex > lock( _mtx );
+
+   close_hash();
+   _region.reset();
+   _mapping.reset();
+
+   if( _fd >= 0 )
+      ::close( _fd );
+
+   _fd = -1;
+   _log = nullptr;
+   _size = 0;
+   _head = 0;
+}
+
+bool block_log_transaction_index::is_open()const
+{
+   std::lock_guard< std::mutex > lock( _mtx );
+   return _fd >= 0;
+}
+
+void block_log_transaction_index::append( const signed_block& b )
+{ try {
+   std::lock_guard< std::mutex > lock( _mtx );
+   FC_ASSERT( _fd >= 0, "Block log transaction index is not open" );
+
+   index_block( b );
+   write_head( b.block_num() );
+} FC_CAPTURE_AND_RETHROW( (b.block_num()) ) }
+
+optional< block_log_transaction_location > block_log_transaction_index::find( const transaction_id_type& id )const
+{
+   std::lock_guard< std::mutex > lock( _mtx );
+   return find_locked( id );
+}
+
+optional< block_log_transaction_location > block_log_transaction_index::find_locked( const transaction_id_type& id )const
+{
+   optional< block_log_transaction_location > result;
+   if( !_hash_region )
+      return result;
+
+   const uint64_t* b = buckets();
+   uint64_t mask = _buckets - 1;
+   for( uint64_t bucket = id_key( id ) & mask; b[ bucket ]; bucket = ( bucket + 1 ) & mask )
+   {
+      const char* data = record_data( b[ bucket ] - 1 );
+      if( std::memcmp( data, id.data(), sizeof( id ) ) )
+         continue;
+
+      data += sizeof( id );
+      block_log_transaction_location location;
+      std::memcpy( &location.block_num, data, sizeof( uint32_t ) );
+      std::memcpy( &location.trx_in_block, data + sizeof( uint32_t ), sizeof( uint32_t ) );
+      std::memcpy( &location.offset, data + 2 * sizeof( uint32_t ), sizeof( uint32_t ) );
+      std::memcpy( &location.size, data + 3 * sizeof( uint32_t ), sizeof( uint32_t ) );
+      result = location;
+      break;
+   }
+
+   return result;
+}
+
+optional< block_log_transaction > block_log_transaction_index::read_transaction( const transaction_id_type& id )const
+{ try {
+   optional< block_log_transaction > result;
+
+   std::lock_guard< std::mutex > lock( _mtx );
+   auto location = find_locked( id );
+   if( !location || _log == nullptr )
+      return result;
+
+   auto packed_block = _log->read_packed_block_by_num( location->block_num );
+   FC_ASSERT( packed_block.valid() && uint64_t( location->offset ) + location->size <= packed_block->size(),
+      "Indexed transaction is not in block log", ("location", *location) );
+
+   result = block_log_transaction();
+   result->location = *location;
+   result->packed_trx.assign( packed_block->begin() + location->offset, packed_block->begin() + location->offset + location->size );
+   return result;
+} FC_CAPTURE_AND_RETHROW( (id) ) }
+
+uint32_t block_log_transaction_index::head_block_num()const
+{
+   std::lock_guard< std::mutex > lock( _mtx );
+   return _head;
+}
+
+void block_log_transaction_index::index_block( const signed_block& b )
+{
+   FC_ASSERT( b.block_num() == _head + 1, "Block log transaction index appended at wrong position",
+      ("block_num", b.block_num())("expected", _head + 1) );
+
+   uint64_t first_record = ( _size - header_size ) / record_size;
+   std::vector< char > records( b.transactions.size() * record_size );
+
+   // transactions follow the header and their count in the packed block
+   uint32_t offset = fc::raw::pack_size( static_cast< const signed_block_header& >( b ) )
+                     + fc::raw::pack_size( fc::unsigned_int( b.transactions.size() ) );
+   uint32_t block_num = b.block_num();
+
+   for( uint32_t trx_in_block = 0; trx_in_block < b.transactions.size(); ++trx_in_block )
+   {
+      const auto& trx = b.transactions[ trx_in_block ];
+      uint32_t size = fc::raw::pack_size( trx );
+      auto id = trx.id();
+
+      char* data = records.data() + trx_in_block * record_size;
+      std::memcpy( data, id.data(), sizeof( transaction_id_type ) );
+      data += sizeof( transaction_id_type );
+      std::memcpy( data, &block_num, sizeof( uint32_t ) );
+      std::memcpy( data + sizeof( uint32_t ), &trx_in_block, sizeof( uint32_t ) );
+      std::memcpy( data + 2 * sizeof( uint32_t ), &offset, sizeof( uint32_t ) );
+      std::memcpy( data + 3 * sizeof( uint32_t ), &size, sizeof( uint32_t ) );
+
+      offset += size;
+   }
+
+   if( records.size() )
+   {
+      write_all( _fd, records.data(), records.size(), _size );
+      _size += records.size();
+
+      if( _size > _region->get_size() )
+         remap( _size );
+
+      for( uint64_t i = 0; i < b.transactions.size(); ++i )
+         insert_hash( first_record + i );
+   }
+
+   _head = block_num;
+}
+
+void block_log_transaction_index::write_head( uint32_t block_num )
+{
+   write_all( _fd, (const char*)&block_num, sizeof( block_num ), header_size - sizeof( block_num ) );
+}
+
+void block_log_transaction_index::remap( uint64_t size )
+{
+   // the region reaches beyond the end of the file, so appended records are readable without remapping
+   uint64_t capacity = size + std::max< uint64_t >( size / 4, 16 * 1024 * 1024 );
+   _region.reset( new bip::mapped_region( *_mapping, bip::read_only, 0, capacity ) );
+}
+
+const char* block_log_transaction_index::record_data( uint64_t record )const
+{
+   return static_cast< const char* >( _region->get_address() ) + header_size + record * record_size;
+}
+
+void block_log_transaction_index::open_hash( uint64_t records )
+{
+   _hash_file = fc::path( _file.generic_string() + ".hash" );
+   _hash_fd = ::open( _hash_file.generic_string().c_str(), O_RDWR | O_CREAT, 0644 );
+   FC_ASSERT( _hash_fd >= 0, "Cannot open block log transaction index hash table: ${e}", ("e", strerror( errno )) );
+
+   uint64_t size = fc::file_size( _hash_file );
+   bool valid = size >= hash_header_size;
+   if( valid )
+   {
+      char header[ hash_header_size ];
+      read_all( _hash_fd, header, hash_header_size, 0 );
+
+      uint32_t version, clean;
+      std::memcpy( &version, header + 8, sizeof( version ) );
+      std::memcpy( &clean, header + 12, sizeof( clean ) );
+      std::memcpy( &_buckets, header + 16, sizeof( _buckets ) );
+      std::memcpy( &_entries, header + 24, sizeof( _entries ) );
+      valid = std::memcmp( header, transaction_hash_magic, sizeof( transaction_hash_magic ) ) == 0
+              && version == transaction_hash_version && clean && _entries == records
+              && _buckets >= min_buckets && ( _buckets & ( _buckets - 1 ) ) == 0
+              && size == hash_header_size + _buckets * sizeof( uint64_t );
+   }
+
+   if( !valid )
+   {
+      ilog( "Rebuilding the hash table of the block log transaction index" );
+      uint64_t buckets = min_buckets;
+      while( buckets < 2 * ( records + 1 ) )
+         buckets *= 2;
+      rebuild_hash( buckets, records );
+      return;
+   }
+
+   _hash_mapping.reset( new bip::file_mapping( _hash_file.generic_string().c_str(), bip::read_write ) );
+   _hash_region.reset( new bip::mapped_region( *_hash_mapping, bip::read_write ) );
+
+   // the table is rebuilt if the process stops before close() marks it clean again
+   uint32_t clean = 0;
+   std::memcpy( static_cast< char* >( _hash_region->get_address() ) + 12, &clean, sizeof( clean ) );
+   _hash_region->flush( 0, hash_header_size, false );
+}
+
+void block_log_transaction_index::close_hash()
+{
+   if( _hash_region )
+   {
+      // the records have to be on disk before the table is marked as matching them
+      util::sync_data( _fd );
+      _hash_region->flush( 0, 0, false );
+
+      uint32_t clean = 1;
+      std::memcpy( static_cast< char* >( _hash_region->get_address() ) + 12, &clean, sizeof( clean ) );
+      _hash_region->flush( 0, hash_header_size, false );
+   }
+
+   _hash_region.reset();
+   _hash_mapping.reset();
+
+   if( _hash_fd >= 0 )
+      ::close( _hash_fd );
+
+   _hash_fd = -1;
+   _buckets = 0;
+   _entries = 0;
+}
+
+void block_log_transaction_index::rebuild_hash( uint64_t buckets, uint64_t records )
+{
+   _hash_region.reset();
+   _hash_mapping.reset();
+
+   // the buckets of the resized file read as zeros, which marks them empty
+   FC_ASSERT( ::ftruncate( _hash_fd, 0 ) == 0 && ::ftruncate( _hash_fd, hash_header_size + buckets * sizeof( uint64_t ) ) == 0,
+      "Cannot resize block log transaction index hash table: ${e}", ("e", strerror( errno )) );
+
+   _hash_mapping.reset( new bip::file_mapping( _hash_file.generic_string().c_str(), bip::read_write ) );
+   _hash_region.reset( new bip::mapped_region( *_hash_mapping, bip::read_write ) );
+   _buckets = buckets;
+   _entries = 0;
+
+   char* header = static_cast< char* >( _hash_region->get_address() );
+   std::memcpy( header, transaction_hash_magic, sizeof( transaction_hash_magic ) );
+   std::memcpy( header + 8, &transaction_hash_version, sizeof( transaction_hash_version ) );
+   std::memcpy( header + 16, &_buckets, sizeof( _buckets ) );
+
+   for( uint64_t record = 0; record < records; ++record )
+      insert_hash( record );
+}
+
+void block_log_transaction_index::insert_hash( uint64_t record )
+{
+   if( 2 * ( _entries + 1 ) > _buckets )
+      rebuild_hash( 2 * _buckets, record );
+
+   transaction_id_type id;
+   std::memcpy( id.data(), record_data( record ), sizeof( id ) );
+
+   uint64_t* b = buckets();
+   uint64_t mask = _buckets - 1;
+   uint64_t bucket = id_key( id ) & mask;
+   while( b[ bucket ] )
+      bucket = ( bucket + 1 ) & mask;
+
+   b[ bucket ] = record + 1;
+   ++_entries;
+   std::memcpy( static_cast< char* >( _hash_region->get_address() ) + 24, &_entries, sizeof( _entries ) );
+}
+
+uint64_t* block_log_transaction_index::buckets()const
+{
+   return reinterpret_cast< uint64_t* >( static_cast< char* >( _hash_region->get_address() ) + hash_header_size );
+}
+
+uint64_t block_log_transaction_index::id_key( const transaction_id_type& id )
+{
+   uint64_t key;
+   std::memcpy( &key, id.data(), sizeof( key ) );
+   return key;
+}
+
+} } // sophiatx::chain
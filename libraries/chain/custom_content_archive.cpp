@@ -0,0 +1,218 @@
+#include <sophiatx/chain/custom_content_archive.hpp>
+#include <sophiatx/chain/util/file_io.hpp>
+
+#include <fc/exception/exception.hpp>
+#include <fc/log/logger.hpp>
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace sophiatx { namespace chain {
+
+using util::write_all;
+using util::read_all;
+
+namespace {
+   const char custom_content_archive_magic[ 8 ] = { 'S', 'P', 'H', 'X', 'C', 'C', 'A', 'R' };
+   const uint32_t custom_content_archive_version = 1;
+}
+
+custom_content_archive::~custom_content_archive()
+{
+   close();
+}
+
+void custom_content_archive::open( const fc::path& file )
+{ try {
+   close();
+
+   std::unique_lock< std::mutex > lock( _mtx );
+   _file = file;
+   _fd = ::open( file.generic_string().c_str(), O_RDWR | O_CREAT, 0644 );
+   FC_ASSERT( _fd >= 0, "Cannot open custom content archive: ${e}", ("e", strerror( errno )) );
+
+   _size = fc::file_size( file );
+   if( _size == 0 )
+   {
+      char header[ header_size ] = {};
+      std::memcpy( header, custom_content_archive_magic, sizeof( custom_content_archive_magic ) );
+      std::memcpy( header + sizeof( custom_content_archive_magic ), &custom_content_archive_version, sizeof( custom_content_archive_version ) );
+      write_all( _fd, header, header_size, 0 );
+      _size = header_size;
+      lock.unlock();
+      _writer = std::thread( [this]() { run(); } );
+      return;
+   }
+
+   // unlike the block log sidecars the archive cannot be rebuilt, a foreign file is never truncated
+   FC_ASSERT( _size >= header_size, "Custom content archive is truncated" );
+
+   char header[ header_size ];
+   read_all( _fd, header, header_size, 0 );
+
+   uint32_t version;
+   std::memcpy( &version, header + sizeof( custom_content_archive_magic ), sizeof( version ) );
+   FC_ASSERT( std::memcmp( header, custom_content_archive_magic, sizeof( custom_content_archive_magic ) ) == 0,
+      "File is not a custom content archive" );
+   FC_ASSERT( version == custom_content_archive_version, "Unsupported custom content archive version ${v}", ("v", version) );
+
+   lock.unlock();
+   _writer = std::thread( [this]() { run(); } );
+} FC_CAPTURE_AND_RETHROW( (file) ) }
+
+void custom_content_archive::close()
+{
+   if( _writer.joinable() )
+   {
+      // writes out the queued batch before stopping
+      {
+         std::lock_guard< std::mutex > lock( _writer_mtx );
+         _stopping = true;
+      }
+      _writer_cv.notify_all();
+      _writer.join();
+   }
+
+   {
+      std::lock_guard< std::mutex > lock( _writer_mtx );
+      _queued.clear();
+      _written.clear();
+      _writing = false;
+      _stopping = false;
+      _error.clear();
+   }
+
+   std::lock_guard< std::mutex > lock( _mtx );
+
+   if( _fd >= 0 )
+      ::close( _fd );
+
+   _fd = -1;
+   _size = 0;
+}
+
+uint64_t custom_content_archive::append( const std::vector< char >& packed_payload )
+{ try {
+   std::lock_guard< std::mutex > lock( _mtx );
+   FC_ASSERT( _fd >= 0, "Custom content archive is not open" );
+
+   uint64_t pos = _size;
+   write_all( _fd, packed_payload.data(), packed_payload.size(), pos );
+   _size += packed_payload.size();
+   return pos;
+} FC_CAPTURE_AND_RETHROW( (packed_payload.size()) ) }
+
+std::vector< char > custom_content_archive::read( uint64_t pos, uint32_t size )const
+{ try {
+   std::lock_guard< std::mutex > lock( _mtx );
+   FC_ASSERT( _fd >= 0, "Custom content archive is not open" );
+   FC_ASSERT( pos >= header_size && pos + size <= _size, "Payload is not in custom content archive", ("archive_size", _size) );
+
+   std::vector< char > result( size );
+   read_all( _fd, result.data(), size, pos );
+   return result;
+} FC_CAPTURE_AND_RETHROW( (pos)(size) ) }
+
+void custom_content_archive::sync()
+{ try {
+   int fd;
+   {
+      std::lock_guard< std::mutex > lock( _mtx );
+      FC_ASSERT( _fd >= 0, "Custom content archive is not open" );
+      fd = _fd;
+   }
+   // the descriptor is only closed by close(), which waits for the background writer
+   util::sync_data( fd );
+} FC_CAPTURE_AND_RETHROW( (_file) ) }
+
+uint64_t custom_content_archive::size()const
+{
+   std::lock_guard< std::mutex > lock( _mtx );
+   return _size;
+}
+
+void custom_content_archive::write_async( std::vector< custom_content_archive_item >&& batch )
+{
+   {
+      std::lock_guard< std::mutex > lock( _writer_mtx );
+      FC_ASSERT( _error.empty(), "Custom content archive writer failed: ${e}", ("e", _error) );
+      FC_ASSERT( _writer.joinable(), "Custom content archive is not open" );
+      FC_ASSERT( !_writing, "Custom content archive is writing another batch" );
+      _queued = std::move( batch );
+      _writing = true;
+   }
+   _writer_cv.notify_all();
+}
+
+bool custom_content_archive::is_writing()const
+{
+   std::lock_guard< std::mutex > lock( _writer_mtx );
+   return _writing;
+}
+
+std::vector< custom_content_archive_item > custom_content_archive::take_written()
+{
+   std::lock_guard< std::mutex > lock( _writer_mtx );
+   FC_ASSERT( _error.empty(), "Custom content archive writer failed: ${e}", ("e", _error) );
+
+   std::vector< custom_content_archive_item > result;
+   if( _writing && _queued.empty() && !_written.empty() )
+   {
+      result = std::move( _written );
+      _written.clear();
+      _writing = false;
+   }
+   return result;
+}
+
+void custom_content_archive::fence()const
+{
+   std::unique_lock< std::mutex > lock( _writer_mtx );
+   _writer_cv.wait( lock, [&]() { return !_writing || !_written.empty() || !_error.empty(); } );
+}
+
+void custom_content_archive::run()
+{
+   std::unique_lock< std::mutex > lock( _writer_mtx );
+
+   while( true )
+   {
+      _writer_cv.wait( lock, [&]() { return _stopping || !_queued.empty(); } );
+      if( _queued.empty() )
+         return;
+
+      auto batch = std::move( _queued );
+      _queued.clear();
+      lock.unlock();
+
+      std::string error;
+      try
+      {
+         for( auto& item : batch )
+         {
+            item.size = item.packed.size();
+            item.pos = append( item.packed );
+            std::vector< char >().swap( item.packed );
+         }
+         // the payloads are only referenced by the state once their copies are durable
+         sync();
+      }
+      catch( const fc::exception& e )
+      {
+         elog( "Custom content archive writer failed: ${e}", ("e", e.to_detail_string()) );
+         error = e.to_string();
+      }
+
+      lock.lock();
+      if( error.empty() )
+         _written = std::move( batch );
+      else
+         _error = error;
+      _writer_cv.notify_all();
+   }
+}
+
+} } // sophiatx::chain
@@ -1,6 +1,8 @@
 #include <sophiatx/protocol/sophiatx_operations.hpp>
+#include <sophiatx/protocol/transaction_util.hpp>
 
 #include <sophiatx/chain/block_summary_object.hpp>
+#include <sophiatx/chain/block_stats_object.hpp>
 #include <sophiatx/chain/compound.hpp>
 #include <sophiatx/chain/custom_operation_interpreter.hpp>
 #include <sophiatx/chain/database/database.hpp>
@@ -14,10 +16,12 @@
 #include <sophiatx/chain/custom_content_object.hpp>
 #include <sophiatx/chain/transaction_object.hpp>
 #include <sophiatx/chain/shared_db_merkle.hpp>
+#include <sophiatx/chain/state_snapshot.hpp>
 #include <sophiatx/chain/operation_notification.hpp>
 #include <sophiatx/chain/witness_schedule.hpp>
 #include <sophiatx/chain/application_object.hpp>
 
+#include <sophiatx/chain/util/bounded_queue.hpp>
 #include <sophiatx/chain/util/uint256.hpp>
 
 #include <fc/uint128.hpp>
@@ -25,13 +29,18 @@
 #include <fc/container/deque.hpp>
 
 #include <fc/io/fstream.hpp>
+#include <fc/io/json.hpp>
 
 #include <boost/scope_exit.hpp>
 
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
 #include <deque>
 #include <fstream>
 #include <functional>
+#include <map>
+#include <thread>
 
 namespace sophiatx { namespace chain {
 
@@ -65,6 +74,59 @@ namespace sophiatx { namespace chain {
 
 using boost::container::flat_set;
 
+/// Blocks replayed from the block log have already been validated
+static const uint64_t replay_skip_flags =
+   database::skip_witness_signature |
+   database::skip_transaction_signatures |
+   database::skip_transaction_dupe_check |
+   database::skip_tapos_check |
+   database::skip_merkle_check |
+   database::skip_witness_schedule_check |
+   database::skip_authority_check |
+   database::skip_validate | /// no need to validate operations
+   database::skip_validate_invariants |
+   database::skip_block_log;
+
+static fc::path state_snapshot_file( const fc::path& dir, std::string type_name )
+{
+   std::replace( type_name.begin(), type_name.end(), ':', '_' );
+   return dir / ( type_name + ".bin" );
+}
+
+/// Runs job( i ) for every i in [0, count) on at most one thread per core and rethrows the first failure
+template< typename Job >
+static void run_in_parallel( size_t count, Job&& job )
+{
+   vector< std::exception_ptr > errors( count );
+   std::atomic< size_t > next( 0 );
+   size_t workers = std::min< size_t >( count, std::max( std::thread::hardware_concurrency(), 1u ) );
+   vector< std::thread > threads;
+   threads.reserve( workers );
+
+   for( size_t w = 0; w < workers; ++w )
+      threads.emplace_back( [&job, &errors, &next, count]()
+      {
+         for( size_t i = next++; i < count; i = next++ )
+         {
+            try
+            {
+               job( i );
+            }
+            catch( ... )
+            {
+               errors[ i ] = std::current_exception();
+            }
+         }
+      });
+
+   for( auto& t : threads )
+      t.join();
+
+   for( const auto& e : errors )
+      if( e )
+         std::rethrow_exception( e );
+}
+
 database::~database()
 {
    clear_pending();
@@ -89,7 +151,75 @@ void database::open( const open_args& args, const genesis_state_type& genesis, c
             init_genesis( genesis, chain_id, init_pubkey );
          });
 
-      _block_log.open( args.shared_mem_dir / "block_log" );
+      _open_custom_content_archive( args );
+      _open_block_log( args );
+   }
+   FC_CAPTURE_LOG_AND_RETHROW( (args.shared_mem_dir)(args.shared_file_size) )
+}
+
+void database::_open_custom_content_archive( const open_args& args )
+{
+   try
+   {
+      _custom_content_archive_age = args.custom_content_archive_age;
+      _custom_content_memory_budget = args.custom_content_memory_budget;
+      _custom_content_archive_copies.clear();
+
+      auto file = args.shared_mem_dir / "custom_content.archive";
+      const auto* storage = find< custom_content_storage_object >();
+      bool has_archived = storage != nullptr && storage->archived_payloads > 0;
+      FC_ASSERT( !has_archived || fc::exists( file ), "State references archived custom content, but the archive is missing",
+         ("file", file) );
+
+      if( has_archived || _custom_content_archive_age || _custom_content_memory_budget || fc::exists( file ) )
+         _custom_content_archive.open( file );
+   }
+   FC_CAPTURE_AND_RETHROW( (args.shared_mem_dir) )
+}
+
+void database::_seed_custom_content_sequences()
+{
+   const auto& counters = get_index< custom_content_sequence_index >().indices();
+   const auto& documents = get_index< custom_content_index >().indices();
+   if( !counters.empty() || documents.empty() )
+      return;
+
+   ilog( "Creating custom content sequence counters from ${n} stored documents", ("n", documents.size()) );
+
+   auto seed = [&]( uint8_t type, const account_name_type& account, uint64_t app_id, uint64_t sequence )
+   {
+      create< custom_content_sequence_object >( [&]( custom_content_sequence_object& c ) {
+           c.type = type;
+           c.account = account;
+           c.app_id = app_id;
+           c.sequence = sequence;
+      });
+   };
+
+   // the indices sort the sequences in descending order, the first document of each key holds the last number
+   const auto& by_app = documents.get< by_app_id >();
+   for( auto itr = by_app.begin(); itr != by_app.end(); itr = by_app.upper_bound( itr->app_id ) )
+      seed( custom_content_sequence_object::app_sequence, account_name_type(), itr->app_id, itr->app_message_sequence );
+
+   const auto& by_sender_idx = documents.get< by_sender >();
+   for( auto itr = by_sender_idx.begin(); itr != by_sender_idx.end(); itr = by_sender_idx.upper_bound( boost::make_tuple( itr->sender, itr->app_id ) ) )
+      seed( custom_content_sequence_object::sender_sequence, itr->sender, itr->app_id, itr->sender_sequence );
+
+   const auto& by_recipient_idx = documents.get< by_recipient >();
+   for( auto itr = by_recipient_idx.begin(); itr != by_recipient_idx.end(); itr = by_recipient_idx.upper_bound( boost::make_tuple( itr->recipient, itr->app_id ) ) )
+      seed( custom_content_sequence_object::recipient_sequence, itr->recipient, itr->app_id, itr->recipient_sequence );
+}
+
+void database::_open_block_log( const open_args& args )
+{
+   try
+   {
+      _block_log.open( args.shared_mem_dir / "block_log", args.block_log_queue_size, args.block_log_compression );
+      _block_cache.clear();
+      _block_cache.set_capacity( args.block_cache_size );
+
+      if( args.block_log_transaction_index )
+         _block_log_trx_index.open( args.shared_mem_dir / "block_log.trx", _block_log );
 
       auto log_head = _block_log.head();
 
@@ -99,8 +229,12 @@ void database::open( const open_args& args, const genesis_state_type& genesis, c
          undo_all();
          FC_ASSERT( revision() == head_block_num(), "Chainbase revision does not match head block num",
             ("rev", revision())("head_block", head_block_num()) );
+         _seed_custom_content_sequences();
          if (args.do_validate_invariants)
+         {
+            audit_invariants();
             validate_invariants();
+         }
       });
 
       if( head_block_num() )
@@ -127,7 +261,7 @@ void database::open( const open_args& args, const genesis_state_type& genesis, c
       _shared_file_full_threshold = args.shared_file_full_threshold;
       _shared_file_scale_rate = args.shared_file_scale_rate;
    }
-   FC_CAPTURE_LOG_AND_RETHROW( (args.shared_mem_dir)(args.shared_file_size) )
+   FC_CAPTURE_AND_RETHROW( (args.shared_mem_dir) )
 }
 
 uint32_t database::reindex( const open_args& args, const genesis_state_type& genesis, const public_key_type& init_pubkey )
@@ -153,22 +287,9 @@ uint32_t database::reindex( const open_args& args, const genesis_state_type& gen
 
       ilog( "Replaying blocks..." );
 
-      uint64_t skip_flags =
-         skip_witness_signature |
-         skip_transaction_signatures |
-         skip_transaction_dupe_check |
-         skip_tapos_check |
-         skip_merkle_check |
-         skip_witness_schedule_check |
-         skip_authority_check |
-         skip_validate | /// no need to validate operations
-         skip_validate_invariants |
-         skip_block_log;
-
       with_write_lock( [&]()
       {
          _block_log.set_locking( false );
-         auto itr = _block_log.read_block( 0 );
          auto last_block_num = _block_log.head()->block_num();
          if( args.stop_replay_at > 0 && args.stop_replay_at < last_block_num )
             last_block_num = args.stop_replay_at;
@@ -177,24 +298,66 @@ uint32_t database::reindex( const open_args& args, const genesis_state_type& gen
             args.benchmark.second( 0, get_abstract_index_cntr() );
          }
 
-         while( itr.first.block_num() != last_block_num )
+         /* Blocks are read and unpacked from the block log by a reader thread while this thread applies
+          * them, so disk I/O and deserialization overlap with state mutation. The reader also wraps the
+          * transactions into envelopes, so they are packed and hashed off the applying thread. The block log
+          * is not written during replay (skip_block_log), so the reader is its only user.
+          */
+         typedef std::pair< signed_block, transaction_envelopes > replay_item;
+         util::bounded_queue< replay_item > replay_queue( args.replay_queue_size );
+         const chain_id_type chain_id = get_chain_id();
+         std::exception_ptr reader_error;
+
+         std::thread reader( [&]()
+         {
+            try
+            {
+               uint64_t pos = _block_log.get_block_pos( 1 );
+               uint32_t block_num = 0;
+
+               while( block_num < last_block_num )
+               {
+                  auto itr = _block_log.read_block( pos );
+                  block_num = itr.first.block_num();
+                  pos = itr.second;
+
+                  auto envelopes = make_transaction_envelopes( itr.first, chain_id );
+                  if( !replay_queue.push( replay_item( std::move( itr.first ), std::move( envelopes ) ) ) )
+                     break;
+               }
+            }
+            catch( ... )
+            {
+               reader_error = std::current_exception();
+            }
+
+            replay_queue.close();
+         });
+
+         BOOST_SCOPE_EXIT(&replay_queue, &reader) {
+            replay_queue.close();
+            if( reader.joinable() )
+               reader.join();
+         } BOOST_SCOPE_EXIT_END
+
+         replay_item next;
+         while( replay_queue.pop( next ) )
          {
-            auto cur_block_num = itr.first.block_num();
+            const signed_block& next_block = next.first;
+            auto cur_block_num = next_block.block_num();
             if( cur_block_num % 10000 == 0 )
                std::cerr << "   " << double( cur_block_num * 100 ) / last_block_num << "%   " << cur_block_num << " of " << last_block_num <<
                "   (" << (get_free_memory() / (1024*1024)) << "M free)\n";
-            apply_block( itr.first, skip_flags );
+            apply_block( next_block, replay_skip_flags, next.second );
+            last_block_number = cur_block_num;
 
             if( (args.benchmark.first > 0) && (cur_block_num % args.benchmark.first == 0) )
                args.benchmark.second( cur_block_num, get_abstract_index_cntr() );
-            itr = _block_log.read_block( itr.second );
          }
 
-         apply_block( itr.first, skip_flags );
-         last_block_number = itr.first.block_num();
+         if( reader_error )
+            std::rethrow_exception( reader_error );
 
-         if( (args.benchmark.first > 0) && (last_block_number % args.benchmark.first == 0) )
-            args.benchmark.second( last_block_number, get_abstract_index_cntr() );
          set_revision( head_block_num() );
          _block_log.set_locking( true );
       });
@@ -213,6 +376,178 @@ uint32_t database::reindex( const open_args& args, const genesis_state_type& gen
 
 }
 
+void database::export_state( const fc::path& dir )
+{
+   try
+   {
+      with_read_lock( [&]()
+      {
+         FC_ASSERT( revision() == head_block_num(), "State can be exported only before any block or transaction is pushed",
+            ("rev", revision())("head_block", head_block_num()) );
+
+         state_snapshot_manifest manifest;
+         manifest.chain_id = get_chain_id();
+         manifest.genesis_time = get_dynamic_global_properties().genesis_time;
+         manifest.head_block_num = head_block_num();
+         manifest.head_block_id = head_block_id();
+
+         vector< std::shared_ptr< abstract_state_snapshot_index > > indexes;
+         for_each_index_extension< abstract_state_snapshot_index >( [&]( const std::shared_ptr< abstract_state_snapshot_index >& e )
+         {
+            indexes.push_back( e );
+         });
+
+         ilog( "Exporting state at block ${b} to ${d}", ("b", manifest.head_block_num)("d", dir) );
+         auto start = fc::time_point::now();
+
+         fc::create_directories( dir );
+         manifest.indexes.resize( indexes.size() );
+
+         // Indexes are only read, so they are exported all at once
+         run_in_parallel( indexes.size(), [&]( size_t i )
+         {
+            manifest.indexes[ i ] = indexes[ i ]->export_index( *this, state_snapshot_file( dir, indexes[ i ]->type_name() ) );
+         });
+
+         // the payloads referenced by the exported state are on disk, the background writer only appends after them
+         if( _custom_content_archive.is_open() )
+         {
+            fc::remove_all( dir / "custom_content.archive" );
+            fc::copy( _custom_content_archive.path(), dir / "custom_content.archive" );
+         }
+
+         fc::json::save_to_file( manifest, dir / SOPHIATX_STATE_SNAPSHOT_MANIFEST );
+
+         auto end = fc::time_point::now();
+         ilog( "Done exporting state, elapsed time: ${t} sec", ("t",double((end-start).count())/1000000.0 ) );
+      });
+   }
+   FC_CAPTURE_AND_RETHROW( (dir) )
+}
+
+uint32_t database::import_state( const open_args& args, const fc::path& dir, const genesis_state_type& genesis, const public_key_type& init_pubkey )
+{
+   try
+   {
+      ilog( "Importing state from ${d}", ("d", dir) );
+      auto start = fc::time_point::now();
+
+      auto manifest = fc::json::from_file( dir / SOPHIATX_STATE_SNAPSHOT_MANIFEST ).as< state_snapshot_manifest >();
+      FC_ASSERT( manifest.version == SOPHIATX_STATE_SNAPSHOT_VERSION, "Unsupported state snapshot version ${v}", ("v", manifest.version) );
+
+      chain_id_type chain_id = genesis.compute_chain_id();
+      FC_ASSERT( manifest.chain_id == chain_id, "State snapshot belongs to another chain",
+         ("snapshot", manifest.chain_id)("chain", chain_id) );
+
+      // the snapshot is loaded next to the current state, which is replaced only once the whole snapshot is verified
+      fc::path import_dir = args.shared_mem_dir / "state_import";
+      fc::remove_all( import_dir );
+      fc::create_directories( import_dir );
+      if( fc::exists( dir / "custom_content.archive" ) )
+         fc::copy( dir / "custom_content.archive", import_dir / "custom_content.archive" );
+
+      chainbase::database::open( import_dir, args.chainbase_flags, args.shared_file_size );
+
+      initialize_indexes();
+      initialize_evaluators();
+
+      try
+      {
+         with_write_lock( [&]()
+         {
+            std::map< std::string, std::shared_ptr< abstract_state_snapshot_index > > indexes;
+            for_each_index_extension< abstract_state_snapshot_index >( [&]( const std::shared_ptr< abstract_state_snapshot_index >& e )
+            {
+               indexes[ e->type_name() ] = e;
+            });
+
+            vector< std::pair< std::shared_ptr< abstract_state_snapshot_index >, const state_snapshot_index* > > to_import;
+            for( const auto& info : manifest.indexes )
+            {
+               auto itr = indexes.find( info.type_name );
+               if( itr == indexes.end() )
+               {
+                  wlog( "Skipping ${t}, the index is not registered by any enabled plugin", ("t", info.type_name) );
+                  continue;
+               }
+
+               FC_ASSERT( itr->second->type_id() == info.type_id, "Object type id of ${t} does not match the snapshot", ("t", info.type_name) );
+               to_import.emplace_back( itr->second, &info );
+               indexes.erase( itr );
+            }
+
+            for( const auto& missing : indexes )
+               FC_ASSERT( false, "State snapshot does not contain index ${t}", ("t", missing.first) );
+
+            // Every index is loaded by its own thread, allocations in the shared memory segment are synchronized by the segment manager
+            run_in_parallel( to_import.size(), [&]( size_t i )
+            {
+               const auto& info = *to_import[ i ].second;
+               to_import[ i ].first->import_index( *this, info, state_snapshot_file( dir, info.type_name ) );
+            });
+
+            FC_ASSERT( head_block_num() == manifest.head_block_num && head_block_id() == manifest.head_block_id,
+               "Imported head block does not match the snapshot manifest" );
+
+            modify( get_dynamic_global_properties(), [&]( dynamic_global_property_object& p )
+            {
+               p.chain_id = manifest.chain_id;
+               p.genesis_time = manifest.genesis_time;
+            });
+            set_revision( head_block_num() );
+         });
+
+         chainbase::database::flush();
+      }
+      catch( ... )
+      {
+         chainbase::database::wipe( import_dir );
+         fc::remove_all( import_dir );
+         throw;
+      }
+
+      fc::remove_all( args.shared_mem_dir / "custom_content.archive" );
+      chainbase::database::move_to( args.shared_mem_dir );
+      if( fc::exists( import_dir / "custom_content.archive" ) )
+         fc::rename( import_dir / "custom_content.archive", args.shared_mem_dir / "custom_content.archive" );
+      fc::remove_all( import_dir );
+
+      _open_custom_content_archive( args );
+      _open_block_log( args );
+
+      auto log_head = _block_log.head();
+      if( log_head && log_head->block_num() > head_block_num() )
+      {
+         ilog( "Replaying blocks ${f} - ${l} following the snapshot", ("f", head_block_num() + 1)("l", log_head->block_num()) );
+
+         with_write_lock( [&]()
+         {
+            _block_log.set_locking( false );
+
+            uint64_t pos = _block_log.get_block_pos( head_block_num() + 1 );
+            while( head_block_num() < log_head->block_num() )
+            {
+               auto itr = _block_log.read_block( pos );
+               pos = itr.second;
+               apply_block( itr.first, replay_skip_flags );
+            }
+
+            set_revision( head_block_num() );
+            _block_log.set_locking( true );
+         });
+
+         _fork_db.reset();
+         _fork_db.start_block( *log_head );
+      }
+
+      auto end = fc::time_point::now();
+      ilog( "Done importing state, elapsed time: ${t} sec", ("t",double((end-start).count())/1000000.0 ) );
+
+      return head_block_num();
+   }
+   FC_CAPTURE_AND_RETHROW( (dir)(args.shared_mem_dir) )
+}
+
 void database::close(bool rewind)
 {
    try
@@ -222,10 +557,16 @@ void database::close(bool rewind)
       // DB state (issue #336).
       clear_pending();
 
+      // make sure all irreversible blocks are on disk before the state is flushed
+      _block_log.fence();
+
       chainbase::database::flush();
       chainbase::database::close();
 
+      _custom_content_archive.close();
+      _block_log_trx_index.close();
       _block_log.close();
+      _block_cache.clear();
 
       _fork_db.reset();
    }
@@ -266,7 +607,7 @@ block_id_type database::find_block_id_for_num( uint32_t block_num )const
       }
 
       // Next we query the block log.   Irreversible blocks are here.
-      auto b = _block_log.read_block_by_num( block_num );
+      auto b = _read_block_from_log( block_num );
       if( b.valid() )
          return b->id();
 
@@ -293,7 +634,13 @@ optional<signed_block> database::fetch_block_by_id( const block_id_type& id )con
    auto b = _fork_db.fetch_block( id );
    if( !b )
    {
-      auto tmp = _block_log.read_block_by_num( protocol::block_header::num_from_id( id ) );
+      auto tmp = _block_cache.fetch_by_id( id );
+      if( tmp )
+         return tmp;
+
+      tmp = _block_log.read_block_by_num( protocol::block_header::num_from_id( id ) );
+      if( tmp )
+         _block_cache.insert( *tmp );
 
       if( tmp && tmp->id() == id )
          return tmp;
@@ -313,11 +660,51 @@ optional<signed_block> database::fetch_block_by_number( uint32_t block_num )cons
    if( results.size() == 1 )
       b = results[0]->data;
    else
-      b = _block_log.read_block_by_num( block_num );
+      b = _read_block_from_log( block_num );
 
    return b;
 } FC_LOG_AND_RETHROW() }
 
+optional<signed_block> database::_read_block_from_log( uint32_t block_num )const
+{
+   auto b = _block_cache.fetch_by_number( block_num );
+   if( !b )
+   {
+      b = _block_log.read_block_by_num( block_num );
+      if( b )
+         _block_cache.insert( *b );
+   }
+
+   return b;
+}
+
+custom_content_payload database::get_custom_content_payload( const custom_content_payload_object& payload )const
+{ try {
+   if( !payload.archived )
+      return database_interface::get_custom_content_payload( payload );
+
+   return fc::raw::unpack_from_vector< custom_content_payload >( _custom_content_archive.read( payload.archive_pos, payload.archive_size ), 0 );
+} FC_CAPTURE_AND_RETHROW( (payload.id) ) }
+
+optional<annotated_signed_transaction> database::fetch_transaction_from_block_log( const transaction_id_type& trx_id )const
+{ try {
+   optional< annotated_signed_transaction > result;
+   if( !_block_log_trx_index.is_open() )
+      return result;
+
+   auto trx = _block_log_trx_index.read_transaction( trx_id );
+   if( trx )
+   {
+      signed_transaction unpacked;
+      fc::raw::unpack_from_vector( trx->packed_trx, unpacked, 0 );
+      result = annotated_signed_transaction( unpacked );
+      result->block_num = trx->location.block_num;
+      result->transaction_num = trx->location.trx_in_block;
+   }
+
+   return result;
+} FC_CAPTURE_AND_RETHROW( (trx_id) ) }
+
 const signed_transaction database::get_recent_transaction( const transaction_id_type& trx_id ) const
 { try {
    auto& index = get_index<transaction_index>().indices().get<by_trx_id>();
@@ -528,6 +915,11 @@ bool database::before_last_checkpoint()const
  * @return true if we switched forks as a result of this push.
  */
 bool database::push_block(const signed_block& new_block, uint32_t skip)
+{
+   return push_block( new_block, skip, transaction_envelopes() );
+}
+
+bool database::push_block(const signed_block& new_block, uint32_t skip, const transaction_envelopes& envelopes)
 {
    //fc::time_point begin_time = fc::time_point::now();
 
@@ -538,7 +930,7 @@ bool database::push_block(const signed_block& new_block, uint32_t skip)
       {
          try
          {
-            result = _push_block(new_block);
+            result = _push_block(new_block, envelopes);
          }
          FC_CAPTURE_AND_RETHROW( (new_block) )
 
@@ -570,14 +962,25 @@ void database::_maybe_warn_multiple_production( uint32_t height )const
 }
 
 bool database::_push_block(const signed_block& new_block)
+{
+   return _push_block( new_block, transaction_envelopes() );
+}
+
+bool database::_push_block(const signed_block& new_block, const transaction_envelopes& envelopes)
 { try {
 
    uint32_t skip = node_properties().skip_flags;
    //uint32_t skip_undo_db = skip & skip_undo_block;
 
+   // the fork database keeps the envelopes, so a fork switch or a pop does not recover the signatures again
+   transaction_envelopes made_envelopes;
+   if( envelopes.size() != new_block.transactions.size() && !( skip & skip_fork_db ) )
+      made_envelopes = make_transaction_envelopes( new_block, get_chain_id() );
+   const transaction_envelopes& block_envelopes = made_envelopes.size() ? made_envelopes : envelopes;
+
    if( !(skip&skip_fork_db) )
    {
-      shared_ptr<fork_item> new_head = _fork_db.push_block(new_block);
+      shared_ptr<fork_item> new_head = _fork_db.push_block(new_block, block_envelopes);
       _maybe_warn_multiple_production( new_head->num );
 
       //If the head block from the longest chain does not build off of the current head, we need to switch forks.
@@ -602,7 +1005,7 @@ bool database::_push_block(const signed_block& new_block)
                 try
                 {
                    auto session = start_undo_session();
-                   apply_block( (*ritr)->data, skip );
+                   apply_block( (*ritr)->data, skip, (*ritr)->envelopes );
                    session.push();
                 }
                 catch ( const fc::exception& e ) { except = e; }
@@ -625,7 +1028,7 @@ bool database::_push_block(const signed_block& new_block)
                    for( auto ritr = branches.second.rbegin(); ritr != branches.second.rend(); ++ritr )
                    {
                       auto session = start_undo_session();
-                      apply_block( (*ritr)->data, skip );
+                      apply_block( (*ritr)->data, skip, (*ritr)->envelopes );
                       session.push();
                    }
                    throw *except;
@@ -641,7 +1044,7 @@ bool database::_push_block(const signed_block& new_block)
    try
    {
       auto session = start_undo_session();
-      apply_block(new_block, skip);
+      apply_block(new_block, skip, block_envelopes);
       session.push();
    }
    catch( const fc::exception& e )
@@ -664,12 +1067,17 @@ bool database::_push_block(const signed_block& new_block)
  * queues.
  */
 void database::push_transaction( const signed_transaction& trx, uint32_t skip )
+{
+   push_transaction( std::make_shared< transaction_envelope >( trx, get_chain_id() ), skip );
+}
+
+void database::push_transaction( const transaction_envelope_ptr& trx, uint32_t skip )
 {
    try
    {
       try
       {
-         FC_ASSERT( fc::raw::pack_size(trx) <= SOPHIATX_MAX_TRANSACTION_SIZE, "Transaction size is bigger than SOPHIATX_MAX_TRANSACTION_SIZE");
+         FC_ASSERT( trx->packed_size() <= SOPHIATX_MAX_TRANSACTION_SIZE, "Transaction size is bigger than SOPHIATX_MAX_TRANSACTION_SIZE");
          set_producing( true );
          detail::with_skip_flags( *this, skip,
             [&]()
@@ -684,15 +1092,24 @@ void database::push_transaction( const signed_transaction& trx, uint32_t skip )
          throw;
       }
    }
-   FC_CAPTURE_AND_RETHROW( (trx) )
+   FC_CAPTURE_AND_RETHROW( (trx->get_transaction()) )
 }
 
 void database::_push_transaction( const signed_transaction& trx )
+{
+   _push_transaction( std::make_shared< transaction_envelope >( trx, get_chain_id() ) );
+}
+
+void database::_push_transaction( const transaction_envelope_ptr& trx )
 {
    // If this is the first transaction pushed after applying a block, start a new undo session.
    // This allows us to quickly rewind to the clean state of the head block, in case a new block arrives.
    if( !_pending_tx_session.valid() )
+   {
       _pending_tx_session = start_undo_session();
+      if( _pending_tx.empty() )
+         _pending_tx.set_head( head_block_id(), head_block_time(), get_hardfork_property_object().current_hardfork_version );
+   }
 
    // Create a temporary undo session as a child of _pending_tx_session.
    // The temporary session will be discarded by the destructor if
@@ -700,15 +1117,19 @@ void database::_push_transaction( const signed_transaction& trx )
    // apply the changes.
 
    auto temp_session = start_undo_session();
-   _apply_transaction( trx );
-   _pending_tx.push_back( trx );
+   _apply_transaction( *trx );
+
+   flat_set< account_name_type > fee_payers;
+   for( const auto& op : trx->get_transaction().operations )
+      fee_payers.insert( get_fee_payer( op ) );
+   _pending_tx.push_back( trx, fee_payers );
 
    notify_changed_objects();
    // The transaction applied successfully. Merge its changes into the pending block session.
    temp_session.squash();
 
    // notify anyone listening to pending transactions
-   notify_on_pending_transaction( trx );
+   notify_on_pending_transaction( trx->get_transaction() );
 }
 
 signed_block database::generate_block(
@@ -734,7 +1155,8 @@ signed_block database::generate_block(
 signed_block database::_generate_block(
    fc::time_point_sec when,
    const account_name_type& witness_owner,
-   const fc::ecc::private_key& block_signing_private_key
+   const fc::ecc::private_key& block_signing_private_key,
+   bool reapply_pending
    )
 {
    uint32_t skip = node_properties().skip_flags;
@@ -755,52 +1177,91 @@ signed_block database::_generate_block(
    size_t total_block_size = max_block_header_size;
 
    signed_block pending_block;
+   transaction_envelopes pending_envelopes;
 
    //
-   // The following code throws away existing pending_tx_session and
-   // rebuilds it by re-applying pending transactions.
+   // _pending_tx_session is the result of applying _pending_tx in order on top of the head block. Transactions
+   // expiring before "when" and transactions not fitting into the block are left out.
    //
-   // This rebuild is necessary because pending transactions' validity
-   // and semantics may have changed since they were received, because
-   // time-based semantics are evaluated based on the current block
-   // time.  These changes can only be reflected in the database when
-   // the value of the "when" variable is known, which means we need to
-   // re-apply pending transactions in this method.
+   // Rebuilding the pending state by re-applying pending transactions is necessary when pending transactions'
+   // validity and semantics may have changed since they were received, because time-based semantics are
+   // evaluated based on the current block time. The block applies its transactions on top of the head block
+   // before its own time becomes the head block time and before the hardforks due at its time are processed, so
+   // they are evaluated with the head block time and hardfork just like the pending state. The pending state
+   // can be taken as it is when
+   //  - it was applied on the current head block, with its time and hardfork,
+   //  - the head block is not the genesis, block 1 applies the genesis hardforks before its transactions,
+   //  - no remaining transaction depends on an account impacted by a left out transaction before it, the
+   //    dependencies are the impacted accounts and the fee payers.
    //
-   _pending_tx_session.reset();
-   _pending_tx_session = start_undo_session();
+   // Otherwise the pending state is thrown away and rebuilt by re-applying the remaining transactions,
+   // dropping those which fail. Leaving out a transaction may still affect state not tied to any account, so a
+   // block taken from the pending state which is rejected is generated again with the state rebuilt.
+   //
+   const auto& pending_txs = _pending_tx.indices().get< pending_transaction_pool::by_sequence >();
+   bool reuse_pending = !reapply_pending
+                        && _pending_tx_session.valid()
+                        && _pending_tx.head() == head_block_id()
+                        && _pending_tx.head_time() == head_block_time()
+                        && _pending_tx.head_hardfork() == get_hardfork_property_object().current_hardfork_version
+                        && head_block_num() > 0;
+   flat_set< uint64_t > left_out;
    uint64_t postponed_tx_count = 0;
-   // pop pending state (reset to head block state)
-   for( const signed_transaction& tx : _pending_tx )
+
+   for( const auto& pending : pending_txs )
    {
       // Only include transactions that have not expired yet for currently generating block,
       // this should clear problem transactions and allow block production to continue
-      if( tx.expiration < when )
+      if( pending.expiration < when )
+      {
+         left_out.insert( pending.sequence );
          continue;
-      uint64_t new_total_size = total_block_size + fc::raw::pack_size( tx );
+      }
+      uint64_t new_total_size = total_block_size + pending.trx->packed_size();
       // postpone transaction if it would make block too big
       if( new_total_size >= maximum_block_size )
       {
          postponed_tx_count++;
+         left_out.insert( pending.sequence );
          continue;
       }
-      try
-      {
-         auto temp_session = start_undo_session();
-         _apply_transaction( tx );
-         temp_session.squash();
+      total_block_size = new_total_size;
+      pending_envelopes.push_back( pending.trx );
+   }
 
-         total_block_size += fc::raw::pack_size( tx );
-         pending_block.transactions.push_back( tx );
-      }
-      catch ( const fc::exception& e )
+   if( reuse_pending && left_out.size() )
+      reuse_pending = !_pending_tx.has_dependents( left_out );
+
+   if( !reuse_pending )
+   {
+      _pending_tx_session.reset();
+      _pending_tx_session = start_undo_session();
+      pending_envelopes.clear();
+
+      for( const auto& pending : pending_txs )
       {
-         // Do nothing, transaction will not be re-applied
-         //wlog( "Transaction was not processed while generating block due to ${e}", ("e", e) );
-         //wlog( "The transaction was ${t}", ("t", tx) );
+         if( left_out.find( pending.sequence ) != left_out.end() )
+            continue;
+         try
+         {
+            auto temp_session = start_undo_session();
+            _apply_transaction( *pending.trx );
+            temp_session.squash();
+
+            pending_envelopes.push_back( pending.trx );
+         }
+         catch ( const fc::exception& e )
+         {
+            // Do nothing, transaction will not be re-applied
+            //wlog( "Transaction was not processed while generating block due to ${e}", ("e", e) );
+            //wlog( "The transaction was ${t}", ("t", tx) );
+         }
       }
    }
 
+   for( const auto& tx : pending_envelopes )
+      pending_block.transactions.push_back( tx->get_transaction() );
+
    if( postponed_tx_count > 0 )
    {
       wlog( "Postponed ${n} transactions due to block size limit", ("n", postponed_tx_count) );
@@ -817,7 +1278,7 @@ signed_block database::_generate_block(
 
    pending_block.previous = head_block_id();
    pending_block.timestamp = when;
-   pending_block.transaction_merkle_root = pending_block.calculate_merkle_root();
+   pending_block.transaction_merkle_root = calculate_merkle_root( pending_envelopes );
    pending_block.witness = witness_owner;
    {
       const auto& witness = get_witness( witness_owner );
@@ -847,12 +1308,27 @@ signed_block database::_generate_block(
    // TODO:  Move this to _push_block() so session is restored.
    if( !(skip & skip_block_size_check) )
    {
-      FC_ASSERT( fc::raw::pack_size(pending_block) <= SOPHIATX_MAX_BLOCK_SIZE );
+      FC_ASSERT( packed_block_size( pending_block, pending_envelopes ) <= SOPHIATX_MAX_BLOCK_SIZE );
    }
 
-   push_block( pending_block, skip );
+   if( !reuse_pending )
+   {
+      push_block( pending_block, skip, pending_envelopes );
+      return pending_block;
+   }
+
+   try
+   {
+      push_block( pending_block, skip, pending_envelopes );
+      return pending_block;
+   }
+   catch( const fc::exception& e )
+   {
+      wlog( "Block taken from the pending state was rejected, generating it again: ${e}", ("e", e.to_string()) );
+   }
 
-   return pending_block;
+   // push_block() applied the pending transactions on top of the head block again, the rebuilt block is final
+   return _generate_block( when, witness_owner, block_signing_private_key, true );
 }
 
 /**
@@ -864,16 +1340,26 @@ void database::pop_block()
    try
    {
       _pending_tx_session.reset();
+      // the pending transactions are not applied any more
+      _pending_tx.set_head( block_id_type() );
       auto head_id = head_block_id();
 
       /// save the head block so we can recover its transactions
       optional<signed_block> head_block = fetch_block_by_id( head_id );
       SOPHIATX_ASSERT( head_block.valid(), pop_empty_chain, "there are no blocks to pop" );
 
+      // the envelopes kept by the fork database still hold the recovered signing keys
+      auto head_item = _fork_db.fetch_block( head_id );
+      transaction_envelopes popped;
+      if( head_item && head_item->envelopes.size() == head_block->transactions.size() )
+         popped = head_item->envelopes;
+      else
+         popped = make_transaction_envelopes( *head_block, get_chain_id() );
+
       _fork_db.pop_block();
       undo();
 
-      _popped_tx.insert( _popped_tx.begin(), head_block->transactions.begin(), head_block->transactions.end() );
+      _popped_tx.insert( _popped_tx.begin(), popped.begin(), popped.end() );
 
    }
    FC_CAPTURE_AND_RETHROW()
@@ -949,6 +1435,8 @@ void database::vest(const account_object& a, const share_type delta)
    modify( cprops, [&]( dynamic_global_property_object& o )
    {
         o.total_vesting_shares.amount += delta;
+        o.total_account_balances.amount -= delta;
+        o.total_account_vesting.amount += delta;
    });
 }
 
@@ -1075,6 +1563,7 @@ void database::clear_null_account_balance()
       modify( gpo, [&]( dynamic_global_property_object& g )
       {
          g.total_vesting_shares -= null_account.vesting_shares;
+         g.total_account_vesting -= null_account.vesting_shares;
       });
 
       modify( null_account, [&]( account_object& a )
@@ -1152,6 +1641,8 @@ void database::process_vesting_withdrawals()
       modify( cprops, [&]( dynamic_global_property_object& o )
       {
          o.total_vesting_shares.amount -= to_withdraw;
+         o.total_account_balances.amount += to_withdraw;
+         o.total_account_vesting.amount -= to_withdraw;
       });
 
       //if( to_withdraw > 0 )
@@ -1259,6 +1750,7 @@ void database::expire_escrow_ratification()
 
       adjust_balance( old_escrow.from, old_escrow.sophiatx_balance );
       adjust_balance( old_escrow.from, old_escrow.pending_fee );
+      adjust_escrow_holdings_total( -( old_escrow.sophiatx_balance + old_escrow.pending_fee ) );
 
       remove( old_escrow );
    }
@@ -1306,11 +1798,14 @@ void database::initialize_indexes()
 {
    add_core_index< dynamic_global_property_index           >(shared_from_this());
    add_core_index< economic_model_index                    >(shared_from_this());
+   add_core_index< economic_historic_supply_index          >(shared_from_this());
    add_core_index< account_index                           >(shared_from_this());
    add_core_index< account_authority_index                 >(shared_from_this());
    add_core_index< witness_index                           >(shared_from_this());
    add_core_index< transaction_index                       >(shared_from_this());
    add_core_index< block_summary_index                     >(shared_from_this());
+   add_core_index< block_stats_index                       >(shared_from_this());
+   add_core_index< block_stats_window_index                >(shared_from_this());
    add_core_index< witness_schedule_index                  >(shared_from_this());
    add_core_index< witness_vote_index                      >(shared_from_this());
    add_core_index< feed_history_index                      >(shared_from_this());
@@ -1324,6 +1819,9 @@ void database::initialize_indexes()
    add_core_index< application_index                       >(shared_from_this());
    add_core_index< application_buying_index                >(shared_from_this());
    add_core_index< custom_content_index                    >(shared_from_this());
+   add_core_index< custom_content_payload_index            >(shared_from_this());
+   add_core_index< custom_content_sequence_index           >(shared_from_this());
+   add_core_index< custom_content_storage_index            >(shared_from_this());
    add_core_index< account_fee_sponsor_index               >(shared_from_this());
    _plugin_index_signal();
 }
@@ -1445,6 +1943,7 @@ void database::init_genesis( genesis_state_type genesis, chain_id_type chain_id,
          p.recent_slots_filled = fc::uint128::max_value();
          p.participation_count = 128;
          p.current_supply = asset( total_initial_balance, SOPHIATX_SYMBOL );
+         p.total_account_balances = asset( total_initial_balance, SOPHIATX_SYMBOL );
          p.maximum_block_size = SOPHIATX_MAX_BLOCK_SIZE;
          p.witness_required_vesting = asset(genesis.is_private_net? 0 : SOPHIATX_INITIAL_WITNESS_REQUIRED_VESTING_BALANCE, VESTS_SYMBOL);
          p.genesis_time = genesis.genesis_time;
@@ -1456,6 +1955,8 @@ void database::init_genesis( genesis_state_type genesis, chain_id_type chain_id,
                                                 {
                                                     e.init_economics(total_initial_balance, SOPHIATX_TOTAL_SUPPLY);
                                                 } );
+      for( uint32_t slot = 0; slot < SOPHIATX_INTEREST_BLOCKS; slot++ )
+         create< economic_historic_supply_object >( [&]( economic_historic_supply_object& h ) { h.slot = slot; } );
       // Nothing to do
       create< feed_history_object >( [&]( feed_history_object& o ) {o.symbol = SBD1_SYMBOL;});
       create< feed_history_object >( [&]( feed_history_object& o ) {o.symbol = SBD2_SYMBOL;});
@@ -1466,6 +1967,10 @@ void database::init_genesis( genesis_state_type genesis, chain_id_type chain_id,
       for( int i = 0; i < 0x10000; i++ )
          create< block_summary_object >( [&]( block_summary_object& ) {});
 
+      for( int i = 0; i < SOPHIATX_BLOCK_STATS_WINDOW; i++ )
+         create< block_stats_object >( [&]( block_stats_object& ) {});
+      create< block_stats_window_object >( [&]( block_stats_window_object& ) {});
+
       create< hardfork_property_object >( [&](hardfork_property_object& hpo )
       {
          hpo.processed_hardforks.push_back( genesis.genesis_time );
@@ -1486,7 +1991,7 @@ void database::validate_transaction( const signed_transaction& trx )
    database::with_write_lock( [&]()
    {
       auto session = start_undo_session();
-      _apply_transaction( trx );
+      _apply_transaction( transaction_envelope( trx, get_chain_id() ) );
       session.undo();
    });
 }
@@ -1522,7 +2027,7 @@ void database::notify_changed_objects()
 
 //////////////////// private methods ////////////////////
 
-void database::apply_block( const signed_block& next_block, uint32_t skip )
+void database::apply_block( const signed_block& next_block, uint32_t skip, const transaction_envelopes& envelopes )
 { try {
    //fc::time_point begin_time = fc::time_point::now();
 
@@ -1551,7 +2056,7 @@ void database::apply_block( const signed_block& next_block, uint32_t skip )
 
    detail::with_skip_flags( *this, skip, [&]()
    {
-      _apply_block( next_block );
+      _apply_block( next_block, envelopes );
    } );
 
    try
@@ -1593,7 +2098,7 @@ void database::apply_block( const signed_block& next_block, uint32_t skip )
 
 } FC_CAPTURE_AND_RETHROW( (next_block) ) }
 
-void database::_apply_block( const signed_block& next_block )
+void database::_apply_block( const signed_block& next_block, const transaction_envelopes& envelopes )
 { try {
    uint32_t next_block_num = next_block.block_num();
    //block_id_type next_block_id = next_block.id();
@@ -1637,9 +2142,15 @@ void database::_apply_block( const signed_block& next_block )
       }
    }
 
+   // envelopes prepared by the caller are reused, otherwise each transaction is packed and hashed only once here
+   transaction_envelopes made_envelopes;
+   if( envelopes.size() != next_block.transactions.size() )
+      made_envelopes = make_transaction_envelopes( next_block, get_chain_id() );
+   const transaction_envelopes& block_envelopes = envelopes.size() == next_block.transactions.size() ? envelopes : made_envelopes;
+
    if( !( skip & skip_merkle_check ) )
    {
-      auto merkle_root = next_block.calculate_merkle_root();
+      auto merkle_root = calculate_merkle_root( block_envelopes );
 
       try
       {
@@ -1661,7 +2172,7 @@ void database::_apply_block( const signed_block& next_block )
    _current_trx_in_block = 0;
 
    const auto& gprops = get_dynamic_global_properties();
-   auto block_size = fc::raw::pack_size( next_block );
+   auto block_size = packed_block_size( next_block, block_envelopes );
    FC_ASSERT( block_size <= gprops.maximum_block_size, "Block Size is too Big", ("next_block_num",next_block_num)("block_size", block_size)("max",gprops.maximum_block_size) );
 
 
@@ -1689,7 +2200,7 @@ void database::_apply_block( const signed_block& next_block )
       );
 
 
-   for( const auto& trx : next_block.transactions )
+   for( const auto& trx : block_envelopes )
    {
       /* We do not need to push the undo state for each transaction
        * because they either all apply and are valid or the
@@ -1697,7 +2208,7 @@ void database::_apply_block( const signed_block& next_block )
        * for transactions when validating broadcast transactions or
        * when building a block.
        */
-      apply_transaction( trx, skip );
+      apply_transaction( *trx, skip );
       ++_current_trx_in_block;
    }
 
@@ -1708,8 +2219,10 @@ void database::_apply_block( const signed_block& next_block )
    update_signing_witness(signing_witness, next_block);
 
    update_last_irreversible_block();
+   archive_custom_content();
 
    create_block_summary(next_block);
+   update_block_stats(next_block, block_envelopes, block_size);
    clear_expired_transactions();
    update_witness_schedule(std::static_pointer_cast<database>(shared_from_this()));
    if(!is_private_net()) {
@@ -1732,8 +2245,13 @@ void database::_apply_block( const signed_block& next_block )
    if(!is_private_net()) {
       const auto& econ = get_economic_model();
       const auto& gpo = get_dynamic_global_properties();
+      const auto& historic = get< economic_historic_supply_object, by_slot >( next_block_num % SOPHIATX_INTEREST_BLOCKS );
+      share_type replaced_supply = historic.supply;
+      modify(historic, [ & ](economic_historic_supply_object &h) {
+           h.supply = gpo.current_supply.amount;
+      });
       modify(econ, [ & ](economic_model_object &e) {
-           e.record_block(next_block_num, gpo.current_supply.amount);
+           e.record_block(gpo.current_supply.amount, replaced_supply);
       });
    }
 
@@ -1830,16 +2348,26 @@ void database::process_interests() {
       uint32_t batch = block_no % interest_blocks;
       const auto &econ = get_economic_model();
       share_type supply_increase = 0;
+
+      vector< std::pair< const account_object*, share_type > > batch_interests;
       uint64_t id = batch;
       while( const account_object *a = find_account(id)) {
-         share_type interest = 0;
+         batch_interests.emplace_back( a, 0 );
+         id += interest_blocks;
+      }
 
-         if( head_block_num() > SOPHIATX_INTEREST_DELAY) {
-            modify(econ, [ & ](economic_model_object &eo) {
-               interest = eo.withdraw_interests(a->holdings_considered_for_interests,
+      // withdraw interests of the whole batch in a single economic model update
+      if( head_block_num() > SOPHIATX_INTEREST_DELAY && !batch_interests.empty() ) {
+         modify(econ, [ & ](economic_model_object &eo) {
+            for( auto& i : batch_interests )
+               i.second = eo.withdraw_interests(i.first->holdings_considered_for_interests,
                      std::min(uint32_t(interest_blocks), head_block_num()));
-            });
-         }
+         });
+      }
+
+      for( const auto& i : batch_interests ) {
+         const account_object *a = i.first;
+         share_type interest = i.second;
 
          if( interest > 0 ) {
             supply_increase += interest;
@@ -1852,10 +2380,10 @@ void database::process_interests() {
               ao.balance.amount += interest;
               ao.holdings_considered_for_interests = ao.total_balance() * interest_blocks;
          });
-         id += interest_blocks;
       }
 
       adjust_supply(asset(supply_increase, SOPHIATX_SYMBOL));
+      adjust_account_holdings_total(asset(supply_increase, SOPHIATX_SYMBOL));
    }FC_CAPTURE_AND_RETHROW()
 }
 
@@ -1906,25 +2434,25 @@ try {
    }
 } FC_CAPTURE_AND_RETHROW() }
 
-void database::apply_transaction(const signed_transaction& trx, uint32_t skip)
+void database::apply_transaction(const transaction_envelope& trx, uint32_t skip)
 {
    detail::with_skip_flags( *this, skip, [&]() { _apply_transaction(trx); });
-   notify_on_applied_transaction( trx );
+   notify_on_applied_transaction( trx.get_transaction() );
 }
 
-void database::_apply_transaction(const signed_transaction& trx)
+void database::_apply_transaction(const transaction_envelope& envelope)
 { try {
-   _current_trx_id = trx.id();
+   const signed_transaction& trx = envelope.get_transaction();
+   _current_trx_id = envelope.id();
    _current_virtual_op = 0;
    uint32_t skip = node_properties().skip_flags;
 
    if( !(skip&skip_validate) ) {   /* issue #505 explains why this skip_flag is disabled */
-      trx.validate();
+      envelope.validate();
    }
 
    auto& trx_idx = get_index<transaction_index>();
-   const chain_id_type& chain_id = get_chain_id();
-   auto trx_id = trx.id();
+   const auto& trx_id = envelope.id();
    // idump((trx_id)(skip&skip_transaction_dupe_check));
    FC_ASSERT( (skip & skip_transaction_dupe_check) ||
               trx_idx.indices().get<by_trx_id>().find(trx_id) == trx_idx.indices().get<by_trx_id>().end(),
@@ -1935,10 +2463,14 @@ void database::_apply_transaction(const signed_transaction& trx)
       auto get_active  = [&]( const string& name ) { return authority( get< account_authority_object, by_account >( name ).active ); };
       auto get_owner   = [&]( const string& name ) { return authority( get< account_authority_object, by_account >( name ).owner );  };
 
+      auto canon_type = has_hardfork(SOPHIATX_HARDFORK_1_1) ? fc::ecc::bip_0062 : fc::ecc::fc_canonical;
+
       try
       {
-         trx.verify_authority( chain_id, get_active, get_owner, SOPHIATX_MAX_SIG_CHECK_DEPTH,
-                               has_hardfork(SOPHIATX_HARDFORK_1_1) ? fc::ecc::bip_0062 : fc::ecc::fc_canonical);
+         for( const auto& sig : trx.signatures )
+            FC_ASSERT( fc::ecc::public_key::is_canonical( sig, canon_type ), "signature is not canonical" );
+
+         sophiatx::protocol::verify_authority( trx.operations, envelope.signature_keys(), get_active, get_owner, SOPHIATX_MAX_SIG_CHECK_DEPTH );
       }
       catch( protocol::tx_missing_active_auth& e )
       {
@@ -1974,7 +2506,7 @@ void database::_apply_transaction(const signed_transaction& trx)
       create<transaction_object>([&](transaction_object& transaction) {
          transaction.trx_id = trx_id;
          transaction.expiration = trx.expiration;
-         fc::raw::pack_to_buffer( transaction.packed_trx, trx );
+         transaction.packed_trx.assign( envelope.packed().begin(), envelope.packed().end() );
       });
    }
 
@@ -1990,7 +2522,7 @@ void database::_apply_transaction(const signed_transaction& trx)
    }
    _current_trx_id = transaction_id_type();
 
-} FC_CAPTURE_AND_RETHROW( (trx) ) }
+} FC_CAPTURE_AND_RETHROW( (envelope.get_transaction()) ) }
 
 void database::apply_operation(const operation& op)
 {
@@ -2036,6 +2568,148 @@ void database::create_block_summary(const signed_block& next_block)
    });
 } FC_CAPTURE_AND_RETHROW() }
 
+void database::update_block_stats( const signed_block& next_block, const transaction_envelopes& envelopes, uint32_t block_size )
+{ try {
+   uint32_t operations = 0;
+   for( const auto& trx : envelopes )
+      operations += trx->get_transaction().operations.size();
+
+   const auto& stats = get< block_stats_object >( block_stats_id_type( next_block.block_num() % SOPHIATX_BLOCK_STATS_WINDOW ) );
+   const auto& window = get< block_stats_window_object >();
+
+   // the block replaces the one recorded SOPHIATX_BLOCK_STATS_WINDOW blocks ago in the window totals
+   modify( window, [&]( block_stats_window_object& w )
+   {
+      if( stats.block_num )
+      {
+         w.total_size -= stats.block_size;
+         w.total_transactions -= stats.transactions;
+         w.total_operations -= stats.operations;
+      }
+      else
+      {
+         w.blocks++;
+      }
+
+      w.total_size += block_size;
+      w.total_transactions += envelopes.size();
+      w.total_operations += operations;
+   });
+
+   modify( stats, [&]( block_stats_object& s )
+   {
+      s.block_num = next_block.block_num();
+      s.block_size = block_size;
+      s.transactions = envelopes.size();
+      s.operations = operations;
+   });
+} FC_CAPTURE_AND_RETHROW() }
+
+void database::archive_custom_content()
+{ try {
+   if( !_custom_content_archive.is_open() || ( !_custom_content_archive_age && !_custom_content_memory_budget ) )
+      return;
+
+   const auto* storage = find< custom_content_storage_object >();
+   if( storage == nullptr )
+      return;
+
+   // bounds the work of a single block, a lowered budget is reached over several blocks
+   const uint32_t max_archived_per_block = 1000;
+   uint32_t last_irreversible = get_dynamic_global_properties().last_irreversible_block_num;
+
+   //
+   // Payloads are archived in two steps so this thread never waits for the disk. A block hands the payloads to
+   // the background writer of the archive and a later block, once their copies are durable, drops them from
+   // memory. Only payloads of irreversible blocks are archived, so a payload and its copy never change. Dropping
+   // a payload is undone with the block which did it, the copy is kept until that block is irreversible and
+   // is referenced again instead of writing the payload once more.
+   //
+   for( const auto& item : _custom_content_archive.take_written() )
+   {
+      auto& copy = _custom_content_archive_copies[ custom_content_payload_id_type( item.id ) ];
+      copy.pos = item.pos;
+      copy.size = item.size;
+   }
+
+   for( auto itr = _custom_content_archive_copies.begin(); itr != _custom_content_archive_copies.end(); )
+   {
+      const auto* payload = find< custom_content_payload_object >( itr->first );
+      if( payload == nullptr || ( itr->second.block_num && itr->second.block_num <= last_irreversible
+                                  && payload->archived && payload->archive_pos == itr->second.pos ) )
+         itr = _custom_content_archive_copies.erase( itr );
+      else
+         ++itr;
+   }
+
+   // payloads held in memory come first, oldest first
+   const auto& idx = get_index< custom_content_payload_index, by_archived >();
+   std::vector< const custom_content_payload_object* > durable;
+   std::vector< custom_content_archive_item > batch;
+   bool can_write = !_custom_content_archive.is_writing();
+   uint64_t memory_size = storage->memory_size;
+   for( auto itr = idx.begin(); batch.size() < max_archived_per_block && itr != idx.end() && !itr->archived; ++itr )
+   {
+      const auto& payload = *itr;
+      bool expired = _custom_content_archive_age && payload.block_num + _custom_content_archive_age <= head_block_num();
+      bool over_budget = _custom_content_memory_budget && memory_size > _custom_content_memory_budget;
+      if( payload.block_num > last_irreversible || !( expired || over_budget ) )
+         break;
+
+      auto copy = _custom_content_archive_copies.find( payload.id );
+      if( copy != _custom_content_archive_copies.end() )
+      {
+         // written or being written
+         if( copy->second.size )
+            durable.push_back( &payload );
+      }
+      else if( can_write )
+      {
+         custom_content_archive_item item;
+         item.id = payload.id._id;
+         item.packed = fc::raw::pack_to_vector( database_interface::get_custom_content_payload( payload ) );
+         batch.push_back( std::move( item ) );
+         _custom_content_archive_copies[ payload.id ];
+      }
+      else
+      {
+         break;
+      }
+
+      memory_size -= payload.size;
+   }
+
+   if( batch.size() )
+      _custom_content_archive.write_async( std::move( batch ) );
+
+   for( const auto* archived : durable )
+   {
+      const auto& payload = *archived;
+      auto& copy = _custom_content_archive_copies[ payload.id ];
+      copy.block_num = head_block_num();
+
+      modify( *storage, [&]( custom_content_storage_object& s )
+      {
+         s.memory_size -= payload.size;
+         s.archived_size += copy.size;
+         s.archived_payloads++;
+      });
+
+      modify( payload, [&]( custom_content_payload_object& p )
+      {
+         p.all_recipients.clear();
+         p.all_recipients.shrink_to_fit();
+         p.data.clear();
+         p.data.shrink_to_fit();
+         p.json.clear();
+         p.json.shrink_to_fit();
+         p.archived = true;
+         p.archive_pos = copy.pos;
+         p.archive_size = copy.size;
+      });
+   }
+} FC_CAPTURE_AND_RETHROW() }
+
 void database::update_global_dynamic_data( const signed_block& b )
 { try {
    const dynamic_global_property_object& _dgp =
@@ -2169,7 +2843,7 @@ void database::update_last_irreversible_block()
       }
    }
 
-   commit( dpo.last_irreversible_block_num );
+   uint32_t commit_block_num = dpo.last_irreversible_block_num;
 
    if( !( node_properties().skip_flags & skip_block_log ) )
    {
@@ -2188,12 +2862,32 @@ void database::update_last_irreversible_block()
             FC_ASSERT( block, "Current fork in the fork database does not contain the last_irreversible_block" );
             _block_log.append( block->data );
             log_head_num++;
+
+            if( _block_log_trx_index.is_open() )
+            {
+               try
+               {
+                  _block_log_trx_index.append( block->data );
+               }
+               catch( const fc::exception& e )
+               {
+                  // the index is rebuilt from the block log when it is opened next time
+                  elog( "Cannot update block log transaction index, disabling it: ${e}", ("e", e.to_detail_string()) );
+                  _block_log_trx_index.close();
+               }
+            }
          }
 
          _block_log.flush();
       }
+
+      // Undo history is only discarded for blocks which are durable in the block log. With the background
+      // appender this lags behind the last irreversible block by the blocks still being written.
+      commit_block_num = std::min( commit_block_num, _block_log.durable_head_num() );
    }
 
+   commit( commit_block_num );
+
    _fork_db.set_max_size( dpo.head_block_number - dpo.last_irreversible_block_num + 1 );
 } FC_CAPTURE_AND_RETHROW() }
 
@@ -2217,6 +2911,7 @@ void database::create_vesting( const account_object& a, const asset& delta){
         acnt.vesting_shares.amount += delta.amount;
         acnt.update_considered_holding(delta.amount, head_block_num() );
    } );
+   adjust_account_holdings_total(delta);
    adjust_proxied_witness_votes(a, delta.amount);
 }
 
@@ -2235,6 +2930,7 @@ void database::modify_balance( const account_object& a, const asset& delta, bool
         }
 
    } );
+   adjust_account_holdings_total(delta);
    adjust_proxied_witness_votes(a, delta.amount);
 }
 
@@ -2276,6 +2972,40 @@ void database::adjust_supply( const asset& delta )
    } );
 }
 
+void database::adjust_account_holdings_total( const asset& delta )
+{
+   if( delta.amount == 0 )
+      return;
+
+   modify( get_dynamic_global_properties(), [&]( dynamic_global_property_object& props )
+   {
+      switch( delta.symbol.value )
+      {
+         case SOPHIATX_SYMBOL_SER:
+            props.total_account_balances += delta;
+            break;
+         case VESTS_SYMBOL_SER:
+            props.total_account_vesting += delta;
+            break;
+         default:
+            FC_ASSERT( false, "invalid symbol" );
+      }
+   } );
+}
+
+void database::adjust_escrow_holdings_total( const asset& delta )
+{
+   FC_ASSERT( delta.symbol == SOPHIATX_SYMBOL, "invalid symbol" );
+
+   if( delta.amount == 0 )
+      return;
+
+   modify( get_dynamic_global_properties(), [&]( dynamic_global_property_object& props )
+   {
+      props.total_escrow_balances += delta;
+   } );
+}
+
 
 asset database::get_balance( const account_object& a, asset_symbol_type symbol )const
 {
@@ -2398,6 +3128,37 @@ void database::recalculate_all_votes(){
  * Verifies all supply invariantes check out
  */
 void database::validate_invariants()const
+{
+   try
+   {
+      if(is_private_net())
+         return;
+
+      const auto& gpo = get_dynamic_global_properties();
+      const auto& econ = get_economic_model();
+
+      /// verify no witness has too many votes, witnesses are ordered by votes descending
+      const auto& witness_by_vote = get_index< witness_index >().indices().get< by_vote_name >();
+      if( witness_by_vote.begin() != witness_by_vote.end() )
+         FC_ASSERT( witness_by_vote.begin()->votes <= gpo.current_supply.amount, "", ("witness",*witness_by_vote.begin()) );
+
+      FC_ASSERT( gpo.current_supply == gpo.total_account_balances + gpo.total_escrow_balances + asset(gpo.total_account_vesting.amount, SOPHIATX_SYMBOL), "",
+                 ("gpo.current_supply",gpo.current_supply)("total_account_balances",gpo.total_account_balances)
+                 ("total_escrow_balances",gpo.total_escrow_balances)("total_account_vesting",gpo.total_account_vesting) );
+      FC_ASSERT( gpo.total_vesting_shares == gpo.total_account_vesting, "", ("gpo.total_vesting_shares",gpo.total_vesting_shares)("total_account_vesting",gpo.total_account_vesting) );
+
+      FC_ASSERT( (gpo.current_supply.amount + econ.interest_pool_from_fees + econ.interest_pool_from_coinbase +
+                 econ.mining_pool_from_fees + econ.mining_pool_from_coinbase + econ.promotion_pool + econ.burn_pool) == SOPHIATX_TOTAL_SUPPLY, "difference is $diff", ("diff", SOPHIATX_TOTAL_SUPPLY -
+                 (gpo.current_supply.amount + econ.interest_pool_from_fees + econ.interest_pool_from_coinbase +
+                 econ.mining_pool_from_fees + econ.mining_pool_from_coinbase + econ.promotion_pool + econ.burn_pool)));
+
+      if( _invariants_audit_blocks && head_block_num() % _invariants_audit_blocks == 0 )
+         audit_invariants();
+   }
+   FC_CAPTURE_LOG_AND_RETHROW( (head_block_num()) );
+}
+
+void database::audit_invariants()const
 {
    try
    {
@@ -2406,9 +3167,10 @@ void database::validate_invariants()const
       const auto& account_idx = get_index<account_index>().indices().get<by_id>();
       asset total_supply = asset( 0, SOPHIATX_SYMBOL );
       asset total_vesting = asset( 0, VESTS_SYMBOL );
+      asset total_balances = asset( 0, SOPHIATX_SYMBOL );
+      asset total_escrow = asset( 0, SOPHIATX_SYMBOL );
 
       const auto& gpo = get_dynamic_global_properties();
-      const auto& econ = get_economic_model();
 
       /// verify no witness has too many votes
       const auto& witness_idx = get_index< witness_index >().indices();
@@ -2417,7 +3179,7 @@ void database::validate_invariants()const
 
       for( auto itr = account_idx.begin(); itr != account_idx.end(); ++itr )
       {
-         total_supply += itr->balance;
+         total_balances += itr->balance;
          total_vesting += itr->vesting_shares;
       }
 
@@ -2425,23 +3187,22 @@ void database::validate_invariants()const
 
       for( auto itr = escrow_idx.begin(); itr != escrow_idx.end(); ++itr )
       {
-         total_supply += itr->sophiatx_balance;
+         total_escrow += itr->sophiatx_balance;
 
          if( itr->pending_fee.symbol == SOPHIATX_SYMBOL )
-            total_supply += itr->pending_fee;
+            total_escrow += itr->pending_fee;
          else
             FC_ASSERT( false, "found escrow pending fee that is not SPHTX" );
       }
 
+      total_supply = total_balances + total_escrow;
 
       FC_ASSERT( gpo.current_supply == total_supply + asset(total_vesting.amount, SOPHIATX_SYMBOL), "", ("gpo.current_supply",gpo.current_supply)("total_supply",total_supply) );
       FC_ASSERT( gpo.total_vesting_shares == total_vesting, "", ("gpo.total_vesting_shares",gpo.total_vesting_shares)("total_vesting",total_vesting) );
 
-      FC_ASSERT( (gpo.current_supply.amount + econ.interest_pool_from_fees + econ.interest_pool_from_coinbase +
-                 econ.mining_pool_from_fees + econ.mining_pool_from_coinbase + econ.promotion_pool + econ.burn_pool) == SOPHIATX_TOTAL_SUPPLY, "difference is $diff", ("diff", SOPHIATX_TOTAL_SUPPLY -
-                 (gpo.current_supply.amount + econ.interest_pool_from_fees + econ.interest_pool_from_coinbase +
-                 econ.mining_pool_from_fees + econ.mining_pool_from_coinbase + econ.promotion_pool + econ.burn_pool)));
-
+      FC_ASSERT( gpo.total_account_balances == total_balances, "", ("gpo.total_account_balances",gpo.total_account_balances)("total_balances",total_balances) );
+      FC_ASSERT( gpo.total_account_vesting == total_vesting, "", ("gpo.total_account_vesting",gpo.total_account_vesting)("total_vesting",total_vesting) );
+      FC_ASSERT( gpo.total_escrow_balances == total_escrow, "", ("gpo.total_escrow_balances",gpo.total_escrow_balances)("total_escrow",total_escrow) );
    }
    FC_CAPTURE_LOG_AND_RETHROW( (head_block_num()) );
 }
@@ -48,14 +48,29 @@ void database_interface::notify_on_applied_transaction(const signed_transaction
    SOPHIATX_TRY_NOTIFY(on_applied_transaction, tx)
 }
 
+custom_content_payload database_interface::get_custom_content_payload( const custom_content_payload_object& payload )const
+{
+   FC_ASSERT( !payload.archived, "Custom content payload ${id} is archived", ("id", payload.id) );
+
+   custom_content_payload result;
+   result.all_recipients.assign( payload.all_recipients.begin(), payload.all_recipients.end() );
+   result.binary = payload.binary;
+   result.data.assign( payload.data.begin(), payload.data.end() );
+   result.json = to_string( payload.json );
+   return result;
+}
+
 void database_interface::wipe( const fc::path& shared_mem_dir, bool include_blocks)
 {
    close();
    chainbase::database::wipe( shared_mem_dir );
+   // archived payloads are part of the state
+   fc::remove_all( shared_mem_dir / "custom_content.archive" );
    if( include_blocks )
    {
       fc::remove_all( shared_mem_dir / "block_log" );
       fc::remove_all( shared_mem_dir / "block_log.index" );
+      fc::remove_all( shared_mem_dir / "block_log.trx" );
    }
 }
 
@@ -54,12 +54,9 @@ share_type economic_model_object::withdraw_mining_reward(uint32_t block_number,
    return reward_from_coinbase + reward_from_fees;
 }
 
-void economic_model_object::record_block(uint32_t generated_block, share_type current_supply){
-   uint32_t interest_blocks = SOPHIATX_INTEREST_BLOCKS;
-   if( generated_block >= interest_blocks )
-      accumulated_supply -= historic_supply[ generated_block % interest_blocks ];
-   historic_supply[ generated_block % interest_blocks ] = current_supply;
-   accumulated_supply+=current_supply;
+void economic_model_object::record_block(share_type current_supply, share_type replaced_supply){
+   accumulated_supply -= replaced_supply;
+   accumulated_supply += current_supply;
    //TODO_SOPHIATX - check invariants here.
    //check that current_supply + all_pools = total supply. Already in database.cpp
    //FC_ASSERT(mining_pool_from_coinbase + mining_pool_from_fees + interest_pool_from_coinbase + interest_pool_from_fees +
@@ -43,9 +43,21 @@ void hybrid_database::open(const open_args &args, const genesis_state_type &gene
 
 }
 
+optional<annotated_signed_transaction> hybrid_database::fetch_transaction_from_block_log(const transaction_id_type &trx_id) const {
+   try {
+      // there is no block log on this node, the transaction is looked up in the block log of the full node
+      optional<annotated_signed_transaction> result;
+      auto trx = remote::remote_db::remote_call("block_api", "get_transaction", fc::mutable_variant_object("id", trx_id));
+      result = trx.as<annotated_signed_transaction>();
+      return result;
+   }
+   FC_CAPTURE_AND_RETHROW((trx_id))
+}
+
 void hybrid_database::close(bool /*rewind*/) {
    try {
       _running = false;
+      _pushed_ops_cv.notify_all();
 
       with_write_lock([ & ]() {
            modify(get_hybrid_db_properties(), [ & ](hybrid_db_property_object &_hdpo) {
@@ -60,131 +72,121 @@ void hybrid_database::close(bool /*rewind*/) {
       boost::this_thread::sleep_for(boost::chrono::seconds(SOPHIATX_BLOCK_INTERVAL));
       if( _remote_api_thread.is_running())
          _remote_api_thread.quit();
+      remote::remote_db::unsubscribe_app_custom_messages();
 
    }
    FC_CAPTURE_AND_RETHROW()
 }
 
 
-bool hybrid_database::is_sync() const {
-   if( _head_op_id == _head_op_number && _head_op_number == 0 )
-      return false;
-
-   auto result = remote::remote_db::get_app_custom_messages({_app_id, std::numeric_limits<uint64_t>::max(), 1});
-
-   if( result.empty() || result.begin()->second.id != _head_op_id )
-      return false;
-
-   return true;
-}
-
-const remote::get_app_custom_messages_return::iterator &
-hybrid_database::get_unprocessed_op(const remote::get_app_custom_messages_return::iterator &start,
-                                    const remote::get_app_custom_messages_return::iterator &end, size_t size) const {
-
-   if( start->second.id > _head_op_id || start == end )
-      return start;
-
-   auto mid = start;
-
-   std::advance(mid, size / 2);
-   if( std::distance(mid, end) > static_cast<int64_t>(size / 2))
-      return start;
-
-   if( mid->second.id == _head_op_id ) {
-      return ++mid;
-   } else if( mid->second.id > _head_op_id ) {
-      return get_unprocessed_op(start, --mid, size / 2);
-   } else {
-      return get_unprocessed_op(++mid, end, size / 2);
-   }
-}
-
 void hybrid_database::start_sync_with_full_node() {
    _remote_api_thread.async([ & ]() {
+                                 bool subscribed = false;
                                  while( _running ) {
-                                    do {
-                                       if( is_sync())
-                                          break;
-
-                                       auto results = remote::remote_db::get_app_custom_messages(
-                                             {_app_id, _head_op_number + SOPHIATX_API_SINGLE_QUERY_LIMIT,
-                                              SOPHIATX_API_SINGLE_QUERY_LIMIT});
-
-                                       if( results.empty())
-                                          break;
-
-                                       auto itr = results.begin();
-
-                                       if( _head_op_id != 0 )
-                                          itr = get_unprocessed_op(results.begin(), results.end(), results.size());
-
-                                       if( itr == results.end())
-                                          break;
-
-                                       for( ; itr != results.end(); ++itr ) {
-                                          if( itr->second.id > _head_op_id || itr->second.id == 0 ) {
-                                             apply_custom_op(itr->second);
-                                             _head_op_number++;
-                                             _head_op_id = itr->second.id;
+                                    if( !subscribed ) {
+                                       try {
+                                          // the previous subscription is closed first, the messages it pushed
+                                          // meanwhile are pushed again by the new one
+                                          remote::remote_db::unsubscribe_app_custom_messages();
+                                          {
+                                             std::lock_guard<std::mutex> lock(_pushed_ops_mtx);
+                                             _pushed_ops.clear();
                                           }
+                                          remote::remote_db::reconnect();
+                                          // the full node pushes the messages following the last applied one, then each new one as it is applied
+                                          remote::remote_db::subscribe_app_custom_messages(_app_id, _head_op_number + 1,
+                                                [ this ](fc::variant v) { on_pushed_op(v); });
+                                          subscribed = true;
                                        }
-                                    } while( true );
-                                    boost::this_thread::sleep_for(boost::chrono::seconds(SOPHIATX_BLOCK_INTERVAL));
+                                       catch( const fc::exception &e ) {
+                                          wlog("Cannot subscribe to app messages of the full node: ${e}", ("e", e.to_string()));
+                                          boost::this_thread::sleep_for(boost::chrono::seconds(SOPHIATX_BLOCK_INTERVAL));
+                                          continue;
+                                       }
+                                    }
+
+                                    // everything pushed meanwhile is applied at once, a catch-up after downtime
+                                    // arrives in pages of the full node send queue
+                                    std::deque<remote::packed_received_object> ops;
+                                    {
+                                       std::unique_lock<std::mutex> lock(_pushed_ops_mtx);
+                                       _pushed_ops_cv.wait_for(lock, std::chrono::seconds(1), [ & ]() { return !_pushed_ops.empty() || !_running; });
+                                       if( _pushed_ops.empty()) {
+                                          // the subscription ends with the connection, it is resumed from the last applied message
+                                          if( !remote::remote_db::subscription_alive()) {
+                                             ilog("Subscription to app messages lost, connections: ${c}", ("c", remote::remote_db::get_connection_stats()));
+                                             subscribed = false;
+                                          }
+                                          continue;
+                                       }
+                                       ops.swap(_pushed_ops);
+                                    }
+
+                                    apply_custom_ops(ops);
                                  }
                             }
 
    );
 }
 
-void hybrid_database::apply_custom_op(const remote::received_object &obj) {
+void hybrid_database::on_pushed_op(const fc::variant &v) {
+   try {
+      auto op = remote::remote_db::unpack_app_custom_message(v);
+      {
+         std::lock_guard<std::mutex> lock(_pushed_ops_mtx);
+         _pushed_ops.push_back(std::move(op));
+      }
+      _pushed_ops_cv.notify_one();
+   }
+   FC_CAPTURE_AND_LOG((v))
+}
+
+void hybrid_database::apply_custom_ops(const std::deque<remote::packed_received_object> &ops) {
+   with_write_lock([ & ]() {
+        for( const auto &op: ops ) {
+           // a subscription pushes the stored messages in ascending order, the sequences of the app need not be
+           // contiguous, so only messages already applied are skipped
+           if( op.sequence <= _head_op_number )
+              continue;
+
+           apply_custom_op(op);
+           _head_op_number = op.sequence;
+           _head_op_id = op.id;
+        }
+   });
+}
+
+void hybrid_database::apply_custom_op(const remote::packed_received_object &obj) {
    auto eval = get_custom_json_evaluator(obj.app_id);
 
    if( !eval )
       return;
 
-   if( obj.binary ) {
-      custom_binary_operation op;
-      op.app_id = obj.app_id;
-      op.sender = obj.sender;
-      for( const auto &r: obj.recipients )
-         op.recipients.insert(r);
-      auto out = fc::base64_decode(obj.data);
-      std::copy(out.begin(), out.end(), std::back_inserter(op.data));
-
-      try {
-         with_write_lock([ & ]() {
-              eval->apply(op);
-         });
-      }
-      catch( const fc::exception &e ) {
-         edump((e));
-      }
-      catch( ... ) {
-         elog("Unexpected exception applying custom json evaluator.");
-      }
-
-   } else {
-
-      custom_json_operation op;
-      op.app_id = obj.app_id;
-      op.sender = obj.sender;
-      for( const auto &r: obj.recipients )
-         op.recipients.insert(r);
-      op.json = obj.data;
-
-      try {
-         with_write_lock([ & ]() {
-              eval->apply(op);
-         });
-      }
-      catch( const fc::exception &e ) {
-         edump((e));
-      }
-      catch( ... ) {
-         elog("Unexpected exception applying custom json evaluator.");
+   try {
+      if( obj.binary ) {
+         custom_binary_operation op;
+         op.app_id = obj.app_id;
+         op.sender = obj.sender;
+         for( const auto &r: obj.recipients )
+            op.recipients.insert(r);
+         op.data = obj.data;
+         eval->apply(op);
+      } else {
+         custom_json_operation op;
+         op.app_id = obj.app_id;
+         op.sender = obj.sender;
+         for( const auto &r: obj.recipients )
+            op.recipients.insert(r);
+         op.json = obj.json;
+         eval->apply(op);
       }
    }
+   catch( const fc::exception &e ) {
+      edump((e));
+   }
+   catch( ... ) {
+      elog("Unexpected exception applying custom json evaluator.");
+   }
 }
 
 const hybrid_db_property_object &hybrid_database::get_hybrid_db_properties() const {
@@ -5,6 +5,7 @@
 #include <sophiatx/protocol/sophiatx_operations.hpp>
 
 #include <sophiatx/chain/sophiatx_object_types.hpp>
+#include <sophiatx/chain/object_stream.hpp>
 #include <sophiatx/chain/witness_objects.hpp>
 #include <sophiatx/chain/shared_authority.hpp>
 
@@ -338,6 +339,7 @@ FC_REFLECT( sophiatx::chain::account_object,
              (proxied_vsf_votes)(witnesses_voted_for)
           )
 CHAINBASE_SET_INDEX_TYPE( sophiatx::chain::account_object, sophiatx::chain::account_index )
+CHAINBASE_SET_UNDO_DELTA_CODEC( sophiatx::chain::account_object, sophiatx::chain::raw_undo_delta_codec< sophiatx::chain::account_object > )
 
 FC_REFLECT( sophiatx::chain::account_authority_object,
              (id)(account)(owner)(active)(last_owner_update)
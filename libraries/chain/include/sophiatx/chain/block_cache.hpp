@@ -0,0 +1,90 @@
+#pragma once
+#include <sophiatx/protocol/block.hpp>
+
+#include <fc/io/raw.hpp>
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+
+#include <memory>
+#include <mutex>
+
+namespace sophiatx { namespace chain {
+
+   using sophiatx::protocol::signed_block;
+   using sophiatx::protocol::block_id_type;
+
+   struct block_cache_stats
+   {
+      uint64_t          hits = 0;
+      uint64_t          misses = 0;
+      uint32_t          size = 0;         ///< number of cached blocks
+      uint64_t          bytes = 0;        ///< packed size of the cached blocks
+      uint64_t          capacity = 0;     ///< limit of bytes
+   };
+
+   /**
+    *  Least recently used cache of decoded blocks, which are read from the block log by number or by id.
+    *  Only irreversible blocks are cached, as they never change once they are in the block log. The cache is
+    *  shared by all API threads and is safe to use concurrently.
+    */
+   class block_cache
+   {
+      public:
+         /** @param capacity maximum packed size of the cached blocks in bytes, 0 disables the cache */
+         explicit block_cache( uint64_t capacity = 0 ) : _capacity( capacity ) {}
+
+         optional< signed_block >   fetch_by_number( uint32_t block_num );
+         optional< signed_block >   fetch_by_id( const block_id_type& id );
+
+         void                       insert( const signed_block& b );
+         void                       clear();
+
+         void                       set_capacity( uint64_t capacity );
+         block_cache_stats          get_stats()const;
+
+      private:
+         struct cached_block
+         {
+            cached_block( const signed_block& b )
+               : block_num( b.block_num() ), id( b.id() ), size( fc::raw::pack_size( b ) ), block( b ) {}
+
+            uint32_t                block_num;
+            block_id_type           id;
+            uint64_t                size;
+            signed_block            block;
+         };
+
+         struct by_num;
+         struct by_block_id;
+
+         typedef boost::multi_index_container<
+            cached_block,
+            boost::multi_index::indexed_by<
+               boost::multi_index::sequenced<>,
+               boost::multi_index::hashed_unique< boost::multi_index::tag< by_num >,
+                  boost::multi_index::member< cached_block, uint32_t, &cached_block::block_num > >,
+               boost::multi_index::hashed_unique< boost::multi_index::tag< by_block_id >,
+                  boost::multi_index::member< cached_block, block_id_type, &cached_block::id >, std::hash< fc::ripemd160 > >
+            >
+         > cache_type;
+
+         template< typename Tag, typename Key >
+         optional< signed_block >   fetch( const Key& key );
+
+         /** Evicts the least recently used blocks until the cache fits its capacity */
+         void                       evict();
+
+         mutable std::mutex         _mtx;
+         cache_type                 _blocks;   ///< in the order of use, most recent first
+         uint64_t                   _capacity;
+         uint64_t                   _bytes = 0;
+         uint64_t                   _hits = 0;
+         uint64_t                   _misses = 0;
+   };
+
+} } // sophiatx::chain
+
+FC_REFLECT( sophiatx::chain::block_cache_stats, (hits)(misses)(size)(bytes)(capacity) )
@@ -1,5 +1,6 @@
 #pragma once
 #include <fc/filesystem.hpp>
+#include <fc/time.hpp>
 #include <sophiatx/protocol/block.hpp>
 
 namespace sophiatx { namespace chain {
@@ -31,22 +32,61 @@ namespace sophiatx { namespace chain {
     *
     * The main file is the only file that needs to persist. The index file can be reconstructed during a
     * linear scan of the main file.
+    *
+    * Version 2 of the main file starts with a 16 byte header (magic, version, flags) and every block is
+    * stored deflated, prefixed by its stored and its packed size. A block which does not shrink is stored
+    * packed, with both sizes equal. The positions in both files point at these records, so the layout
+    * above is kept. Logs without the header are version 1 and are read as before.
+    *
+    * When opened with a non zero append queue size, append() only queues the block and a background thread
+    * writes and syncs both files, so a slow disk does not stall the caller. Queued blocks are served to
+    * readers from memory until they are written. fence() waits until everything appended is durable.
+    *
+    * Reads go through read only memory mappings of both files and do not take the block log lock, so API
+    * threads can read blocks while new ones are appended. The mappings reserve room beyond the end of the
+    * files and are replaced once appended data outgrows them.
     */
 
+   struct block_log_append_metrics
+   {
+      uint32_t          queue_depth = 0;        ///< blocks appended but not written yet
+      uint32_t          max_queue_depth = 0;
+      uint32_t          durable_head = 0;       ///< number of the last block written and synced to disk
+      uint64_t          sync_count = 0;
+      fc::microseconds  last_sync_latency;
+      fc::microseconds  max_sync_latency;
+      fc::microseconds  total_sync_latency;
+   };
+
    class block_log {
       public:
          block_log();
          ~block_log();
 
-         void open( const fc::path& file );
+         /**
+          * @param append_queue_size number of blocks queued for the background writer, 0 writes synchronously
+          * @param compress create a new log as version 2, which readers of version 1 cannot parse, an existing log keeps its version
+          */
+         void open( const fc::path& file, size_t append_queue_size = 0, bool compress = false );
          void close();
          bool is_open()const;
 
          uint64_t append( const signed_block& b );
          void flush();
+
+         /** Waits until all appended blocks are written and synced, rethrows a failure of the background writer */
+         void fence();
+
+         /** @return number of the last block which is durable, i.e. written and synced (or flushed when synchronous) */
+         uint32_t durable_head_num()const;
+
+         block_log_append_metrics get_append_metrics()const;
          std::pair< signed_block, uint64_t > read_block( uint64_t file_pos )const;
          optional< signed_block > read_block_by_num( uint32_t block_num )const;
 
+         /** @return the block serialized with fc::raw, read (and inflated) without unpacking it */
+         optional< std::vector< char > > read_packed_block_by_num( uint32_t block_num )const;
+
          /**
           * Return offset of block in file, or block_log::npos if it does not exist.
           */
@@ -60,7 +100,16 @@ namespace sophiatx { namespace chain {
           */
          void set_locking( bool );
 
+         /** @return version of the opened log */
+         uint32_t version()const;
+
          static const uint64_t npos = std::numeric_limits<uint64_t>::max();
+         static const uint32_t legacy_version = 1;
+         static const uint32_t compressed_version = 2;
+
+         /// the background writer syncs after this many blocks or milliseconds even while blocks are queued
+         static const uint32_t max_unsynced_blocks = 100;
+         static const uint32_t max_sync_interval_ms = 500;
 
       private:
          void construct_index();
@@ -72,3 +121,6 @@ namespace sophiatx { namespace chain {
    };
 
 } }
+
+FC_REFLECT( sophiatx::chain::block_log_append_metrics,
+            (queue_depth)(max_queue_depth)(durable_head)(sync_count)(last_sync_latency)(max_sync_latency)(total_sync_latency) )
@@ -0,0 +1,113 @@
+#pragma once
+#include <sophiatx/chain/block_log.hpp>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <mutex>
+
+namespace sophiatx { namespace chain {
+
+   struct block_log_transaction_location
+   {
+      uint32_t block_num = 0;
+      uint32_t trx_in_block = 0;
+      uint32_t offset = 0;          ///< offset of the packed transaction in the packed block
+      uint32_t size = 0;            ///< size of the packed transaction
+   };
+
+   struct block_log_transaction
+   {
+      block_log_transaction_location location;
+      std::vector< char >            packed_trx;
+   };
+
+   /**
+    * Optional sidecar of the block log mapping transaction ids to their position in the log, so transactions can be
+    * looked up without the account history plugin and without unpacking their blocks.
+    *
+    * The file starts with a 16 byte header (magic, version, number of the last indexed block) followed by fixed size
+    * records, one per transaction in block order:
+    *
+    * +----------------+-----------+--------------+--------+------+
+    * | Transaction id | Block num | Trx in block | Offset | Size |
+    * +----------------+-----------+--------------+--------+------+
+    *
+    * Records are only appended and read through a memory mapping. Transactions are found through an open addressing
+    * hash table in a second file (the name of the index with a .hash suffix), mapped as well. It starts with a 32 byte
+    * header (magic, version, clean flag, number of buckets, number of entries) followed by the buckets, each holding
+    * the record number + 1 of a transaction or 0 when it is empty. A transaction id is looked up from the bucket given
+    * by its first 8 bytes, probing the following buckets until an empty one. The table doubles once it is half full.
+    *
+    * The clean flag is cleared while the index is open, the table is rebuilt from the records when it was not closed
+    * cleanly or does not match them. Both files can be deleted at any time, they are rebuilt from the block log on the
+    * next open, and an index lagging behind the log is caught up.
+    */
+   class block_log_transaction_index
+   {
+      public:
+         ~block_log_transaction_index();
+
+         /** Opens or creates the index and indexes the blocks of log it misses */
+         void open( const fc::path& file, const block_log& log );
+         void close();
+         bool is_open()const;
+
+         /** Indexes the transactions of the block, which has to follow the last indexed block */
+         void append( const signed_block& b );
+
+         optional< block_log_transaction_location > find( const transaction_id_type& id )const;
+
+         /**
+          * @return the packed transaction read from the block log, if the transaction is indexed. The index stays
+          * locked while the block is read, so a close on the write thread waits for the lookup.
+          */
+         optional< block_log_transaction > read_transaction( const transaction_id_type& id )const;
+
+         uint32_t head_block_num()const;
+
+      private:
+         static const uint64_t header_size = 16;
+         static const uint64_t record_size = sizeof( transaction_id_type ) + 4 * sizeof( uint32_t );
+         static const uint64_t hash_header_size = 32;
+         static const uint64_t min_buckets = 1 << 16;
+
+         /** Looks the transaction up in the hash table, the caller holds _mtx */
+         optional< block_log_transaction_location > find_locked( const transaction_id_type& id )const;
+         void index_block( const signed_block& b );
+         void write_head( uint32_t block_num );
+         void remap( uint64_t size );
+         const char* record_data( uint64_t record )const;
+
+         /** Opens the hash table, rebuilding it unless it holds exactly the given number of records */
+         void open_hash( uint64_t records );
+         void close_hash();
+         /** Recreates the hash table with given number of buckets and inserts the first records */
+         void rebuild_hash( uint64_t buckets, uint64_t records );
+         void insert_hash( uint64_t record );
+         uint64_t* buckets()const;
+
+         static uint64_t id_key( const transaction_id_type& id );
+
+         const block_log*                                        _log = nullptr;
+         fc::path                                                _file;
+         int                                                     _fd = -1;
+         uint64_t                                                _size = 0;        ///< bytes of the file
+         uint32_t                                                _head = 0;        ///< last indexed block
+
+         std::unique_ptr< boost::interprocess::file_mapping >    _mapping;
+         std::unique_ptr< boost::interprocess::mapped_region >   _region;
+
+         fc::path                                                _hash_file;
+         int                                                     _hash_fd = -1;
+         uint64_t                                                _buckets = 0;
+         uint64_t                                                _entries = 0;
+         std::unique_ptr< boost::interprocess::file_mapping >    _hash_mapping;
+         std::unique_ptr< boost::interprocess::mapped_region >   _hash_region;
+
+         mutable std::mutex                                      _mtx;
+   };
+
+} } // sophiatx::chain
+
+FC_REFLECT( sophiatx::chain::block_log_transaction_location, (block_num)(trx_in_block)(offset)(size) )
@@ -0,0 +1,77 @@
+#pragma once
+#include <sophiatx/chain/sophiatx_object_types.hpp>
+
+namespace sophiatx { namespace chain {
+
+   /**
+    *  @brief size and content of one of the last SOPHIATX_BLOCK_STATS_WINDOW blocks
+    *  @ingroup object
+    *
+    *  The objects form a ring created in genesis, block N is recorded in the object with id
+    *  N % SOPHIATX_BLOCK_STATS_WINDOW, so applying a block modifies a single small object.
+    */
+   class block_stats_object : public object< block_stats_object_type, block_stats_object >
+   {
+      public:
+         template< typename Constructor, typename Allocator >
+         block_stats_object( Constructor&& c, allocator< Allocator > a )
+         {
+            c( *this );
+         }
+
+         block_stats_object(){};
+
+         id_type        id;
+         uint32_t       block_num = 0;
+         uint32_t       block_size = 0;
+         uint32_t       transactions = 0;
+         uint32_t       operations = 0;
+   };
+
+   /**
+    *  @brief totals of the block stats ring, so the averages over the whole window are available in constant time
+    *  @ingroup object
+    */
+   class block_stats_window_object : public object< block_stats_window_object_type, block_stats_window_object >
+   {
+      public:
+         template< typename Constructor, typename Allocator >
+         block_stats_window_object( Constructor&& c, allocator< Allocator > a )
+         {
+            c( *this );
+         }
+
+         block_stats_window_object(){};
+
+         id_type        id;
+         uint32_t       blocks = 0;               ///< number of recorded blocks, up to SOPHIATX_BLOCK_STATS_WINDOW
+         uint64_t       total_size = 0;
+         uint64_t       total_transactions = 0;
+         uint64_t       total_operations = 0;
+   };
+
+   typedef multi_index_container<
+      block_stats_object,
+      indexed_by<
+         ordered_unique< tag< by_id >,
+            member< block_stats_object, block_stats_object::id_type, &block_stats_object::id > >
+      >,
+      allocator< block_stats_object >
+   > block_stats_index;
+
+   typedef multi_index_container<
+      block_stats_window_object,
+      indexed_by<
+         ordered_unique< tag< by_id >,
+            member< block_stats_window_object, block_stats_window_object::id_type, &block_stats_window_object::id > >
+      >,
+      allocator< block_stats_window_object >
+   > block_stats_window_index;
+
+} } // sophiatx::chain
+
+FC_REFLECT( sophiatx::chain::block_stats_object, (id)(block_num)(block_size)(transactions)(operations) )
+CHAINBASE_SET_INDEX_TYPE( sophiatx::chain::block_stats_object, sophiatx::chain::block_stats_index )
+
+FC_REFLECT( sophiatx::chain::block_stats_window_object, (id)(blocks)(total_size)(total_transactions)(total_operations) )
+CHAINBASE_SET_INDEX_TYPE( sophiatx::chain::block_stats_window_object, sophiatx::chain::block_stats_window_index )
@@ -0,0 +1,92 @@
+#pragma once
+#include <fc/filesystem.hpp>
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace sophiatx { namespace chain {
+
+   /** A payload handed to the background writer of the archive */
+   struct custom_content_archive_item
+   {
+      uint64_t                id = 0;      ///< id of the custom_content_payload_object
+      std::vector< char >     packed;      ///< the packed payload, released once it is written
+      uint64_t                pos = 0;     ///< position of the written payload
+      uint32_t                size = 0;    ///< size of the written payload
+   };
+
+   /**
+    * Append-only file holding the payloads of custom content moved out of the shared memory file.
+    *
+    * The file starts with a 16 byte header (magic, version, reserved) followed by the packed payloads. Payloads are
+    * written with a single pwrite each and are located by the position and size kept in their
+    * custom_content_payload_object, so the file itself needs no index. Reads and appends are safe to use concurrently.
+    *
+    * Payloads archived while applying blocks are written and synced by a background thread, one batch at a time, so
+    * the thread applying blocks does not wait for the disk. The database keeps the positions of written payloads
+    * until marking them archived is irreversible and reuses them when the marking block is popped. Payloads written
+    * but not referenced by the state when the node stops stay in the file unreferenced, the file never shrinks.
+    */
+   class custom_content_archive
+   {
+      public:
+         ~custom_content_archive();
+
+         /** Opens or creates the archive */
+         void open( const fc::path& file );
+         void close();
+         bool is_open()const { return _fd >= 0; }
+
+         const fc::path& path()const { return _file; }
+
+         /** @return position of the appended payload */
+         uint64_t append( const std::vector< char >& packed_payload );
+
+         std::vector< char > read( uint64_t pos, uint32_t size )const;
+
+         /** Waits until the appended payloads are on disk, reads are not blocked meanwhile */
+         void sync();
+
+         /**
+          * Hands a batch of payloads to the background writer, which appends and syncs them. Only one batch is
+          * written at a time, the previous one has to be taken by take_written() first.
+          */
+         void write_async( std::vector< custom_content_archive_item >&& batch );
+
+         /** @return true while a batch handed to the background writer is not taken by take_written() */
+         bool is_writing()const;
+
+         /** @return the batch handed to the background writer with the positions of its payloads once they are on disk */
+         std::vector< custom_content_archive_item > take_written();
+
+         /** Waits until the batch handed to the background writer is on disk */
+         void fence()const;
+
+         /** @return bytes of the file */
+         uint64_t size()const;
+
+      private:
+         static const uint64_t header_size = 16;
+
+         void run();
+
+         fc::path                                                _file;
+         int                                                     _fd = -1;
+         uint64_t                                                _size = 0;
+
+         mutable std::mutex                                      _mtx;
+
+         std::thread                                             _writer;
+         std::vector< custom_content_archive_item >              _queued;      ///< batch waiting for the writer
+         std::vector< custom_content_archive_item >              _written;     ///< batch on disk, not taken yet
+         bool                                                    _writing = false;
+         bool                                                    _stopping = false;
+         std::string                                             _error;
+         mutable std::mutex                                      _writer_mtx;
+         mutable std::condition_variable                         _writer_cv;
+   };
+
+} } // sophiatx::chain
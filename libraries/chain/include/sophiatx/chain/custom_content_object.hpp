@@ -6,20 +6,86 @@
 
 #include <sophiatx/chain/buffer_type.hpp>
 #include <sophiatx/chain/sophiatx_object_types.hpp>
+#include <sophiatx/chain/object_stream.hpp>
 #include <sophiatx/chain/witness_objects.hpp>
 #include <fc/time.hpp>
 
+#include <boost/functional/hash.hpp>
 #include <boost/multi_index/composite_key.hpp>
+#include <boost/multi_index/hashed_index.hpp>
 #include <sophiatx/protocol/config.hpp>
 
 
 
 namespace sophiatx { namespace chain {
 
+/**
+ * Content of a custom_json or custom_binary operation. It is stored once per operation and referenced by the
+ * custom_content_object of every recipient.
+ *
+ * Old payloads may be moved to the custom_content_archive file, then the content is cleared and only its position
+ * in the archive is kept in memory.
+ */
+class custom_content_payload_object: public object< custom_content_payload_object_type, custom_content_payload_object> {
+public:
+   template<typename Constructor, typename Allocator>
+   custom_content_payload_object(Constructor &&c, allocator<Allocator> a):all_recipients( a.get_segment_manager() ), data(a), json(a) {
+      c(*this);
+   }
+
+   id_type id;
+
+   shared_vector<account_name_type> all_recipients;
+
+   bool binary;
+   shared_vector<char> data;
+   shared_string json;
+
+   uint32_t block_num = 0;         ///< block of the operation
+   uint32_t size = 0;              ///< bytes of the content held in memory until it is archived
+   bool archived = false;
+   uint64_t archive_pos = 0;
+   uint32_t archive_size = 0;
+};
+
+/**
+ * Content of a custom_json or custom_binary operation as it is read from memory or from the archive.
+ */
+struct custom_content_payload
+{
+   vector<account_name_type> all_recipients;
+   bool binary = false;
+   vector<char> data;
+   string json;
+};
+
+/**
+ * Size of the custom content payloads held in memory and in the archive, the archiving policy keeps the memory
+ * size within its budget.
+ */
+class custom_content_storage_object: public object< custom_content_storage_object_type, custom_content_storage_object> {
+public:
+   template<typename Constructor, typename Allocator>
+   custom_content_storage_object(Constructor &&c, allocator<Allocator> a) {
+      c(*this);
+   }
+
+   custom_content_storage_object(){};
+
+   id_type id;
+
+   uint64_t memory_size = 0;
+   uint64_t archived_size = 0;
+   uint64_t archived_payloads = 0;
+};
+
+/**
+ * Received document of a single recipient, the content itself is in the referenced custom_content_payload_object.
+ */
 class custom_content_object: public object< custom_content_object_type, custom_content_object> {
 public:
    template<typename Constructor, typename Allocator>
-   custom_content_object(Constructor &&c, allocator<Allocator> a):all_recipients( a.get_segment_manager() ), data(a), json(a) {
+   custom_content_object(Constructor &&c, allocator<Allocator> a) {
       c(*this);
    }
 
@@ -29,19 +95,54 @@ public:
    account_name_type sender;
    account_name_type recipient;
 
-   shared_vector<account_name_type> all_recipients;
+   custom_content_payload_id_type payload;
 
    uint64_t sender_sequence = 0;
    uint64_t recipient_sequence = 0;
    uint64_t app_message_sequence = 0;
    time_point_sec received;
+};
 
-   bool binary;
-   shared_vector<char> data;
-   shared_string json;
+/**
+ * Last sequence number assigned to the documents of an app, of a sender in an app or of a recipient in an app.
+ * The counters are kept apart from the documents, so the next number is found by a single hashed lookup and does
+ * not depend on the documents still being stored.
+ */
+class custom_content_sequence_object: public object< custom_content_sequence_object_type, custom_content_sequence_object> {
+public:
+   enum sequence_type
+   {
+      app_sequence,
+      sender_sequence,
+      recipient_sequence
+   };
+
+   template<typename Constructor, typename Allocator>
+   custom_content_sequence_object(Constructor &&c, allocator<Allocator> a) {
+      c(*this);
+   }
+
+   id_type id;
+
+   uint8_t type = app_sequence;
+   account_name_type account;        ///< empty for app_sequence
+   uint64_t app_id = 0;
+   uint64_t sequence = 0;
+};
+
+struct custom_content_account_hash
+{
+   size_t operator()( const account_name_type& a )const
+   {
+      size_t seed = std::hash< fc::uint128 >()( a.data.first );
+      boost::hash_combine( seed, a.data.second );
+      return seed;
+   }
 };
 
 struct by_id;
+struct by_archived;
+struct by_sequence_key;
 struct by_app_id;
 struct by_sender;
 struct by_recipient;
@@ -96,11 +197,72 @@ typedef multi_index_container<
       allocator< custom_content_object >
 > custom_content_index;
 
+typedef multi_index_container<
+      custom_content_payload_object,
+      indexed_by<
+            ordered_unique< tag< by_id >,
+                    member< custom_content_payload_object, custom_content_payload_object::id_type, &custom_content_payload_object::id > >,
+            ordered_unique< tag< by_archived >,
+               composite_key< custom_content_payload_object,
+                     member< custom_content_payload_object, bool, &custom_content_payload_object::archived>,
+                     member< custom_content_payload_object, custom_content_payload_object::id_type, &custom_content_payload_object::id >
+               >
+            >
+      >,
+      allocator< custom_content_payload_object >
+> custom_content_payload_index;
+
+typedef multi_index_container<
+      custom_content_storage_object,
+      indexed_by<
+            ordered_unique< tag< by_id >,
+                    member< custom_content_storage_object, custom_content_storage_object::id_type, &custom_content_storage_object::id > >
+      >,
+      allocator< custom_content_storage_object >
+> custom_content_storage_index;
+
+typedef multi_index_container<
+      custom_content_sequence_object,
+      indexed_by<
+            ordered_unique< tag< by_id >,
+                    member< custom_content_sequence_object, custom_content_sequence_object::id_type, &custom_content_sequence_object::id > >,
+            hashed_unique< tag< by_sequence_key >,
+               composite_key< custom_content_sequence_object,
+                     member< custom_content_sequence_object, uint8_t, &custom_content_sequence_object::type>,
+                     member< custom_content_sequence_object, account_name_type, &custom_content_sequence_object::account>,
+                     member< custom_content_sequence_object, uint64_t, &custom_content_sequence_object::app_id>
+               >,
+               composite_key_hash< std::hash< uint8_t >, custom_content_account_hash, std::hash< uint64_t > >
+            >
+      >,
+      allocator< custom_content_sequence_object >
+> custom_content_sequence_index;
+
 
 }} //namespace
 
 
 FC_REFLECT(sophiatx::chain::custom_content_object,
-           (id)(app_id)(sender)(recipient)(binary)(data)(json)(received)(sender_sequence)(recipient_sequence)(app_message_sequence)
+           (id)(app_id)(sender)(recipient)(payload)(received)(sender_sequence)(recipient_sequence)(app_message_sequence)
 )
 CHAINBASE_SET_INDEX_TYPE( sophiatx::chain::custom_content_object, sophiatx::chain::custom_content_index )
+
+FC_REFLECT(sophiatx::chain::custom_content_payload_object,
+           (id)(all_recipients)(binary)(data)(json)(block_num)(size)(archived)(archive_pos)(archive_size)
+)
+CHAINBASE_SET_INDEX_TYPE( sophiatx::chain::custom_content_payload_object, sophiatx::chain::custom_content_payload_index )
+CHAINBASE_SET_UNDO_DELTA_CODEC( sophiatx::chain::custom_content_payload_object, sophiatx::chain::raw_undo_delta_codec< sophiatx::chain::custom_content_payload_object > )
+
+FC_REFLECT(sophiatx::chain::custom_content_payload,
+           (all_recipients)(binary)(data)(json)
+)
+
+FC_REFLECT(sophiatx::chain::custom_content_storage_object,
+           (id)(memory_size)(archived_size)(archived_payloads)
+)
+CHAINBASE_SET_INDEX_TYPE( sophiatx::chain::custom_content_storage_object, sophiatx::chain::custom_content_storage_index )
+
+FC_REFLECT(sophiatx::chain::custom_content_sequence_object,
+           (id)(type)(account)(app_id)(sequence)
+)
+CHAINBASE_SET_INDEX_TYPE( sophiatx::chain::custom_content_sequence_object, sophiatx::chain::custom_content_sequence_index )
@@ -4,6 +4,7 @@
 #pragma once
 #include <sophiatx/chain/database/database_interface.hpp>
 #include <sophiatx/chain/evaluator_registry.hpp>
+#include <sophiatx/chain/transaction_envelope.hpp>
 
 namespace sophiatx {
 namespace chain {
@@ -50,6 +51,26 @@ public:
    uint32_t reindex(const open_args &args, const genesis_state_type &genesis,
                     const public_key_type &init_pubkey /*TODO: delete when initminer pubkey is read from get_config */  );
 
+   /**
+    * @brief Write a snapshot of the object graph into a directory, see state_snapshot.hpp
+    *
+    * The object graph must match the head of the block log, so this method is to be called right after
+    * @ref database::open or @ref database::reindex, before any block or transaction is pushed.
+    */
+   void export_state(const fc::path &dir);
+
+   /**
+    * @brief Restore object graph from a state snapshot and open database
+    *
+    * This method may be called instead of @ref database::open or @ref database::reindex. The block log has to
+    * contain the head block of the snapshot, blocks following it are replayed. When this method exits
+    * successfully, the database will be open.
+    *
+    * @return the head block number.
+    */
+   uint32_t import_state(const open_args &args, const fc::path &dir, const genesis_state_type &genesis,
+                         const public_key_type &init_pubkey /*TODO: delete when initminer pubkey is read from get_config */  );
+
    void close(bool rewind = true);
 
    //////////////////// db_block.cpp ////////////////////
@@ -72,8 +93,21 @@ public:
 
    const signed_transaction get_recent_transaction(const transaction_id_type &trx_id) const;
 
+   optional<annotated_signed_transaction> fetch_transaction_from_block_log(const transaction_id_type &trx_id) const;
+
    std::vector<block_id_type> get_block_ids_on_fork(block_id_type head_of_fork) const;
 
+   custom_content_payload get_custom_content_payload(const custom_content_payload_object &payload) const;
+
+   /** Queue depth and sync latency of the block log writer */
+   block_log_append_metrics get_block_log_append_metrics() const { return _block_log.get_append_metrics(); }
+
+   /** Hits and misses of the cache of blocks read from the block log */
+   block_cache_stats get_block_cache_stats() const { return _block_cache.get_stats(); }
+
+   /** Waits until the custom content payloads handed to the archive writer are on disk, a later block archives them */
+   void fence_custom_content_archive() const { _custom_content_archive.fence(); }
+
    const witness_object &get_witness(const account_name_type &name) const;
 
    const witness_object *find_witness(const account_name_type &name) const;
@@ -122,14 +156,27 @@ public:
 
    bool push_block(const signed_block &b, uint32_t skip = skip_nothing);
 
+   /**
+    * Same as push_block() above, but reuses transaction envelopes prepared ahead of time (usually in parallel by
+    * the caller) instead of packing, hashing and recovering signing keys of the transactions on the write thread.
+    * Envelopes are indexed like signed_block::transactions, they are ignored if their count does not match.
+    */
+   bool push_block(const signed_block &b, uint32_t skip, const transaction_envelopes &envelopes);
+
    void push_transaction(const signed_transaction &trx, uint32_t skip = skip_nothing);
 
+   void push_transaction(const transaction_envelope_ptr &trx, uint32_t skip = skip_nothing);
+
    void _maybe_warn_multiple_production(uint32_t height) const;
 
    bool _push_block(const signed_block &b);
 
+   bool _push_block(const signed_block &b, const transaction_envelopes &envelopes);
+
    void _push_transaction(const signed_transaction &trx);
 
+   void _push_transaction(const transaction_envelope_ptr &trx);
+
    signed_block generate_block(
          const fc::time_point_sec when,
          const account_name_type &witness_owner,
@@ -137,10 +184,17 @@ public:
          uint32_t skip
    );
 
+   /**
+    * Pending transactions still valid in the pending state are included without being applied again, unless
+    * reapply_pending is set, leaving some transactions out might affect the others or the pending state was not
+    * evaluated the way the block will be. A rejected block taken from the pending state is generated again with
+    * reapply_pending set.
+    */
    signed_block _generate_block(
          const fc::time_point_sec when,
          const account_name_type &witness_owner,
-         const fc::ecc::private_key &block_signing_private_key
+         const fc::ecc::private_key &block_signing_private_key,
+         bool reapply_pending = false
    );
 
    void pop_block();
@@ -215,6 +269,12 @@ public:
 
    void adjust_supply(const asset &delta);
 
+   /** Updates the running total of account balances (SPHTX) or vesting shares (VESTS) checked by validate_invariants() */
+   void adjust_account_holdings_total(const asset &delta);
+
+   /** Updates the running total of funds held in escrows checked by validate_invariants() */
+   void adjust_escrow_holdings_total(const asset &delta);
+
    void update_owner_authority(const account_object &account, const authority &owner_authority);
 
    asset get_balance(const account_object &a, asset_symbol_type symbol) const;
@@ -280,8 +340,15 @@ public:
 
    void check_free_memory(bool force_print, uint32_t current_block_num);
 
+   /**
+    * Checks the supply invariants against the running totals of the dynamic global properties, which takes
+    * constant time. Every invariants audit interval blocks it also runs audit_invariants().
+    */
    void validate_invariants() const;
 
+   /** Recomputes the running totals by scanning all accounts, witnesses and escrows and checks them against the stored ones */
+   void audit_invariants() const;
+
    asset process_operation_fee(const operation &op);
 
    account_name_type get_fee_payer(const operation &op);
@@ -296,13 +363,26 @@ protected:
 private:
    optional<chainbase::database::session> _pending_tx_session;
 
-   void apply_block(const signed_block &next_block, uint32_t skip = skip_nothing);
+   /// Opens the block log and checks it against the opened object graph, the common part of open() and import_state()
+   void _open_block_log(const open_args &args);
+
+   /// Opens the custom content archive when the archiving policy is enabled or the state references archived payloads
+   void _open_custom_content_archive(const open_args &args);
+
+   /// Creates the custom content sequence counters from the stored documents of a state which predates the counters
+   void _seed_custom_content_sequences();
 
-   void apply_transaction(const signed_transaction &trx, uint32_t skip = skip_nothing);
+   /** Reads an irreversible block through the block cache */
+   optional<signed_block> _read_block_from_log(uint32_t block_num) const;
 
-   void _apply_block(const signed_block &next_block);
+   void apply_block(const signed_block &next_block, uint32_t skip = skip_nothing,
+                    const transaction_envelopes &envelopes = transaction_envelopes());
 
-   void _apply_transaction(const signed_transaction &trx);
+   void apply_transaction(const transaction_envelope &trx, uint32_t skip = skip_nothing);
+
+   void _apply_block(const signed_block &next_block, const transaction_envelopes &envelopes);
+
+   void _apply_transaction(const transaction_envelope &trx);
 
    void apply_operation(const operation &op);
 
@@ -313,6 +393,11 @@ private:
 
    void create_block_summary(const signed_block &next_block);
 
+   void update_block_stats(const signed_block &next_block, const transaction_envelopes &envelopes, uint32_t block_size);
+
+   /// Moves irreversible custom content payloads beyond the archive age or the memory budget to the archive
+   void archive_custom_content();
+
    void clear_null_account_balance();
 
    void update_global_dynamic_data(const signed_block &b);
@@ -344,6 +429,21 @@ private:
    protocol::hardfork_version _hardfork_versions[SOPHIATX_NUM_HARDFORKS + 1];
 
    block_log _block_log;
+   mutable block_cache _block_cache;
+   block_log_transaction_index _block_log_trx_index;
+
+   custom_content_archive _custom_content_archive;
+   uint32_t _custom_content_archive_age = 0;
+   uint64_t _custom_content_memory_budget = 0;
+
+   /// Copy of a payload handed to the archive writer, kept until marking the payload archived is irreversible
+   struct custom_content_archive_copy
+   {
+      uint64_t pos = 0;
+      uint32_t size = 0;        ///< 0 while the payload is being written
+      uint32_t block_num = 0;   ///< the block which marked the payload archived, 0 if none did yet
+   };
+   std::map<custom_content_payload_id_type, custom_content_archive_copy> _custom_content_archive_copies;
 
    flat_map<uint32_t, block_id_type> _checkpoints;
 };
@@ -6,10 +6,16 @@
 #include <sophiatx/chain/node_property_object.hpp>
 #include <sophiatx/chain/fork_database.hpp>
 #include <sophiatx/chain/block_log.hpp>
+#include <sophiatx/chain/block_cache.hpp>
+#include <sophiatx/chain/block_log_transaction_index.hpp>
+#include <sophiatx/chain/custom_content_archive.hpp>
 #include <sophiatx/chain/operation_notification.hpp>
 #include <sophiatx/chain/util/signal.hpp>
 #include <sophiatx/chain/economics.hpp>
+#include <sophiatx/chain/transaction_envelope.hpp>
+#include <sophiatx/chain/pending_transaction_pool.hpp>
 #include <sophiatx/chain/sophiatx_objects.hpp>
+#include <sophiatx/chain/custom_content_object.hpp>
 
 #include <sophiatx/chain/util/asset.hpp>
 
@@ -27,6 +33,7 @@ namespace sophiatx {
 namespace chain {
 
 using sophiatx::protocol::signed_transaction;
+using sophiatx::protocol::annotated_signed_transaction;
 using sophiatx::protocol::operation;
 using sophiatx::protocol::authority;
 using sophiatx::protocol::asset;
@@ -81,9 +88,16 @@ public:
       uint32_t chainbase_flags = 0;
       bool do_validate_invariants = false;
       uint64_t app_id = 0;
+      uint32_t block_log_queue_size = 0; ///< blocks queued for the background block log writer, 0 writes synchronously
+      bool block_log_compression = false; ///< create a new block log compressed (version 2), an existing log keeps its format
+      uint64_t block_cache_size = 0; ///< packed size in bytes of the irreversible blocks cached for readers, 0 disables the cache
+      bool block_log_transaction_index = false; ///< maintain the transaction id index next to the block log
+      uint32_t custom_content_archive_age = 0; ///< archive custom content payloads older than this number of blocks, 0 disables
+      uint64_t custom_content_memory_budget = 0; ///< archive the oldest custom content payloads above this many bytes, 0 disables
 
       // The following fields are only used on reindexing
       uint32_t stop_replay_at = 0;
+      uint32_t replay_queue_size = 1024; ///< number of blocks the replay reader thread may read ahead
       TBenchmark benchmark = TBenchmark(0, [](uint32_t, const abstract_index_cntr_t &) {});
    };
 
@@ -137,8 +151,14 @@ public:
 
    virtual const signed_transaction get_recent_transaction(const transaction_id_type &trx_id) const = 0;
 
+   /** @return the irreversible transaction found through the block log transaction index, if the index is enabled */
+   virtual optional<annotated_signed_transaction> fetch_transaction_from_block_log(const transaction_id_type &trx_id) const = 0;
+
    virtual std::vector<block_id_type> get_block_ids_on_fork(block_id_type head_of_fork) const = 0;
 
+   /** @return the content of the payload, read from the custom content archive if it was archived */
+   virtual custom_content_payload get_custom_content_payload(const custom_content_payload_object &payload) const;
+
    virtual const dynamic_global_property_object &get_dynamic_global_properties() const = 0;
 
    virtual const hardfork_property_object &get_hardfork_property_object() const = 0;
@@ -266,8 +286,8 @@ public:
 
    /** when popping a block, the transactions that were removed get cached here so they
     * can be reapplied at the proper time */
-   std::deque<signed_transaction> _popped_tx;
-   vector<signed_transaction> _pending_tx;
+   std::deque<transaction_envelope_ptr> _popped_tx;
+   pending_transaction_pool _pending_tx;
 
    virtual void validate_invariants() const = 0;
 
@@ -280,6 +300,11 @@ public:
       _next_flush_block = 0;
    }
 
+   /** Every N blocks validate_invariants() also runs the full scan audit, 0 disables it */
+   void set_invariants_audit_interval(uint32_t audit_blocks) {
+      _invariants_audit_blocks = audit_blocks;
+   }
+
 #ifdef IS_TEST_NET
    bool disable_low_mem_warning = true;
 #endif
@@ -317,6 +342,8 @@ protected:
    uint32_t _flush_blocks = 0;
    uint32_t _next_flush_block = 0;
 
+   uint32_t _invariants_audit_blocks = 0;
+
    uint32_t _last_free_gb_printed = 0;
 
    uint16_t _shared_file_full_threshold = 0;
@@ -45,7 +45,7 @@ struct skip_flags_restorer
  */
 struct pending_transactions_restorer
 {
-   pending_transactions_restorer( database& db, std::vector<signed_transaction>&& pending_transactions )
+   pending_transactions_restorer( database& db, pending_transaction_pool&& pending_transactions )
       : _db(db), _pending_transactions( std::move(pending_transactions) )
    {
       _db.clear_pending();
@@ -56,7 +56,7 @@ struct pending_transactions_restorer
       for( const auto& tx : _db._popped_tx )
       {
          try {
-            if( !_db.is_known_transaction( tx.id() ) ) {
+            if( !_db.is_known_transaction( tx->id() ) ) {
                // since push_transaction() takes a signed_transaction,
                // the operation_results field will be ignored.
                _db._push_transaction( tx );
@@ -65,11 +65,17 @@ struct pending_transactions_restorer
          }
       }
       _db._popped_tx.clear();
-      for( const signed_transaction& tx : _pending_transactions )
+
+      // expired transactions cannot be applied any more, drop them without trying
+      if( _db.head_block_num() > 0 )
+         _pending_transactions.remove_expired( _db.head_block_time() );
+
+      for( const auto& pending : _pending_transactions.indices().get< pending_transaction_pool::by_sequence >() )
       {
+         const transaction_envelope_ptr& tx = pending.trx;
          try
          {
-            if( !_db.is_known_transaction( tx.id() ) ) {
+            if( !_db.is_known_transaction( tx->id() ) ) {
                // since push_transaction() takes a signed_transaction,
                // the operation_results field will be ignored.
                _db._push_transaction( tx );
@@ -80,7 +86,7 @@ struct pending_transactions_restorer
             dlog( "Pending transaction became invalid after switching to block ${b} ${n} ${t}",
                ("b", _db.head_block_id())("n", _db.head_block_num())("t", _db.head_block_time()) );
             dlog( "The invalid transaction caused exception ${e}", ("e", e.to_detail_string()) );
-            dlog( "${t}", ("t", tx) );
+            dlog( "${t}", ("t", tx->get_transaction()) );
          }
          catch( const fc::exception& e )
          {
@@ -89,14 +95,14 @@ struct pending_transactions_restorer
             dlog( "Pending transaction became invalid after switching to block ${b} ${n} ${t}",
                ("b", _db.head_block_id())("n", _db.head_block_num())("t", _db.head_block_time()) );
             dlog( "The invalid pending transaction caused exception ${e}", ("e", e.to_detail_string() ) );
-            dlog( "${t}", ("t", tx) );
+            dlog( "${t}", ("t", tx->get_transaction()) );
             */
          }
       }
    }
 
    database& _db;
-   std::vector< signed_transaction > _pending_transactions;
+   pending_transaction_pool _pending_transactions;
 };
 
 /**
@@ -126,7 +132,7 @@ void with_skip_flags(
 template< typename Lambda >
 void without_pending_transactions(
    database& db,
-   std::vector<signed_transaction>&& pending_transactions,
+   pending_transaction_pool&& pending_transactions,
    Lambda callback )
 {
     pending_transactions_restorer restorer( db, std::move(pending_transactions) );
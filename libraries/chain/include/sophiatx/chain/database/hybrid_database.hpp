@@ -5,6 +5,11 @@
 #include <sophiatx/chain/sophiatx_object_types.hpp>
 #include <sophiatx/remote_db/remote_db.hpp>
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
 
 
 namespace sophiatx {
@@ -73,6 +78,8 @@ public:
       return signed_transaction();
    }
 
+   optional<annotated_signed_transaction> fetch_transaction_from_block_log(const transaction_id_type &trx_id) const;
+
    std::vector<block_id_type> get_block_ids_on_fork(block_id_type head_of_fork) const {
       not_implemented();
       return std::vector<block_id_type>();
@@ -124,16 +131,17 @@ public:
 
 private:
 
+   /// Applies the app messages the full node pushes through a subscription, resumed from the last applied one
    void start_sync_with_full_node();
 
-   bool is_sync() const;
+   /// Queues a message pushed by the full node, called on the connection thread
+   void on_pushed_op(const fc::variant &v);
 
-   const remote::get_app_custom_messages_return::iterator &
-   get_unprocessed_op(const remote::get_app_custom_messages_return::iterator &start,
-                      const remote::get_app_custom_messages_return::iterator &end,
-                      size_t size) const;
+   /// Applies the messages following the last applied one under a single write lock
+   void apply_custom_ops(const std::deque<remote::packed_received_object> &ops);
 
-   void apply_custom_op(const remote::received_object &obj);
+   /// Applies the message through the app evaluator, the caller holds the write lock
+   void apply_custom_op(const remote::packed_received_object &obj);
 
    const hybrid_db_property_object &get_hybrid_db_properties() const;
 
@@ -142,7 +150,11 @@ private:
    uint64_t _head_op_id;
    uint64_t _app_id;
    fc::thread _remote_api_thread;
-   bool _running;
+   std::atomic<bool> _running{false};
+
+   std::deque<remote::packed_received_object> _pushed_ops;
+   std::mutex _pushed_ops_mtx;
+   std::condition_variable _pushed_ops_cv;
 };
 
 }
@@ -17,7 +17,7 @@ using namespace sophiatx::protocol;
 class economic_model_object: public object< economic_model_object_type, economic_model_object> {
 public:
    template< typename Constructor, typename Allocator >
-   economic_model_object( Constructor&& c, allocator< Allocator > a ) : historic_supply( historic_supply_allocator_type( a.get_segment_manager() ) )
+   economic_model_object( Constructor&& c, allocator< Allocator > a )
    {
       c( *this );
    }
@@ -38,14 +38,12 @@ public:
    share_type coinbase_block_reward;
 
    typedef bip::allocator< economic_model_object, bip::managed_mapped_file::segment_manager >  allocator_type;
-   typedef bip::allocator< std::pair< uint32_t, share_type >, bip::managed_mapped_file::segment_manager > historic_supply_allocator_type;
-   typedef bip::flat_map< uint32_t, share_type, std::less< uint32_t >, historic_supply_allocator_type > historic_supply_map;
 
-   historic_supply_map historic_supply;
    share_type accumulated_supply;   //< sum of coin supplies over last $SOPHIATX_INTEREST_BLOCKS blocks
 
    void init_economics(share_type init_supply, share_type total_supply);
-   void record_block(uint32_t block, share_type current_supply);
+   //current_supply replaces replaced_supply, recorded SOPHIATX_INTEREST_BLOCKS blocks ago, in the accumulated supply window
+   void record_block(share_type current_supply, share_type replaced_supply);
    share_type get_mining_reward(uint32_t block_number) const;
    share_type withdraw_mining_reward(uint32_t block_number, uint32_t nominator, uint32_t denominator);
    share_type withdraw_interests(share_type holding, uint32_t period);
@@ -66,6 +64,40 @@ typedef multi_index_container<
       allocator< economic_model_object >
 > economic_model_index;
 
+/**
+ * One slot of the ring buffer of coin supplies over the last $SOPHIATX_INTEREST_BLOCKS blocks, block N is recorded
+ * in slot N % SOPHIATX_INTEREST_BLOCKS. All slots are created in genesis, so recording a block modifies a single
+ * small object and keeps the undo state of the economic model constant in size.
+ */
+class economic_historic_supply_object: public object< economic_historic_supply_object_type, economic_historic_supply_object> {
+public:
+   template< typename Constructor, typename Allocator >
+   economic_historic_supply_object( Constructor&& c, allocator< Allocator > a )
+   {
+      c( *this );
+   }
+
+   economic_historic_supply_object() =delete;
+
+   id_type           id;
+
+   uint32_t   slot = 0;
+   share_type supply = 0;
+};
+
+struct by_slot;
+
+typedef multi_index_container<
+      economic_historic_supply_object,
+      indexed_by<
+            ordered_unique< tag< by_id >,
+                  member< economic_historic_supply_object, economic_historic_supply_object::id_type, &economic_historic_supply_object::id > >,
+            ordered_unique< tag< by_slot >,
+                  member< economic_historic_supply_object, uint32_t, &economic_historic_supply_object::slot > >
+      >,
+      allocator< economic_historic_supply_object >
+> economic_historic_supply_index;
+
 }}//namespace
 
 
@@ -78,11 +110,14 @@ FC_REFLECT(sophiatx::chain::economic_model_object, (id)
            (interest_pool_from_coinbase)
            (interest_pool_from_fees)
            (promotion_pool)
+           (burn_pool)
            (initial_promotion_pool)
            (init_supply)
            (total_supply)
-           (historic_supply)
            (accumulated_supply)
            (coinbase_block_reward)
 )
 CHAINBASE_SET_INDEX_TYPE( sophiatx::chain::economic_model_object, sophiatx::chain::economic_model_index )
+
+FC_REFLECT(sophiatx::chain::economic_historic_supply_object, (id)(slot)(supply))
+CHAINBASE_SET_INDEX_TYPE( sophiatx::chain::economic_historic_supply_object, sophiatx::chain::economic_historic_supply_index )
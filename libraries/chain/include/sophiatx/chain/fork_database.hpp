@@ -1,5 +1,6 @@
 #pragma once
 #include <sophiatx/protocol/block.hpp>
+#include <sophiatx/chain/transaction_envelope.hpp>
 
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/member.hpp>
@@ -17,8 +18,8 @@ namespace sophiatx { namespace chain {
 
    struct fork_item
    {
-      fork_item( signed_block d )
-      :num(d.block_num()),id(d.id()),data( std::move(d) ){}
+      fork_item( signed_block d, transaction_envelopes e = transaction_envelopes() )
+      :num(d.block_num()),id(d.id()),data( std::move(d) ),envelopes( std::move(e) ){}
 
       block_id_type previous_id()const { return data.previous; }
 
@@ -31,6 +32,11 @@ namespace sophiatx { namespace chain {
       bool                  invalid = false;
       block_id_type         id;
       signed_block          data;
+      /**
+       * Envelopes of the block transactions with their recovered signing keys, reused when the block is applied
+       * again on a fork switch and when its transactions are popped. Empty if not provided when pushed.
+       */
+      transaction_envelopes envelopes;
    };
    typedef shared_ptr<fork_item> item_ptr;
 
@@ -65,7 +71,7 @@ namespace sophiatx { namespace chain {
          /**
           *  @return the new head block ( the longest fork )
           */
-         shared_ptr<fork_item>            push_block(const signed_block& b);
+         shared_ptr<fork_item>            push_block(const signed_block& b, const transaction_envelopes& envelopes = transaction_envelopes());
          shared_ptr<fork_item>            head()const { return _head; }
          void                             pop_block();
 
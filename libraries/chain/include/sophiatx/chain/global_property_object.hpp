@@ -41,6 +41,15 @@ namespace sophiatx { namespace chain {
          asset       total_vesting_shares       = asset( 0, VESTS_SYMBOL );
          asset       total_reward_fund    = asset( 0, SOPHIATX_SYMBOL );
 
+         /**
+          *  Running totals of account and escrow holdings, updated by delta wherever a balance changes. They let
+          *  database::validate_invariants() check the supply without scanning all accounts and escrows, the full
+          *  scan is done by database::audit_invariants().
+          */
+         asset       total_account_balances     = asset( 0, SOPHIATX_SYMBOL );
+         asset       total_account_vesting      = asset( 0, VESTS_SYMBOL );
+         asset       total_escrow_balances      = asset( 0, SOPHIATX_SYMBOL );
+
          asset       witness_required_vesting  = asset( SOPHIATX_INITIAL_WITNESS_REQUIRED_VESTING_BALANCE, SOPHIATX_SYMBOL );
 
 
@@ -95,6 +104,9 @@ FC_REFLECT( sophiatx::chain::dynamic_global_property_object,
              (current_supply)
              (total_vesting_shares)
              (total_reward_fund)
+             (total_account_balances)
+             (total_account_vesting)
+             (total_escrow_balances)
              (maximum_block_size)
              (current_aslot)
              (witness_required_vesting)
@@ -0,0 +1,92 @@
+#pragma once
+#include <sophiatx/chain/sophiatx_object_types.hpp>
+
+#include <chainbase/chainbase.hpp>
+
+#include <fc/interprocess/container.hpp>
+#include <fc/io/raw.hpp>
+
+#include <cstring>
+
+namespace sophiatx { namespace chain {
+
+   /* Reflected members are packed by fc::raw, which falls back to stream operators for types whose pack() and
+    * unpack() overloads are declared after fc/io/raw.hpp (object ids, shared strings and containers). Streams
+    * used to pack chain objects derive from object_stream, whose operators forward such members back to their
+    * fc::raw overloads.
+    */
+   template< typename Stream >
+   struct object_stream {};
+
+   template< typename Stream, typename T >
+   Stream& operator<<( object_stream< Stream >& s, const chainbase::oid< T >& v ) { fc::raw::pack( static_cast< Stream& >( s ), v ); return static_cast< Stream& >( s ); }
+   template< typename Stream, typename T >
+   Stream& operator>>( object_stream< Stream >& s, chainbase::oid< T >& v ) { fc::raw::unpack( static_cast< Stream& >( s ), v, 0 ); return static_cast< Stream& >( s ); }
+
+   template< typename Stream >
+   Stream& operator<<( object_stream< Stream >& s, const shared_string& v ) { fc::raw::pack( static_cast< Stream& >( s ), v ); return static_cast< Stream& >( s ); }
+   template< typename Stream >
+   Stream& operator>>( object_stream< Stream >& s, shared_string& v ) { fc::raw::unpack( static_cast< Stream& >( s ), v, 0 ); return static_cast< Stream& >( s ); }
+
+   template< typename Stream, typename T, typename... A >
+   Stream& operator<<( object_stream< Stream >& s, const bip::deque< T, A... >& v ) { fc::raw::pack( static_cast< Stream& >( s ), v ); return static_cast< Stream& >( s ); }
+   template< typename Stream, typename T, typename... A >
+   Stream& operator>>( object_stream< Stream >& s, bip::deque< T, A... >& v ) { fc::raw::unpack( static_cast< Stream& >( s ), v, 0 ); return static_cast< Stream& >( s ); }
+
+   /** Packs objects at the end of a memory buffer */
+   class object_buffer_writer : public object_stream< object_buffer_writer >
+   {
+      public:
+         explicit object_buffer_writer( std::vector< char >& buffer ) : _buffer( buffer ) {}
+
+         void write( const char* d, size_t s ) { _buffer.insert( _buffer.end(), d, d + s ); }
+         void put( char c ) { _buffer.push_back( c ); }
+
+      private:
+         std::vector< char >& _buffer;
+   };
+
+   /** Unpacks objects from a memory buffer */
+   class object_buffer_reader : public object_stream< object_buffer_reader >
+   {
+      public:
+         object_buffer_reader( const char* data, size_t size ) : _pos( data ), _end( data + size ) {}
+
+         void read( char* d, size_t s )
+         {
+            FC_ASSERT( s <= remaining(), "Unexpected end of object data" );
+            std::memcpy( d, _pos, s );
+            _pos += s;
+         }
+         void get( char& c ) { read( &c, 1 ); }
+
+         size_t remaining()const { return _end - _pos; }
+
+      private:
+         const char* _pos;
+         const char* _end;
+   };
+
+   /**
+    * Undo codec packing the whole object with fc::raw, enabled for a type with CHAINBASE_SET_UNDO_DELTA_CODEC.
+    * The type must reflect all of its members.
+    */
+   template< typename T >
+   struct raw_undo_delta_codec
+   {
+      static void pack( const T& v, std::vector< char >& image )
+      {
+         image.clear();
+         object_buffer_writer out( image );
+         fc::raw::pack( out, v );
+      }
+
+      static void unpack( const char* data, size_t size, T& v )
+      {
+         object_buffer_reader in( data, size );
+         fc::raw::unpack( in, v, 0 );
+         FC_ASSERT( in.remaining() == 0, "Unexpected data at the end of object image" );
+      }
+   };
+
+} } // sophiatx::chain
@@ -0,0 +1,119 @@
+#pragma once
+#include <sophiatx/chain/transaction_envelope.hpp>
+#include <sophiatx/protocol/version.hpp>
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/composite_key.hpp>
+
+namespace sophiatx { namespace chain {
+   using boost::multi_index_container;
+   using namespace boost::multi_index;
+
+   using sophiatx::protocol::account_name_type;
+   using sophiatx::protocol::block_id_type;
+
+   struct pending_transaction
+   {
+      pending_transaction( const transaction_envelope_ptr& t, uint64_t seq, const flat_set< account_name_type >& fee_payers );
+
+      transaction_envelope_ptr         trx;
+      uint64_t                         sequence;
+      transaction_id_type              id;
+      fc::time_point_sec               expiration;
+      flat_set< account_name_type >    accounts;   ///< accounts impacted by the operations of the transaction and paying its fees
+   };
+
+   struct pending_account_entry
+   {
+      account_name_type                account;
+      uint64_t                         sequence;
+   };
+
+   /**
+    *  Transactions pushed to the node and not yet included in a block, in the order they were applied on top
+    *  of the head block (see database::_pending_tx_session).
+    *
+    *  Besides the application order the pool is indexed by transaction id, by expiration, so expired
+    *  transactions can be dropped without applying them again, and by the accounts the transactions depend on,
+    *  so the block producer can tell whether leaving a transaction out of a block affects the transactions after it.
+    */
+   class pending_transaction_pool
+   {
+      public:
+         struct by_sequence;
+         struct by_id;
+         struct by_expiration;
+         struct by_account;
+
+         typedef multi_index_container<
+            pending_transaction,
+            indexed_by<
+               ordered_unique< tag< by_sequence >, member< pending_transaction, uint64_t, &pending_transaction::sequence > >,
+               hashed_non_unique< tag< by_id >, member< pending_transaction, transaction_id_type, &pending_transaction::id >, std::hash< fc::ripemd160 > >,
+               ordered_non_unique< tag< by_expiration >, member< pending_transaction, fc::time_point_sec, &pending_transaction::expiration > >
+            >
+         > transaction_index_type;
+
+         typedef multi_index_container<
+            pending_account_entry,
+            indexed_by<
+               ordered_unique< tag< by_account >,
+                  composite_key< pending_account_entry,
+                     member< pending_account_entry, account_name_type, &pending_account_entry::account >,
+                     member< pending_account_entry, uint64_t, &pending_account_entry::sequence >
+                  >
+               >
+            >
+         > account_index_type;
+
+         /**
+          * Adds the transaction after all transactions of the pool. The accounts which paid its fees are dependencies
+          * of the transaction besides the impacted ones, a fee sponsor is not impacted by the operations.
+          */
+         void                       push_back( const transaction_envelope_ptr& trx, const flat_set< account_name_type >& fee_payers );
+
+         const pending_transaction* find( const transaction_id_type& id )const;
+
+         /** Drops transactions expiring at or before given time, @return the number of dropped transactions */
+         size_t                     remove_expired( fc::time_point_sec now );
+
+         /**
+          * @return true if a transaction of the pool, which is not in left_out, depends on an account an earlier
+          * transaction in left_out depends on
+          */
+         bool                       has_dependents( const flat_set< uint64_t >& left_out )const;
+
+         void                       clear();
+
+         const transaction_index_type& indices()const { return _transactions; }
+         size_t                     size()const { return _transactions.size(); }
+         bool                       empty()const { return _transactions.empty(); }
+
+         /** The head block the pool transactions were applied on, with its time and the hardfork applied then */
+         const block_id_type&       head()const { return _head; }
+         fc::time_point_sec         head_time()const { return _head_time; }
+         const protocol::hardfork_version& head_hardfork()const { return _head_hardfork; }
+
+         void                       set_head( const block_id_type& head, fc::time_point_sec head_time = fc::time_point_sec(),
+                                              const protocol::hardfork_version& hardfork = protocol::hardfork_version() )
+         {
+            _head = head;
+            _head_time = head_time;
+            _head_hardfork = hardfork;
+         }
+
+      private:
+         void                       remove_accounts( const pending_transaction& trx );
+
+         transaction_index_type     _transactions;
+         account_index_type         _accounts;
+         uint64_t                   _next_sequence = 0;
+         block_id_type              _head;
+         fc::time_point_sec         _head_time;
+         protocol::hardfork_version _head_hardfork;
+   };
+
+} } // sophiatx::chain
@@ -58,7 +58,13 @@ enum object_type
    application_object_type,
    account_fee_sponsor_object_type,
    application_buying_object_type,
-   hybrid_db_property_object_type
+   hybrid_db_property_object_type,
+   economic_historic_supply_object_type,
+   block_stats_object_type,
+   block_stats_window_object_type,
+   custom_content_payload_object_type,
+   custom_content_sequence_object_type,
+   custom_content_storage_object_type
 };
 
 class dynamic_global_property_object;
@@ -84,6 +90,12 @@ class application_object;
 class account_fee_sponsor_object;
 class application_buying_object;
 class hybrid_db_property_object;
+class economic_historic_supply_object;
+class block_stats_object;
+class block_stats_window_object;
+class custom_content_payload_object;
+class custom_content_sequence_object;
+class custom_content_storage_object;
 
 
 typedef oid< dynamic_global_property_object         > dynamic_global_property_id_type;
@@ -109,6 +121,12 @@ typedef oid< application_object                     > application_id_type;
 typedef oid< account_fee_sponsor_object             > account_fee_sponsor_id_type;
 typedef oid< application_buying_object              > application_buying_id_type;
 typedef oid< hybrid_db_property_object              > hybrid_db_property_object_id_type;
+typedef oid< economic_historic_supply_object        > economic_historic_supply_id_type;
+typedef oid< block_stats_object                     > block_stats_id_type;
+typedef oid< block_stats_window_object              > block_stats_window_id_type;
+typedef oid< custom_content_payload_object          > custom_content_payload_id_type;
+typedef oid< custom_content_sequence_object         > custom_content_sequence_id_type;
+typedef oid< custom_content_storage_object          > custom_content_storage_id_type;
 
 
 enum bandwidth_type
@@ -146,6 +164,22 @@ namespace fc
    }
 
    namespace raw {
+      template<typename Stream>
+      inline void pack( Stream& s, const sophiatx::chain::shared_string& str )
+      {
+         pack( s, unsigned_int( (uint32_t)str.size() ) );
+         if( str.size() ) s.write( str.data(), str.size() );
+      }
+      template<typename Stream>
+      inline void unpack( Stream& s, sophiatx::chain::shared_string& str, uint32_t depth )
+      {
+         FC_ASSERT( depth <= MAX_RECURSION_DEPTH );
+         unsigned_int size;
+         unpack( s, size, depth );
+         str.resize( size.value );
+         if( size.value ) s.read( &str[0], size.value );
+      }
+
       template<typename Stream, typename T>
       inline void pack( Stream& s, const chainbase::oid<T>& id )
       {
@@ -184,6 +218,12 @@ FC_REFLECT_ENUM( sophiatx::chain::object_type,
                  (account_fee_sponsor_object_type)
                  (application_buying_object_type)
                  (hybrid_db_property_object_type)
+                 (economic_historic_supply_object_type)
+                 (block_stats_object_type)
+                 (block_stats_window_object_type)
+                 (custom_content_payload_object_type)
+                 (custom_content_sequence_object_type)
+                 (custom_content_storage_object_type)
                )
 
 FC_REFLECT_TYPENAME( sophiatx::chain::shared_string )
@@ -0,0 +1,152 @@
+#pragma once
+#include <sophiatx/protocol/types.hpp>
+#include <sophiatx/chain/sophiatx_object_types.hpp>
+#include <sophiatx/chain/object_stream.hpp>
+
+#include <chainbase/chainbase.hpp>
+
+#include <fc/filesystem.hpp>
+
+#include <fstream>
+
+#define SOPHIATX_STATE_SNAPSHOT_VERSION 4
+#define SOPHIATX_STATE_SNAPSHOT_MANIFEST "manifest.json"
+
+namespace sophiatx { namespace chain {
+
+   using sophiatx::protocol::chain_id_type;
+   using sophiatx::protocol::block_id_type;
+
+   /* A state snapshot is a directory holding a copy of all chainbase indexes at a given head block, so a node
+    * can be started from it instead of replaying the whole block log.
+    *
+    * Every index is written into its own file as a sequence of fc::raw packed objects, including their ids.
+    * The manifest (a JSON file) records the chain, its genesis time and the head block of the snapshot and, for
+    * every index, the number of objects, the next object id and the checksum of its file. The chain id and the
+    * genesis time are not part of the serialized dynamic global properties, they are restored from the manifest.
+    * The objects are restored with their original ids, so the imported state is identical to the exported one.
+    */
+
+   struct state_snapshot_index
+   {
+      std::string       type_name;
+      uint32_t          type_id = 0;
+      uint64_t          count = 0;
+      int64_t           next_id = 0;
+      fc::sha256        checksum;
+   };
+
+   struct state_snapshot_manifest
+   {
+      uint32_t                               version = SOPHIATX_STATE_SNAPSHOT_VERSION;
+      chain_id_type                          chain_id;
+      fc::time_point_sec                     genesis_time;
+      uint32_t                               head_block_num = 0;
+      block_id_type                          head_block_id;
+      std::vector< state_snapshot_index >    indexes;
+   };
+
+   namespace detail {
+
+      /** Writes the index file and hashes it on the way, used as an fc::raw stream */
+      class state_snapshot_writer : public object_stream< state_snapshot_writer >
+      {
+         public:
+            explicit state_snapshot_writer( const fc::path& file );
+
+            void write( const char* d, size_t s );
+            void put( char c ) { write( &c, 1 ); }
+
+            /** Flushes and closes the file, @return the checksum of the written data */
+            fc::sha256 finish();
+
+         private:
+            fc::path             _file;
+            std::ofstream        _out;
+            fc::sha256::encoder  _enc;
+      };
+
+      /** Reads the index file and hashes it on the way, used as an fc::raw stream */
+      class state_snapshot_reader : public object_stream< state_snapshot_reader >
+      {
+         public:
+            explicit state_snapshot_reader( const fc::path& file );
+
+            void read( char* d, size_t s );
+            void get( char& c ) { read( &c, 1 ); }
+
+            /** Checks the whole file has been read, @return the checksum of the read data */
+            fc::sha256 finish();
+
+         private:
+            fc::path             _file;
+            std::ifstream        _in;
+            fc::sha256::encoder  _enc;
+      };
+
+   }
+
+   /**
+    * Index extension exporting and importing the objects of a single index. It is attached to every index
+    * registered through add_core_index() or add_plugin_index(), see index.hpp, so snapshots cover plugin
+    * state as well.
+    */
+   class abstract_state_snapshot_index : public chainbase::index_extension
+   {
+      public:
+         virtual uint32_t     type_id()const = 0;
+         virtual std::string  type_name()const = 0;
+
+         /** Writes all objects of the index into the file */
+         virtual state_snapshot_index export_index( const chainbase::database& db, const fc::path& file )const = 0;
+
+         /** Restores the objects of the index from the file, the index must be empty and have no undo state */
+         virtual void import_index( chainbase::database& db, const state_snapshot_index& info, const fc::path& file )const = 0;
+   };
+
+   template< typename MultiIndexType >
+   class state_snapshot_index_extension : public abstract_state_snapshot_index
+   {
+      public:
+         typedef typename MultiIndexType::value_type value_type;
+
+         uint32_t type_id()const override { return value_type::type_id; }
+
+         std::string type_name()const override { return fc::get_typename< value_type >::name(); }
+
+         state_snapshot_index export_index( const chainbase::database& db, const fc::path& file )const override
+         {
+            const auto& idx = db.get_index< MultiIndexType >();
+            detail::state_snapshot_writer out( file );
+
+            for( const auto& o : idx.indices() )
+               fc::raw::pack( out, o );
+
+            state_snapshot_index info;
+            info.type_name = type_name();
+            info.type_id = type_id();
+            info.count = idx.indices().size();
+            info.next_id = idx.next_id()._id;
+            info.checksum = out.finish();
+            return info;
+         }
+
+         void import_index( chainbase::database& db, const state_snapshot_index& info, const fc::path& file )const override
+         {
+            auto& idx = db.get_mutable_index< MultiIndexType >();
+            FC_ASSERT( idx.indices().empty(), "Cannot import a snapshot into a non empty index", ("type", info.type_name) );
+
+            detail::state_snapshot_reader in( file );
+
+            for( uint64_t i = 0; i < info.count; ++i )
+               idx.emplace( [&]( value_type& o ) { fc::raw::unpack( in, o, 0 ); } );
+
+            FC_ASSERT( in.finish() == info.checksum, "Snapshot index checksum mismatch", ("type", info.type_name) );
+            idx.set_next_id( typename value_type::id_type( info.next_id ) );
+         }
+   };
+
+} } // sophiatx::chain
+
+FC_REFLECT( sophiatx::chain::state_snapshot_index, (type_name)(type_id)(count)(next_id)(checksum) )
+FC_REFLECT( sophiatx::chain::state_snapshot_manifest, (version)(chain_id)(genesis_time)(head_block_num)(head_block_id)(indexes) )
@@ -0,0 +1,95 @@
+#pragma once
+#include <sophiatx/protocol/block.hpp>
+#include <sophiatx/protocol/exceptions.hpp>
+#include <sophiatx/protocol/transaction.hpp>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+namespace sophiatx { namespace chain {
+
+   using sophiatx::protocol::signed_block;
+   using sophiatx::protocol::signed_block_header;
+   using sophiatx::protocol::signed_transaction;
+   using sophiatx::protocol::transaction_id_type;
+   using sophiatx::protocol::digest_type;
+   using sophiatx::protocol::chain_id_type;
+   using sophiatx::protocol::public_key_type;
+
+   /**
+    * Immutable wrapper of a signed transaction that caches everything the chain derives from the transaction
+    * bytes: the packed transaction, its size, id, merkle digest, signature digest and the signing keys.
+    *
+    * The transaction is packed once on construction, all digests are computed from the packed bytes. Merkle
+    * digest and signing keys are computed on first use and remembered, so an envelope can be prepared outside
+    * of the write lock (on the API or p2p thread, or on a worker pool) and then carried through push, block
+    * production and block application without hashing or serializing the transaction again.
+    *
+    * Envelopes are shared between the pending transaction list, produced blocks and the fork database, hence
+    * they are always handled through transaction_envelope_ptr.
+    */
+   class transaction_envelope
+   {
+      public:
+         transaction_envelope( signed_transaction trx, const chain_id_type& chain_id );
+
+         const signed_transaction&        get_transaction()const { return _trx; }
+         const transaction_id_type&       id()const { return _id; }
+         const digest_type&               sig_digest()const { return _sig_digest; }
+         const std::vector< char >&       packed()const { return _packed; }
+         size_t                           packed_size()const { return _packed.size(); }
+
+         /** Same as signed_transaction::merkle_digest() */
+         const digest_type&               merkle_digest()const;
+
+         /**
+          * Keys recovered from the transaction signatures. Canonicity of the signatures is not checked, as it depends
+          * on the hardfork state, see database::_apply_transaction. Throws if the keys cannot be recovered.
+          */
+         const flat_set< public_key_type >& signature_keys()const;
+
+         /** @return true if the signing keys have already been recovered */
+         bool                             has_signature_keys()const { return _keys_recovered; }
+
+         /**
+          * Same as signed_transaction::validate(). The operations are validated on first call only, later calls
+          * rethrow the remembered error, so a transaction validated before it enters the write queue is not
+          * validated again by database::_apply_transaction.
+          */
+         void                             validate()const;
+
+         /** @return true if the transaction has already been validated */
+         bool                             is_validated()const { return _validated; }
+
+      private:
+         const signed_transaction         _trx;
+         std::vector< char >              _packed;
+         transaction_id_type              _id;
+         digest_type                      _sig_digest;
+
+         mutable std::once_flag           _merkle_digest_flag;
+         mutable digest_type              _merkle_digest;
+
+         mutable std::once_flag           _keys_flag;
+         mutable flat_set< public_key_type > _keys;
+         mutable std::atomic< bool >      _keys_recovered{ false };
+
+         mutable std::once_flag           _validate_flag;
+         mutable std::shared_ptr< fc::exception > _validation_error;
+         mutable std::atomic< bool >      _validated{ false };
+   };
+
+   typedef std::shared_ptr< const transaction_envelope > transaction_envelope_ptr;
+   typedef vector< transaction_envelope_ptr >            transaction_envelopes;
+
+   /** Wraps all transactions of the block */
+   transaction_envelopes make_transaction_envelopes( const signed_block& b, const chain_id_type& chain_id );
+
+   /** Same as signed_block::calculate_merkle_root(), using the cached transaction digests */
+   protocol::checksum_type calculate_merkle_root( const transaction_envelopes& envelopes );
+
+   /** Same as fc::raw::pack_size() of the block consisting of given header and transactions */
+   size_t packed_block_size( const signed_block_header& header, const transaction_envelopes& envelopes );
+
+} } // sophiatx::chain
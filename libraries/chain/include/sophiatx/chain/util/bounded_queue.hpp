@@ -0,0 +1,97 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+namespace sophiatx { namespace chain { namespace util {
+
+/**
+ * Blocking FIFO queue with a fixed capacity, used to hand work between a producer and a consumer thread.
+ * push() waits while the queue is full, pop() waits while it is empty and try_pop() never waits. After close()
+ * is called pushes are rejected and pop() drains the remaining items before returning false.
+ */
+template< typename T >
+class bounded_queue
+{
+   public:
+      explicit bounded_queue( size_t capacity ) : _capacity( capacity ? capacity : 1 ) {}
+
+      bool push( T item )
+      {
+         std::unique_lock< std::mutex > lock( _mtx );
+         _not_full.wait( lock, [&]() { return _closed || _items.size() < _capacity; } );
+
+         if( _closed )
+            return false;
+
+         _items.push_back( std::move( item ) );
+         lock.unlock();
+         _not_empty.notify_one();
+         return true;
+      }
+
+      bool pop( T& item )
+      {
+         std::unique_lock< std::mutex > lock( _mtx );
+         _not_empty.wait( lock, [&]() { return _closed || !_items.empty(); } );
+
+         if( _items.empty() )
+            return false;
+
+         item = std::move( _items.front() );
+         _items.pop_front();
+         lock.unlock();
+         _not_full.notify_one();
+         return true;
+      }
+
+      bool try_pop( T& item )
+      {
+         std::unique_lock< std::mutex > lock( _mtx );
+
+         if( _items.empty() )
+            return false;
+
+         item = std::move( _items.front() );
+         _items.pop_front();
+         lock.unlock();
+         _not_full.notify_one();
+         return true;
+      }
+
+      void close()
+      {
+         {
+            std::lock_guard< std::mutex > lock( _mtx );
+            _closed = true;
+         }
+         _not_full.notify_all();
+         _not_empty.notify_all();
+      }
+
+      bool is_closed() const
+      {
+         std::lock_guard< std::mutex > lock( _mtx );
+         return _closed;
+      }
+
+      size_t size() const
+      {
+         std::lock_guard< std::mutex > lock( _mtx );
+         return _items.size();
+      }
+
+      size_t capacity() const { return _capacity; }
+
+   private:
+      const size_t              _capacity;
+      std::deque< T >           _items;
+      bool                      _closed = false;
+
+      mutable std::mutex        _mtx;
+      std::condition_variable   _not_full;
+      std::condition_variable   _not_empty;
+};
+
+} } } // sophiatx::chain::util
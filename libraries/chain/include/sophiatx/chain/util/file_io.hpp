@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace sophiatx { namespace chain { namespace util {
+
+/**
+ * Helpers for the files written through plain descriptors next to the block log and the shared memory file.
+ * Short reads and writes are continued, interrupted calls are retried, other errors throw.
+ */
+
+/** Writes the data at the current position of the file */
+void write_all( int fd, const char* data, size_t size );
+
+/** Writes the data at given offset, the position of the file does not change */
+void write_all( int fd, const char* data, size_t size, uint64_t offset );
+
+/** Reads exactly size bytes at given offset, reading past the end of the file throws */
+void read_all( int fd, char* data, size_t size, uint64_t offset );
+
+/** Waits until the written data of the file are on disk */
+void sync_data( int fd );
+
+} } } // sophiatx::chain::util
@@ -4,6 +4,7 @@
 #include <sophiatx/protocol/sophiatx_operations.hpp>
 
 #include <sophiatx/chain/sophiatx_object_types.hpp>
+#include <sophiatx/chain/object_stream.hpp>
 
 #include <boost/multi_index/composite_key.hpp>
 #include <boost/interprocess/managed_mapped_file.hpp>
@@ -302,6 +303,7 @@ FC_REFLECT( sophiatx::chain::witness_object,
              (hardfork_version_vote)(hardfork_time_vote)
           )
 CHAINBASE_SET_INDEX_TYPE( sophiatx::chain::witness_object, sophiatx::chain::witness_index )
+CHAINBASE_SET_UNDO_DELTA_CODEC( sophiatx::chain::witness_object, sophiatx::chain::raw_undo_delta_codec< sophiatx::chain::witness_object > )
 
 FC_REFLECT( sophiatx::chain::witness_vote_object, (id)(witness)(account) )
 CHAINBASE_SET_INDEX_TYPE( sophiatx::chain::witness_vote_object, sophiatx::chain::witness_vote_index )
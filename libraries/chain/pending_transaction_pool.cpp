@@ -0,0 +1,88 @@
+#include <sophiatx/chain/pending_transaction_pool.hpp>
+#include <sophiatx/chain/util/impacted.hpp>
+
+namespace sophiatx { namespace chain {
+
+pending_transaction::pending_transaction( const transaction_envelope_ptr& t, uint64_t seq, const flat_set< account_name_type >& fee_payers )
+   : trx( t ), sequence( seq ), id( t->id() ), expiration( t->get_transaction().expiration )
+{
+   sophiatx::app::transaction_get_impacted_accounts( t->get_transaction(), accounts );
+   accounts.insert( fee_payers.begin(), fee_payers.end() );
+}
+
+void pending_transaction_pool::push_back( const transaction_envelope_ptr& trx, const flat_set< account_name_type >& fee_payers )
+{
+   auto inserted = _transactions.emplace( trx, _next_sequence, fee_payers );
+
+   for( const auto& account : inserted.first->accounts )
+      _accounts.insert( pending_account_entry{ account, _next_sequence } );
+
+   ++_next_sequence;
+}
+
+const pending_transaction* pending_transaction_pool::find( const transaction_id_type& id )const
+{
+   const auto& by_id_idx = _transactions.get< by_id >();
+   auto itr = by_id_idx.find( id );
+   return itr == by_id_idx.end() ? nullptr : &*itr;
+}
+
+size_t pending_transaction_pool::remove_expired( fc::time_point_sec now )
+{
+   auto& by_exp_idx = _transactions.get< by_expiration >();
+   size_t removed = 0;
+
+   auto itr = by_exp_idx.begin();
+   while( itr != by_exp_idx.end() && itr->expiration <= now )
+   {
+      remove_accounts( *itr );
+      itr = by_exp_idx.erase( itr );
+      ++removed;
+   }
+
+   return removed;
+}
+
+bool pending_transaction_pool::has_dependents( const flat_set< uint64_t >& left_out )const
+{
+   const auto& by_seq_idx = _transactions.get< by_sequence >();
+   const auto& by_account_idx = _accounts.get< by_account >();
+
+   for( uint64_t sequence : left_out )
+   {
+      auto trx = by_seq_idx.find( sequence );
+      if( trx == by_seq_idx.end() )
+         continue;
+
+      for( const auto& account : trx->accounts )
+      {
+         auto itr = by_account_idx.upper_bound( boost::make_tuple( account, sequence ) );
+         for( ; itr != by_account_idx.end() && itr->account == account; ++itr )
+            if( left_out.find( itr->sequence ) == left_out.end() )
+               return true;
+      }
+   }
+
+   return false;
+}
+
+void pending_transaction_pool::clear()
+{
+   _transactions.clear();
+   _accounts.clear();
+   _head = block_id_type();
+}
+
+void pending_transaction_pool::remove_accounts( const pending_transaction& trx )
+{
+   auto& by_account_idx = _accounts.get< by_account >();
+
+   for( const auto& account : trx.accounts )
+   {
+      auto itr = by_account_idx.find( boost::make_tuple( account, trx.sequence ) );
+      if( itr != by_account_idx.end() )
+         by_account_idx.erase( itr );
+   }
+}
+
+} } // sophiatx::chain
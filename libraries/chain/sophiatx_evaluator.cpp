@@ -414,6 +414,8 @@ void escrow_transfer_evaluator::do_apply( const escrow_transfer_operation& o )
          esc.sophiatx_balance          = o.sophiatx_amount;
          esc.pending_fee            = o.escrow_fee;
       });
+
+      _db->adjust_escrow_holdings_total( o.sophiatx_amount + o.escrow_fee );
    }
    FC_CAPTURE_AND_RETHROW( (o) )
 }
@@ -460,12 +462,14 @@ void escrow_approve_evaluator::do_apply( const escrow_approve_operation& o )
       {
          _db->adjust_balance( o.from, escrow.sophiatx_balance );
          _db->adjust_balance( o.from, escrow.pending_fee );
+         _db->adjust_escrow_holdings_total( -( escrow.sophiatx_balance + escrow.pending_fee ) );
 
          _db->remove( escrow );
       }
       else if( escrow.to_approved && escrow.agent_approved )
       {
          _db->adjust_balance( o.agent, escrow.pending_fee );
+         _db->adjust_escrow_holdings_total( -escrow.pending_fee );
 
          _db->modify( escrow, [&]( escrow_object& esc )
          {
@@ -537,6 +541,7 @@ void escrow_release_evaluator::do_apply( const escrow_release_operation& o )
       // If escrow expires and there is no dispute, either party can release funds to either party.
 
       _db->adjust_balance( o.receiver, o.sophiatx_amount );
+      _db->adjust_escrow_holdings_total( -o.sophiatx_amount );
 
       _db->modify( e, [&]( escrow_object& esc )
       {
@@ -710,44 +715,85 @@ void account_witness_vote_evaluator::do_apply( const account_witness_vote_operat
 
 void custom_evaluator::do_apply( const custom_operation& o ){}
 
-void custom_json_evaluator::do_apply( const custom_json_operation& o )
+/**
+ * Increments the sequence counter of the app, sender or recipient and returns the new sequence number.
+ */
+static uint64_t next_custom_content_sequence( const std::shared_ptr< database >& d, uint8_t type,
+                                              const account_name_type& account, uint64_t app_id )
 {
-   auto& d = db();
+   const auto* counter = d->find< custom_content_sequence_object, by_sequence_key >( boost::make_tuple( type, account, app_id ) );
+   if( counter == nullptr )
+   {
+      d->create< custom_content_sequence_object >( [&]( custom_content_sequence_object& c ) {
+           c.type = type;
+           c.account = account;
+           c.app_id = app_id;
+           c.sequence = 1;
+      });
+      return 1;
+   }
 
-    //TODO: move this to plugin
-    const auto& send_idx = d->get_index< custom_content_index >().indices().get< by_sender >();
-    auto send_itr = send_idx.lower_bound( boost::make_tuple( o.sender, o.app_id, uint64_t(-1) ) );
-    uint64_t sender_sequence = 1;
-    if( send_itr != send_idx.end() && send_itr->sender == o.sender && send_itr->app_id == o.app_id )
-      sender_sequence = send_itr->sender_sequence + 1;
-
-    const auto& app_msg_idx = d->get_index< custom_content_index >().indices().get< by_app_id >();
-    auto app_msg_itr = app_msg_idx.lower_bound( boost::make_tuple( o.app_id, uint64_t(-1) ) );
-    uint64_t app_message_sequence = 1;
-    if( app_msg_itr != app_msg_idx.end() && app_msg_itr->app_id == o.app_id )
-       app_message_sequence = app_msg_itr->app_message_sequence + 1;
-
-    for(const auto&r: o.recipients) {
-      uint64_t receiver_sequence = 1;
-      const auto& recv_idx = d->get_index< custom_content_index >().indices().get< by_recipient >();
-      auto recv_itr = recv_idx.lower_bound( boost::make_tuple( r, o.app_id, uint64_t(-1) ) );
-      if( recv_itr != recv_idx.end() && recv_itr->recipient == r && recv_itr->app_id == o.app_id )
-         receiver_sequence = recv_itr->recipient_sequence + 1;
+   d->modify( *counter, [&]( custom_content_sequence_object& c ) {
+        c.sequence++;
+   });
+   return counter->sequence;
+}
+
+/**
+ * Stores the content of a custom_json or custom_binary operation once and creates the received document of every
+ * recipient, which references it.
+ */
+template< typename Operation, typename PayloadSetter >
+static void create_custom_content( const std::shared_ptr< database >& d, const Operation& o, PayloadSetter&& set_payload )
+{
+   // nothing is received, the document takes no sequence numbers and stores no payload
+   if( o.recipients.empty() )
+      return;
+
+   //TODO: move this to plugin
+   uint64_t sender_sequence = next_custom_content_sequence( d, custom_content_sequence_object::sender_sequence, o.sender, o.app_id );
+   uint64_t app_message_sequence = next_custom_content_sequence( d, custom_content_sequence_object::app_sequence, account_name_type(), o.app_id );
+
+   const auto& payload = d->create<custom_content_payload_object>([ & ](custom_content_payload_object &p) {
+        set_payload( p );
+        for( auto o_r: o.recipients)
+           p.all_recipients.push_back(o_r);
+        p.block_num = d->head_block_num() + 1;
+        p.size = p.data.size() + p.json.size() + p.all_recipients.size() * sizeof( account_name_type );
+   });
+
+   const auto* storage = d->find< custom_content_storage_object >();
+   if( storage == nullptr )
+      storage = &d->create< custom_content_storage_object >( [&]( custom_content_storage_object& ) {} );
+
+   d->modify( *storage, [&]( custom_content_storage_object& s ) {
+        s.memory_size += payload.size;
+   });
+
+   for(const auto&r: o.recipients) {
+      uint64_t receiver_sequence = next_custom_content_sequence( d, custom_content_sequence_object::recipient_sequence, r, o.app_id );
 
       d->create<custom_content_object>([ & ](custom_content_object &c) {
-           c.binary = false;
-           from_string( c.json, o.json );
            c.app_id = o.app_id;
            c.sender = o.sender;
            c.recipient = r;
-           for( auto o_r: o.recipients)
-              c.all_recipients.push_back(o_r);
+           c.payload = payload.id;
            c.sender_sequence = sender_sequence;
            c.recipient_sequence = receiver_sequence;
            c.app_message_sequence = app_message_sequence;
            c.received = d->head_block_time();
       });
    }
+}
+
+void custom_json_evaluator::do_apply( const custom_json_operation& o )
+{
+   auto& d = db();
+
+   create_custom_content( d, o, [ & ](custom_content_payload_object &p) {
+        p.binary = false;
+        from_string( p.json, o.json );
+   });
 
    std::shared_ptr< custom_operation_interpreter > eval = d->get_custom_json_evaluator( o.app_id );
    if( !eval )
@@ -772,41 +818,10 @@ void custom_binary_evaluator::do_apply( const custom_binary_operation& o )
 {
    auto& d = db();
 
-   //TODO: move this to plugin
-   const auto& send_idx = d->get_index< custom_content_index >().indices().get< by_sender >();
-   auto send_itr = send_idx.lower_bound( boost::make_tuple( o.sender, o.app_id, uint64_t(-1) ) );
-   uint64_t sender_sequence = 1;
-   if( send_itr != send_idx.end() && send_itr->sender == o.sender && send_itr->app_id == o.app_id )
-      sender_sequence = send_itr->sender_sequence + 1;
-
-   const auto& app_msg_idx = d->get_index< custom_content_index >().indices().get< by_app_id >();
-   auto app_msg_itr = app_msg_idx.lower_bound( boost::make_tuple( o.app_id, uint64_t(-1) ) );
-   uint64_t app_message_sequence = 1;
-   if( app_msg_itr != app_msg_idx.end() && app_msg_itr->app_id == o.app_id )
-      app_message_sequence = app_msg_itr->app_message_sequence + 1;
-
-   for(const auto&r: o.recipients) {
-      uint64_t receiver_sequence = 1;
-      const auto& recv_idx = d->get_index< custom_content_index >().indices().get< by_recipient >();
-      auto recv_itr = recv_idx.lower_bound( boost::make_tuple( r, o.app_id, uint64_t(-1) ) );
-      if( recv_itr != recv_idx.end() && recv_itr->recipient == r && recv_itr->app_id == o.app_id )
-         receiver_sequence = recv_itr->recipient_sequence + 1;
-
-      d->create<custom_content_object>([ & ](custom_content_object &c) {
-           c.binary = true;
-           for( auto d: o.data)
-              c.data.push_back(d);
-           c.app_id = o.app_id;
-           c.sender = o.sender;
-           c.recipient = r;
-           for( auto o_r: o.recipients)
-              c.all_recipients.push_back(o_r);
-           c.sender_sequence = sender_sequence;
-           c.recipient_sequence = receiver_sequence;
-           c.app_message_sequence = app_message_sequence;
-           c.received = d->head_block_time();
-      });
-   }
+   create_custom_content( d, o, [ & ](custom_content_payload_object &p) {
+        p.binary = true;
+        p.data.assign( o.data.begin(), o.data.end() );
+   });
 
    std::shared_ptr< custom_operation_interpreter > eval = d->get_custom_json_evaluator( o.app_id );
    if( !eval )
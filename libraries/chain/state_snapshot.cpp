@@ -0,0 +1,45 @@
+#include <sophiatx/chain/state_snapshot.hpp>
+
+namespace sophiatx { namespace chain { namespace detail {
+
+state_snapshot_writer::state_snapshot_writer( const fc::path& file )
+   : _file( file ), _out( file.generic_string().c_str(), std::ios::out | std::ios::binary | std::ios::trunc )
+{
+   FC_ASSERT( _out.good(), "Cannot create snapshot file", ("file", _file) );
+}
+
+void state_snapshot_writer::write( const char* d, size_t s )
+{
+   _out.write( d, s );
+   _enc.write( d, s );
+}
+
+fc::sha256 state_snapshot_writer::finish()
+{
+   _out.flush();
+   FC_ASSERT( _out.good(), "Error writing snapshot file", ("file", _file) );
+   _out.close();
+   return _enc.result();
+}
+
+state_snapshot_reader::state_snapshot_reader( const fc::path& file )
+   : _file( file ), _in( file.generic_string().c_str(), std::ios::in | std::ios::binary )
+{
+   FC_ASSERT( _in.good(), "Cannot open snapshot file", ("file", _file) );
+}
+
+void state_snapshot_reader::read( char* d, size_t s )
+{
+   _in.read( d, s );
+   FC_ASSERT( size_t( _in.gcount() ) == s, "Unexpected end of snapshot file", ("file", _file) );
+   _enc.write( d, s );
+}
+
+fc::sha256 state_snapshot_reader::finish()
+{
+   FC_ASSERT( _in.peek() == std::ifstream::traits_type::eof(), "Unexpected data at the end of snapshot file", ("file", _file) );
+   _in.close();
+   return _enc.result();
+}
+
+} } } // sophiatx::chain::detail
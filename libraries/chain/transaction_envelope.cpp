@@ -0,0 +1,106 @@
+#include <sophiatx/chain/transaction_envelope.hpp>
+
+#include <fc/io/raw.hpp>
+
+namespace sophiatx { namespace chain {
+
+transaction_envelope::transaction_envelope( signed_transaction trx, const chain_id_type& chain_id )
+   : _trx( std::move( trx ) )
+{
+   _packed = fc::raw::pack_to_vector( _trx );
+
+   // signatures are packed after the transaction body, which alone is hashed into the id and the signature digest
+   uint32_t body_size = _packed.size() - fc::raw::pack_size( _trx.signatures );
+
+   auto h = digest_type::hash( _packed.data(), body_size );
+   memcpy( _id._hash, h._hash, std::min( sizeof( _id ), sizeof( h ) ) );
+
+   digest_type::encoder enc;
+   fc::raw::pack( enc, chain_id );
+   enc.write( _packed.data(), body_size );
+   _sig_digest = enc.result();
+}
+
+const digest_type& transaction_envelope::merkle_digest()const
+{
+   std::call_once( _merkle_digest_flag, [&]()
+   {
+      _merkle_digest = digest_type::hash( _packed.data(), _packed.size() );
+   });
+
+   return _merkle_digest;
+}
+
+const flat_set< public_key_type >& transaction_envelope::signature_keys()const
+{
+   std::call_once( _keys_flag, [&]()
+   {
+      flat_set< public_key_type > keys;
+      for( const auto& sig : _trx.signatures )
+      {
+         SOPHIATX_ASSERT(
+            keys.insert( fc::ecc::public_key::recover_key( sig, _sig_digest, fc::ecc::non_canonical ) ).second,
+            protocol::tx_duplicate_sig,
+            "Duplicate Signature detected" );
+      }
+
+      _keys = std::move( keys );
+      _keys_recovered = true;
+   });
+
+   return _keys;
+}
+
+void transaction_envelope::validate()const
+{
+   std::call_once( _validate_flag, [&]()
+   {
+      try
+      {
+         _trx.validate();
+      }
+      catch( const fc::exception& e )
+      {
+         _validation_error = e.dynamic_copy_exception();
+      }
+
+      _validated = true;
+   });
+
+   if( _validation_error )
+      _validation_error->dynamic_rethrow_exception();
+}
+
+transaction_envelopes make_transaction_envelopes( const signed_block& b, const chain_id_type& chain_id )
+{
+   transaction_envelopes result;
+   result.reserve( b.transactions.size() );
+
+   for( const auto& trx : b.transactions )
+      result.push_back( std::make_shared< transaction_envelope >( trx, chain_id ) );
+
+   return result;
+}
+
+protocol::checksum_type calculate_merkle_root( const transaction_envelopes& envelopes )
+{
+   vector< digest_type > digests;
+   digests.reserve( envelopes.size() );
+
+   for( const auto& e : envelopes )
+      digests.push_back( e->merkle_digest() );
+
+   return signed_block::calculate_merkle_root( std::move( digests ) );
+}
+
+size_t packed_block_size( const signed_block_header& header, const transaction_envelopes& envelopes )
+{
+   size_t size = fc::raw::pack_size( header ) + fc::raw::pack_size( fc::unsigned_int( envelopes.size() ) );
+
+   for( const auto& e : envelopes )
+      size += e->packed_size();
+
+   return size;
+}
+
+} } // sophiatx::chain
@@ -0,0 +1,63 @@
+#include <sophiatx/chain/util/file_io.hpp>
+
+#include <fc/exception/exception.hpp>
+
+#include <cerrno>
+#include <cstring>
+
+#include <unistd.h>
+
+namespace sophiatx { namespace chain { namespace util {
+
+void write_all( int fd, const char* data, size_t size )
+{
+   while( size )
+   {
+      auto written = ::write( fd, data, size );
+      if( written < 0 && errno == EINTR )
+         continue;
+      FC_ASSERT( written > 0, "Error writing file: ${e}", ("e", strerror( errno )) );
+      data += written;
+      size -= written;
+   }
+}
+
+void write_all( int fd, const char* data, size_t size, uint64_t offset )
+{
+   while( size )
+   {
+      auto written = ::pwrite( fd, data, size, offset );
+      if( written < 0 && errno == EINTR )
+         continue;
+      FC_ASSERT( written > 0, "Error writing file: ${e}", ("e", strerror( errno )) );
+      data += written;
+      size -= written;
+      offset += written;
+   }
+}
+
+void read_all( int fd, char* data, size_t size, uint64_t offset )
+{
+   while( size )
+   {
+      auto read = ::pread( fd, data, size, offset );
+      if( read < 0 && errno == EINTR )
+         continue;
+      FC_ASSERT( read > 0, "Error reading file: ${e}", ("e", read < 0 ? strerror( errno ) : "unexpected end of file") );
+      data += read;
+      size -= read;
+      offset += read;
+   }
+}
+
+void sync_data( int fd )
+{
+   int result;
+   do
+   {
+      result = ::fdatasync( fd );
+   } while( result < 0 && errno == EINTR );
+   FC_ASSERT( result == 0, "Error syncing file: ${e}", ("e", strerror( errno )) );
+}
+
+} } } // sophiatx::chain::util
@@ -6,6 +6,7 @@
 #include <boost/interprocess/containers/flat_map.hpp>
 #include <boost/interprocess/containers/deque.hpp>
 #include <boost/interprocess/containers/string.hpp>
+#include <boost/interprocess/containers/vector.hpp>
 #include <boost/interprocess/allocators/allocator.hpp>
 #include <boost/interprocess/sync/interprocess_sharable_mutex.hpp>
 #include <boost/interprocess/sync/sharable_lock.hpp>
@@ -22,6 +23,7 @@
 
 #include <array>
 #include <atomic>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <stdexcept>
@@ -161,6 +163,159 @@ namespace chainbase {
    template<typename Constructor, typename Allocator> \
    OBJECT_TYPE( Constructor&& c, Allocator&&  ) { c(*this); }
 
+   /**
+    *  By default an object is copied into the undo state the first time it is modified in an undo session, which
+    *  deep copies all its dynamically allocated members. Specializing this template for an object type (see
+    *  CHAINBASE_SET_UNDO_DELTA_CODEC) switches its index to delta undo: the object is serialized by the codec
+    *  the first time it is modified in a session and, once a newer session starts, the undo state keeps only the
+    *  byte ranges of the old value which differ from the current one, in a single buffer per object.
+    *
+    *  pack() must serialize all members of the object and unpack() must restore all of them.
+    */
+   template< typename T >
+   struct undo_delta_codec
+   {
+      static const bool enabled = false;
+
+      static void pack( const T& v, std::vector< char >& image ) {}
+      static void unpack( const char* data, size_t size, T& v ) {}
+   };
+
+   /**
+    *  This macro must be used at global scope and OBJECT_TYPE and CODEC_TYPE must be fully qualified. CODEC_TYPE
+    *  provides the static pack() and unpack() methods of undo_delta_codec.
+    */
+   #define CHAINBASE_SET_UNDO_DELTA_CODEC( OBJECT_TYPE, CODEC_TYPE ) \
+   namespace chainbase { template<> struct undo_delta_codec<OBJECT_TYPE> : CODEC_TYPE { static const bool enabled = true; }; }
+
+   namespace undo_delta {
+
+      /*
+       * The undo record of an object is either its full serialized image, used when the image size changed:
+       *
+       * +---+-------------+
+       * | 0 | image bytes |
+       * +---+-------------+
+       *
+       * or the byte ranges in which the old image differs from the current one, everything else is unchanged:
+       *
+       * +---+------------+--------+--------+-----------+--------+--------+-----------+-----+
+       * | 1 | image size | offset | length | old bytes | offset | length | old bytes | ... |
+       * +---+------------+--------+--------+-----------+--------+--------+-----------+-----+
+       *
+       * The head session records full images tagged 2 instead, which are encoded as one of the above when a newer
+       * session starts, so modifying an object again in the same session does not serialize it.
+       */
+      const char full_image    = 0;
+      const char byte_ranges   = 1;
+      const char pending_image = 2;
+
+      /// Differences closer than the size of a range header are merged into a single range
+      const size_t range_header_size = 2 * sizeof( uint32_t );
+
+      /// Per thread buffers for the serialized images, so recording a modification does not allocate
+      inline std::vector< char >& scratch( size_t i )
+      {
+         static thread_local std::vector< char > buffers[3];
+         return buffers[i];
+      }
+
+      inline void append_u32( std::vector< char >& out, uint32_t v )
+      {
+         const char* p = reinterpret_cast< const char* >( &v );
+         out.insert( out.end(), p, p + sizeof( v ) );
+      }
+
+      inline uint32_t read_u32( const char* p )
+      {
+         uint32_t v;
+         std::memcpy( &v, p, sizeof( v ) );
+         return v;
+      }
+
+      /// Encodes old_image as the undo record relative to cur_image
+      inline void encode( const std::vector< char >& old_image, const std::vector< char >& cur_image, std::vector< char >& record )
+      {
+         record.clear();
+
+         if( old_image.size() == cur_image.size() )
+         {
+            const size_t size = old_image.size();
+            record.push_back( byte_ranges );
+            append_u32( record, size );
+
+            size_t pos = 0;
+            while( pos < size && record.size() <= size )
+            {
+               if( old_image[pos] == cur_image[pos] )
+               {
+                  ++pos;
+                  continue;
+               }
+
+               size_t last = pos;
+               for( size_t i = pos + 1; i < size && i - last <= range_header_size; ++i )
+                  if( old_image[i] != cur_image[i] )
+                     last = i;
+
+               append_u32( record, pos );
+               append_u32( record, last + 1 - pos );
+               record.insert( record.end(), old_image.begin() + pos, old_image.begin() + last + 1 );
+               pos = last + 1;
+            }
+
+            if( record.size() <= size )
+               return;
+
+            record.clear();
+         }
+
+         record.push_back( full_image );
+         record.insert( record.end(), old_image.begin(), old_image.end() );
+      }
+
+      /// Full and pending images do not depend on the current value of the object
+      template< typename Record >
+      bool is_full_image( const Record& record )
+      {
+         return record[0] != byte_ranges;
+      }
+
+      template< typename Record >
+      bool is_pending_image( const Record& record )
+      {
+         return record[0] == pending_image;
+      }
+
+      /// Turns the current image into the old image the record was encoded from
+      template< typename Record >
+      void decode( const Record& record, std::vector< char >& image )
+      {
+         const char* pos = record.data();
+         const char* end = pos + record.size();
+
+         if( *pos++ != byte_ranges )
+         {
+            image.assign( pos, end );
+            return;
+         }
+
+         if( read_u32( pos ) != image.size() )
+            BOOST_THROW_EXCEPTION( std::logic_error( "undo record does not match the object" ) );
+         pos += sizeof( uint32_t );
+
+         while( pos < end )
+         {
+            uint32_t offset = read_u32( pos );
+            uint32_t length = read_u32( pos + sizeof( uint32_t ) );
+            pos += range_header_size;
+            std::memcpy( image.data() + offset, pos, length );
+            pos += length;
+         }
+      }
+
+   } // namespace undo_delta
+
    template< typename value_type >
    class undo_state
    {
@@ -168,17 +323,22 @@ namespace chainbase {
          typedef typename value_type::id_type                      id_type;
          typedef allocator< std::pair<const id_type, value_type> > id_value_allocator_type;
          typedef allocator< id_type >                              id_allocator_type;
+         typedef bip::vector< char, allocator< char > >            delta_type;
+         typedef allocator< std::pair<const id_type, delta_type> > id_delta_allocator_type;
 
          template<typename T>
          undo_state( allocator<T> al )
          :old_values( id_value_allocator_type( al.get_segment_manager() ) ),
+          old_deltas( id_delta_allocator_type( al.get_segment_manager() ) ),
           removed_values( id_value_allocator_type( al.get_segment_manager() ) ),
           new_ids( id_allocator_type( al.get_segment_manager() ) ){}
 
          typedef boost::interprocess::map< id_type, value_type, std::less<id_type>, id_value_allocator_type >  id_value_type_map;
+         typedef boost::interprocess::map< id_type, delta_type, std::less<id_type>, id_delta_allocator_type >  id_delta_map;
          typedef boost::interprocess::set< id_type, std::less<id_type>, id_allocator_type >                    id_type_set;
 
          id_value_type_map            old_values;
+         id_delta_map                 old_deltas;   ///< used instead of old_values by types with an undo_delta_codec
          id_value_type_map            removed_values;
          id_type_set                  new_ids;
          id_type                      old_next_id = 0;
@@ -262,6 +422,11 @@ namespace chainbase {
 
          template<typename Modifier>
          void modify( const value_type& obj, Modifier&& m ) {
+            if( undo_delta_codec< value_type >::enabled && enabled() ) {
+               modify_with_delta( obj, m );
+               return;
+            }
+
             on_modify( obj );
             auto ok = _indices.modify( _indices.iterator_to( obj ), m );
             if( !ok ) BOOST_THROW_EXCEPTION( std::logic_error( "Could not modify object, most likely a uniqueness constraint was violated" ) );
@@ -331,6 +496,9 @@ namespace chainbase {
 
          session start_undo_session()
          {
+            if( undo_delta_codec< value_type >::enabled && enabled() )
+               seal_head();
+
             _stack.emplace_back( _indices.get_allocator() );
             _stack.back().old_next_id = _next_id;
             _stack.back().revision = ++_revision;
@@ -357,6 +525,13 @@ namespace chainbase {
                if( !ok ) BOOST_THROW_EXCEPTION( std::logic_error( "Could not modify object, most likely a uniqueness constraint was violated" ) );
             }
 
+            for( auto& item : head.old_deltas ) {
+               auto ok = _indices.modify( _indices.find( item.first ), [&]( value_type& v ) {
+                  restore_from_delta( v, item.second );
+               });
+               if( !ok ) BOOST_THROW_EXCEPTION( std::logic_error( "Could not modify object, most likely a uniqueness constraint was violated" ) );
+            }
+
             for( const auto& id : head.new_ids )
             {
                _indices.erase( _indices.find( id ) );
@@ -449,6 +624,36 @@ namespace chainbase {
                prev_state.old_values.emplace( std::move(item) );
             }
 
+            // The same for delta records, except that upd+upd has to rebase X, which is encoded relative to Y,
+            // onto the current value. The rebased record stays a pending image until the next session starts.
+            for( auto& item : state.old_deltas )
+            {
+               if( prev_state.new_ids.find( item.first ) != prev_state.new_ids.end() )
+                  continue;
+
+               auto prev = prev_state.old_deltas.find( item.first );
+               if( prev != prev_state.old_deltas.end() )
+               {
+                  if( undo_delta::is_full_image( prev->second ) )
+                     continue;
+
+                  auto& old_image = undo_delta::scratch( 0 );
+                  if( undo_delta::is_full_image( item.second ) )
+                     old_image.clear();
+                  else
+                     undo_delta_codec< value_type >::pack( *_indices.find( item.first ), old_image );
+                  undo_delta::decode( item.second, old_image );
+                  undo_delta::decode( prev->second, old_image );
+                  prev->second.resize( 1 );
+                  prev->second[0] = undo_delta::pending_image;
+                  prev->second.insert( prev->second.end(), old_image.begin(), old_image.end() );
+                  continue;
+               }
+
+               assert( prev_state.removed_values.find( item.first ) == prev_state.removed_values.end() );
+               prev_state.old_deltas.emplace( std::move(item) );
+            }
+
             // *+new, but we assume the N/A cases don't happen, leaving type B nop+new -> new
             for( const auto& id : state.new_ids )
                prev_state.new_ids.insert(id);
@@ -462,6 +667,15 @@ namespace chainbase {
                   prev_state.new_ids.erase(obj.second.id);
                   continue;
                }
+               auto delta = prev_state.old_deltas.find(obj.second.id);
+               if( delta != prev_state.old_deltas.end() )
+               {
+                  // upd(was=X) + del(was=Y) -> del(was=X), X is encoded relative to Y
+                  restore_from_delta( obj.second, delta->second );
+                  prev_state.removed_values.emplace( std::move(obj) );
+                  prev_state.old_deltas.erase(delta);
+                  continue;
+               }
                auto it = prev_state.old_values.find(obj.second.id);
                if( it != prev_state.old_values.end() )
                {
@@ -506,9 +720,93 @@ namespace chainbase {
             _revision = revision;
          }
 
+         typename value_type::id_type next_id()const { return _next_id; }
+
+         /**
+          * Sets the id assigned to the next created object, used when objects are restored with their
+          * original ids (e.g. from a state snapshot).
+          */
+         void set_next_id( typename value_type::id_type next_id )
+         {
+            if( _stack.size() != 0 ) BOOST_THROW_EXCEPTION( std::logic_error("cannot set next id while there is an existing undo stack") );
+            _next_id = next_id;
+         }
+
       private:
          bool enabled()const { return _stack.size(); }
 
+         /**
+          * Modifies the object, recording its value before the first modification in the session as a pending image.
+          * Later modifications in the same session find the image and do not serialize the object again.
+          */
+         template<typename Modifier>
+         void modify_with_delta( const value_type& obj, Modifier& m ) {
+            auto& head = _stack.back();
+            auto delta = head.old_deltas.find( obj.id );
+
+            // new objects are not recorded, full images do not depend on the current value
+            if( head.new_ids.find( obj.id ) == head.new_ids.end() &&
+                ( delta == head.old_deltas.end() || !undo_delta::is_full_image( delta->second ) ) ) {
+               auto& old_image = undo_delta::scratch( 0 );
+               undo_delta_codec< value_type >::pack( obj, old_image );
+
+               if( delta == head.old_deltas.end() )
+                  delta = head.old_deltas.emplace( obj.id, typename undo_state_type::delta_type( allocator< char >( _indices.get_allocator() ) ) ).first;
+               else
+                  undo_delta::decode( delta->second, old_image );
+
+               delta->second.resize( 1 );
+               delta->second[0] = undo_delta::pending_image;
+               delta->second.insert( delta->second.end(), old_image.begin(), old_image.end() );
+            }
+
+            auto ok = _indices.modify( _indices.iterator_to( obj ), m );
+            if( !ok ) BOOST_THROW_EXCEPTION( std::logic_error( "Could not modify object, most likely a uniqueness constraint was violated" ) );
+         }
+
+         /**
+          * Encodes the pending images of the head session relative to the current values, which the objects keep
+          * until the session is undone because newer sessions are undone first. Unchanged objects lose their record.
+          */
+         void seal_head() {
+            auto& head = _stack.back();
+            auto& old_image = undo_delta::scratch( 0 );
+            auto& cur_image = undo_delta::scratch( 1 );
+            auto& record = undo_delta::scratch( 2 );
+
+            for( auto itr = head.old_deltas.begin(); itr != head.old_deltas.end(); ) {
+               if( !undo_delta::is_pending_image( itr->second ) ) {
+                  ++itr;
+                  continue;
+               }
+
+               old_image.assign( itr->second.begin() + 1, itr->second.end() );
+               undo_delta_codec< value_type >::pack( *_indices.find( itr->first ), cur_image );
+
+               if( cur_image == old_image ) {
+                  itr = head.old_deltas.erase( itr );
+                  continue;
+               }
+
+               undo_delta::encode( old_image, cur_image, record );
+               itr->second.assign( record.begin(), record.end() );
+               ++itr;
+            }
+         }
+
+         /// Restores the old value of the object from its undo record, which is relative to the object value
+         void restore_from_delta( value_type& v, const typename undo_state_type::delta_type& record ) {
+            if( undo_delta::is_full_image( record ) ) {
+               undo_delta_codec< value_type >::unpack( record.data() + 1, record.size() - 1, v );
+               return;
+            }
+
+            auto& image = undo_delta::scratch( 0 );
+            undo_delta_codec< value_type >::pack( v, image );
+            undo_delta::decode( record, image );
+            undo_delta_codec< value_type >::unpack( image.data(), image.size(), v );
+         }
+
          void on_modify( const value_type& v ) {
             if( !enabled() ) return;
 
@@ -540,6 +838,14 @@ namespace chainbase {
                return;
             }
 
+            auto delta = head.old_deltas.find( v.id );
+            if( delta != head.old_deltas.end() ) {
+               auto removed = head.removed_values.emplace( std::pair< typename value_type::id_type, const value_type& >( v.id, v ) ).first;
+               restore_from_delta( removed->second, delta->second );
+               head.old_deltas.erase( delta );
+               return;
+            }
+
             if( head.removed_values.count( v.id ) )
                return;
 
@@ -736,6 +1042,12 @@ namespace chainbase {
          void flush();
          void wipe( const bfs::path& dir );
          void resize( size_t new_shared_file_size );
+
+         /**
+          * Moves the shared memory file of the open database into dir, replacing the one there. The mapping is
+          * kept, so the registered indexes stay valid.
+          */
+         void move_to( const bfs::path& dir );
          void set_require_locking( bool enable_require_locking );
 
 #ifdef CHAINBASE_CHECK_LOCKING
@@ -120,6 +120,18 @@ namespace chainbase {
       }
    }
 
+   void database::move_to( const bfs::path& dir )
+   {
+      if( !_segment )
+         BOOST_THROW_EXCEPTION( std::runtime_error( "database is not open" ) );
+
+      bfs::create_directories( dir );
+      bfs::remove_all( dir / "shared_memory.meta" );
+      // the mapped file and its lock follow the renamed inode
+      bfs::rename( _data_dir / "shared_memory.bin", dir / "shared_memory.bin" );
+      _data_dir = dir;
+   }
+
    void database::set_require_locking( bool enable_require_locking )
    {
 #ifdef CHAINBASE_CHECK_LOCKING
@@ -136,4 +136,130 @@ BOOST_AUTO_TEST_CASE( open_and_create ) {
    }
 }
 
+struct note : public chainbase::object<1, note> {
+
+   template<typename Constructor, typename Allocator>
+    note(  Constructor&& c, Allocator&& a ) : text( a ) {
+       c(*this);
+    }
+
+    id_type        id;
+    int            score = 0;
+    shared_string  text;
+};
+
+typedef multi_index_container<
+  note,
+  indexed_by<
+     ordered_unique< member<note,note::id_type,&note::id> >,
+     ordered_non_unique< BOOST_MULTI_INDEX_MEMBER(note,int,score) >
+  >,
+  chainbase::allocator<note>
+> note_index;
+
+CHAINBASE_SET_INDEX_TYPE( note, note_index )
+
+struct note_codec {
+   static void pack( const note& n, std::vector< char >& image ) {
+      image.resize( sizeof( n.id._id ) + sizeof( n.score ) );
+      memcpy( image.data(), &n.id._id, sizeof( n.id._id ) );
+      memcpy( image.data() + sizeof( n.id._id ), &n.score, sizeof( n.score ) );
+      image.insert( image.end(), n.text.begin(), n.text.end() );
+   }
+
+   static void unpack( const char* data, size_t size, note& n ) {
+      memcpy( &n.id._id, data, sizeof( n.id._id ) );
+      memcpy( &n.score, data + sizeof( n.id._id ), sizeof( n.score ) );
+      n.text.assign( data + sizeof( n.id._id ) + sizeof( n.score ), data + size );
+   }
+};
+
+CHAINBASE_SET_UNDO_DELTA_CODEC( note, note_codec )
+
+BOOST_AUTO_TEST_CASE( delta_undo ) {
+   boost::filesystem::path temp = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+   try {
+      chainbase::database db;
+      db.open( temp, 0, 1024*1024*8 );
+      db.add_index< note_index >();
+
+      const auto& n1 = db.create<note>( []( note& n ) {
+         n.score = 1;
+         n.text = "the quick brown fox jumps over the lazy dog";
+      } );
+      const auto& n2 = db.create<note>( []( note& n ) {
+         n.score = 2;
+         n.text = "lorem ipsum";
+      } );
+
+      BOOST_TEST_MESSAGE( "Undoing modifications of the same size and of a different size" );
+      {
+         auto session = db.start_undo_session();
+         db.modify( n1, []( note& n ) { n.text[4] = 'Q'; } );
+         db.modify( n1, []( note& n ) { n.score = 10; n.text[40] = 'D'; } );
+         db.modify( n2, []( note& n ) { n.text = "lorem ipsum dolor sit amet"; } );
+         db.modify( n2, []( note& n ) { n.score = 20; } );
+         BOOST_REQUIRE_EQUAL( n1.score, 10 );
+         BOOST_REQUIRE_EQUAL( std::string( n1.text.c_str() ), "the Quick brown fox jumps over the lazy Dog" );
+      }
+      BOOST_REQUIRE_EQUAL( n1.score, 1 );
+      BOOST_REQUIRE_EQUAL( std::string( n1.text.c_str() ), "the quick brown fox jumps over the lazy dog" );
+      BOOST_REQUIRE_EQUAL( n2.score, 2 );
+      BOOST_REQUIRE_EQUAL( std::string( n2.text.c_str() ), "lorem ipsum" );
+
+      BOOST_TEST_MESSAGE( "Undoing squashed sessions" );
+      {
+         auto outer = db.start_undo_session();
+         db.modify( n1, []( note& n ) { n.text[0] = 'T'; } );
+         db.modify( n2, []( note& n ) { n.text[0] = 'L'; } );
+         {
+            auto inner = db.start_undo_session();
+            db.modify( n1, []( note& n ) { n.text[42] = 'G'; n.score = 3; } );
+            db.remove( n2 );
+            inner.squash();
+         }
+         BOOST_REQUIRE_EQUAL( std::string( n1.text.c_str() ), "The quick brown fox jumps over the lazy doG" );
+         BOOST_CHECK( db.find< note >( note::id_type( 1 ) ) == nullptr );
+      }
+      BOOST_REQUIRE_EQUAL( n1.score, 1 );
+      BOOST_REQUIRE_EQUAL( std::string( n1.text.c_str() ), "the quick brown fox jumps over the lazy dog" );
+      const auto& restored = db.get< note >( note::id_type( 1 ) );
+      BOOST_REQUIRE_EQUAL( restored.score, 2 );
+      BOOST_REQUIRE_EQUAL( std::string( restored.text.c_str() ), "lorem ipsum" );
+
+      BOOST_TEST_MESSAGE( "Undoing nested sessions" );
+      {
+         auto outer = db.start_undo_session();
+         db.modify( n1, []( note& n ) { n.text[4] = 'Q'; } );
+         db.modify( n1, []( note& n ) { n.score = 7; } );
+         db.modify( restored, []( note& n ) { n.score = 2; } );
+         {
+            auto inner = db.start_undo_session();
+            db.modify( n1, []( note& n ) { n.text = "jumps over"; } );
+            db.modify( restored, []( note& n ) { n.text[0] = 'L'; } );
+            BOOST_REQUIRE_EQUAL( std::string( n1.text.c_str() ), "jumps over" );
+         }
+         BOOST_REQUIRE_EQUAL( n1.score, 7 );
+         BOOST_REQUIRE_EQUAL( std::string( n1.text.c_str() ), "the Quick brown fox jumps over the lazy dog" );
+         BOOST_REQUIRE_EQUAL( std::string( restored.text.c_str() ), "lorem ipsum" );
+      }
+      BOOST_REQUIRE_EQUAL( n1.score, 1 );
+      BOOST_REQUIRE_EQUAL( std::string( n1.text.c_str() ), "the quick brown fox jumps over the lazy dog" );
+      BOOST_REQUIRE_EQUAL( restored.score, 2 );
+
+      BOOST_TEST_MESSAGE( "Keeping pushed sessions" );
+      {
+         auto session = db.start_undo_session();
+         db.modify( n1, []( note& n ) { n.score = 5; } );
+         session.push();
+      }
+      db.commit( db.revision() );
+      BOOST_REQUIRE_EQUAL( n1.score, 5 );
+   } catch ( ... ) {
+      bfs::remove_all( temp );
+      throw;
+   }
+   bfs::remove_all( temp );
+}
+
 // BOOST_AUTO_TEST_SUITE_END()
@@ -6,5 +6,9 @@ namespace fc
 {
 
   string zlib_compress(const string& in);
+  string zlib_compress(const char* in, size_t size);
+
+  /** inflates zlib compressed data into out, which has to be exactly the size of the original data */
+  void zlib_decompress(const char* in, size_t size, char* out, size_t out_size);
 
 } // namespace fc
@@ -143,6 +143,22 @@ namespace fc {
          for( auto& item : value )
              fc::raw::unpack( s, item, depth );
        }
+
+       template<typename Stream, typename T, typename... A>
+       inline void pack( Stream& s, const bip::deque<T,A...>& value ) {
+         pack( s, unsigned_int((uint32_t)value.size()) );
+         for( const auto& item : value )
+           fc::raw::pack( s, item );
+       }
+       template<typename Stream, typename T, typename... A>
+       inline void unpack( Stream& s, bip::deque<T,A...>& value, uint32_t depth = 0 ) {
+         FC_ASSERT( depth++ <= MAX_RECURSION_DEPTH );
+         unsigned_int size;
+         unpack( s, size, depth );
+         value.clear(); value.resize(size);
+         for( auto& item : value )
+             fc::raw::unpack( s, item, depth );
+       }
    }
 
 template< typename E, typename Allocator >
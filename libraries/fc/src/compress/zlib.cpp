@@ -1,15 +1,29 @@
 #include <fc/compress/zlib.hpp>
+#include <fc/exception/exception.hpp>
 
 #include "miniz.c"
 
 namespace fc
 {
   string zlib_compress(const string& in)
+  {
+    return zlib_compress(in.c_str(), in.size());
+  }
+
+  string zlib_compress(const char* in, size_t size)
   {
     size_t compressed_message_length;
-    char* compressed_message = (char*)tdefl_compress_mem_to_heap(in.c_str(), in.size(), &compressed_message_length,  TDEFL_WRITE_ZLIB_HEADER | TDEFL_DEFAULT_MAX_PROBES);
+    char* compressed_message = (char*)tdefl_compress_mem_to_heap(in, size, &compressed_message_length,  TDEFL_WRITE_ZLIB_HEADER | TDEFL_DEFAULT_MAX_PROBES);
+    FC_ASSERT( compressed_message, "zlib compression failed" );
     string result(compressed_message, compressed_message_length);
     free(compressed_message);
     return result;
   }
+
+  void zlib_decompress(const char* in, size_t size, char* out, size_t out_size)
+  {
+    size_t decompressed_length = tinfl_decompress_mem_to_mem(out, out_size, in, size, TINFL_FLAG_PARSE_ZLIB_HEADER);
+    FC_ASSERT( decompressed_length == out_size, "zlib decompression failed",
+               ("expected", out_size)("decompressed", decompressed_length) );
+  }
 }
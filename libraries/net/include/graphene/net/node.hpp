@@ -265,6 +265,8 @@ namespace graphene { namespace net {
         {
            broadcast( trx_message(trx) );
         }
+        /** Broadcasts the transactions with a single call into the p2p thread */
+        virtual void  broadcast_transactions( const std::vector<signed_transaction>& trxs );
 
         /**
          *  Node starts the process of fetching all items after item_id of the
@@ -312,6 +314,7 @@ namespace graphene { namespace net {
 
       void      sync_from(const item_id& current_head_block, const std::vector<uint32_t>& hard_fork_block_numbers) override {}
       void      broadcast(const message& item_to_broadcast) override;
+      void      broadcast_transactions(const std::vector<signed_transaction>& trxs) override;
       void      add_node_delegate(node_delegate* node_delegate_to_add);
 
       virtual uint32_t get_connection_count() const override { return 8; }
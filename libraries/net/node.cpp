@@ -689,6 +689,7 @@ namespace graphene { namespace net {
 
       void broadcast(const message& item_to_broadcast, const message_propagation_data& propagation_data);
       void broadcast(const message& item_to_broadcast);
+      void broadcast_transactions(const std::vector<signed_transaction>& trxs);
       void sync_from(const item_id& current_head_block, const std::vector<uint32_t>& hard_fork_block_numbers);
       bool is_connected() const;
       std::vector<potential_peer_record> get_potential_peers() const;
@@ -4973,6 +4974,14 @@ namespace graphene { namespace net {
       broadcast( item_to_broadcast, propagation_data );
     }
 
+    void node_impl::broadcast_transactions( const std::vector<signed_transaction>& trxs )
+    {
+      VERIFY_CORRECT_THREAD();
+      message_propagation_data propagation_data{fc::time_point::now(), fc::time_point::now(), _node_id};
+      for( const signed_transaction& trx : trxs )
+        broadcast( trx_message( trx ), propagation_data );
+    }
+
     void node_impl::sync_from(const item_id& current_head_block, const std::vector<uint32_t>& hard_fork_block_numbers)
     {
       VERIFY_CORRECT_THREAD();
@@ -5227,6 +5236,11 @@ namespace graphene { namespace net {
     INVOKE_IN_IMPL(broadcast, msg);
   }
 
+  void node::broadcast_transactions( const std::vector<signed_transaction>& trxs )
+  {
+    INVOKE_IN_IMPL(broadcast_transactions, trxs);
+  }
+
   void node::sync_from(const item_id& current_head_block, const std::vector<uint32_t>& hard_fork_block_numbers)
   {
     INVOKE_IN_IMPL(sync_from, current_head_block, hard_fork_block_numbers);
@@ -5355,6 +5369,12 @@ namespace graphene { namespace net {
     }
   }
 
+  void simulated_network::broadcast_transactions( const std::vector<signed_transaction>& trxs )
+  {
+    for( const signed_transaction& trx : trxs )
+      broadcast( trx_message( trx ) );
+  }
+
   void simulated_network::add_node_delegate( node_delegate* node_delegate_to_add )
   {
     network_nodes.push_back(new node_info(node_delegate_to_add));
@@ -41,10 +41,8 @@ DEFINE_API_IMPL( account_history_api_impl, get_ops_in_block )
 
 DEFINE_API_IMPL( account_history_api_impl, get_transaction )
 {
-#ifdef SKIP_BY_TX_ID
-   FC_ASSERT( false, "This node's operator has disabled operation indexing by transaction_id" );
-#else
    FC_ASSERT( args.id != sophiatx::protocol::transaction_id_type(), "Invalid id parameter" );
+#ifndef SKIP_BY_TX_ID
    const auto& idx = _db->get_index< chain::operation_index, chain::by_transaction_id >();
    auto itr = idx.lower_bound( args.id );
    if( itr != idx.end() && itr->trx_id == args.id )
@@ -57,8 +55,11 @@ DEFINE_API_IMPL( account_history_api_impl, get_transaction )
       result.transaction_num = itr->trx_in_block;
       return result;
    }
-   FC_ASSERT( false, "Unknown Transaction ${t}", ("t",args.id) );
 #endif
+   // transactions not in the operation index, e.g. filtered out by the account history plugin, may be in the block log index
+   auto trx = _db->fetch_transaction_from_block_log( args.id );
+   FC_ASSERT( trx.valid(), "Unknown Transaction ${t}", ("t",args.id) );
+   return *trx;
 }
 
 DEFINE_API_IMPL( account_history_api_impl, get_account_history )
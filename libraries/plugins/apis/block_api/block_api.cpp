@@ -5,6 +5,8 @@
 
 #include <sophiatx/protocol/get_config.hpp>
 
+#include <sophiatx/chain/block_stats_object.hpp>
+
 namespace sophiatx { namespace plugins { namespace block_api {
 
 class block_api_impl
@@ -16,7 +18,9 @@ class block_api_impl
       DECLARE_API_IMPL(
          (get_block_header)
          (get_block)
+         (get_transaction)
          (get_average_block_size)
+         (get_block_stats)
       )
 
    appbase::application* _app;
@@ -73,20 +77,65 @@ DEFINE_API_IMPL( block_api_impl, get_block )
    return result;
 }
 
+DEFINE_API_IMPL( block_api_impl, get_transaction )
+{
+   FC_ASSERT( args.id != sophiatx::protocol::transaction_id_type(), "Invalid id parameter" );
+   auto trx = _db->fetch_transaction_from_block_log( args.id );
+   FC_ASSERT( trx.valid(), "Unknown Transaction ${t}. Transactions are only found when block-log-transaction-index is enabled and they are irreversible.", ("t", args.id) );
+   return *trx;
+}
+
 DEFINE_API_IMPL( block_api_impl, get_average_block_size )
 {
-   int64_t start = _db->head_block_num();
-   int64_t stop = start > 1000? start - 1000 : 0;
-   uint64_t total_size = 0;
-   for( int64_t i = start; i > stop; i-- )
-      total_size += fc::raw::pack_size( _db->fetch_block_by_number( i ) );
-   return total_size / (start - stop );
+   const auto& window = _db->get< chain::block_stats_window_object >();
+   return window.blocks ? window.total_size / window.blocks : 0;
+}
+
+DEFINE_API_IMPL( block_api_impl, get_block_stats )
+{
+   get_block_stats_return result;
+   const auto& window = _db->get< chain::block_stats_window_object >();
+
+   if( args.blocks == 0 || args.blocks >= window.blocks )
+   {
+      result.blocks = window.blocks;
+      result.total_size = window.total_size;
+      result.total_transactions = window.total_transactions;
+      result.total_operations = window.total_operations;
+   }
+   else
+   {
+      // a shorter window is summed from the ring, which is still in memory
+      uint32_t head = _db->head_block_num();
+      for( uint32_t block_num = head; block_num > head - args.blocks; block_num-- )
+      {
+         const auto& stats = _db->get< chain::block_stats_object >( chain::block_stats_id_type( block_num % SOPHIATX_BLOCK_STATS_WINDOW ) );
+         if( stats.block_num != block_num )
+            break;
+
+         result.blocks++;
+         result.total_size += stats.block_size;
+         result.total_transactions += stats.transactions;
+         result.total_operations += stats.operations;
+      }
+   }
+
+   if( result.blocks )
+   {
+      result.average_block_size = result.total_size / result.blocks;
+      result.average_transactions = double( result.total_transactions ) / result.blocks;
+      result.average_operations = double( result.total_operations ) / result.blocks;
+   }
+
+   return result;
 }
 
 DEFINE_READ_APIS( block_api,
    (get_block_header)
    (get_block)
+   (get_transaction)
    (get_average_block_size)
+   (get_block_stats)
 )
 
 } } } // sophiatx::plugins::block_api
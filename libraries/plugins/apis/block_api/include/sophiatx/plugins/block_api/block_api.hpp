@@ -38,9 +38,23 @@ class block_api
          (get_block)
 
          /**
-          * @brief Retrieve average size of last 1000 blocks
+         * @brief Retrieve an irreversible transaction through the block log transaction index
+         * @param id Id of the transaction
+         * @return the transaction with the number of its block and its position in the block
+         */
+         (get_transaction)
+
+         /**
+          * @brief Retrieve average size of last SOPHIATX_BLOCK_STATS_WINDOW (1000) blocks
           */
          (get_average_block_size)
+
+         /**
+          * @brief Retrieve sizes, transaction and operation counts of recent blocks
+          * @param blocks Number of most recent blocks, up to SOPHIATX_BLOCK_STATS_WINDOW, 0 for the whole window
+          * @return totals and averages over the blocks
+          */
+         (get_block_stats)
       )
 
    private:
@@ -36,6 +36,31 @@ typedef json_rpc::void_type get_average_block_size_args;
 
 typedef uint32_t get_average_block_size_return;
 
+/* get_transaction */
+struct get_transaction_args
+{
+   sophiatx::protocol::transaction_id_type id;
+};
+
+typedef sophiatx::protocol::annotated_signed_transaction get_transaction_return;
+
+/* get_block_stats */
+struct get_block_stats_args
+{
+   uint32_t blocks = 0;    ///< number of most recent blocks, 0 or more than SOPHIATX_BLOCK_STATS_WINDOW means the whole window
+};
+
+struct get_block_stats_return
+{
+   uint32_t blocks = 0;    ///< number of blocks the stats are computed over
+   uint64_t total_size = 0;
+   uint64_t total_transactions = 0;
+   uint64_t total_operations = 0;
+   uint32_t average_block_size = 0;
+   double   average_transactions = 0;
+   double   average_operations = 0;
+};
+
 
 } } } // sophiatx::block_api
 
@@ -51,3 +76,12 @@ FC_REFLECT( sophiatx::plugins::block_api::get_block_args,
 FC_REFLECT( sophiatx::plugins::block_api::get_block_return,
    (block) )
 
+FC_REFLECT( sophiatx::plugins::block_api::get_transaction_args,
+   (id) )
+
+FC_REFLECT( sophiatx::plugins::block_api::get_block_stats_args,
+   (blocks) )
+
+FC_REFLECT( sophiatx::plugins::block_api::get_block_stats_return,
+   (blocks)(total_size)(total_transactions)(total_operations)(average_block_size)(average_transactions)(average_operations) )
+
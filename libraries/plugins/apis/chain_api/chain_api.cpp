@@ -12,7 +12,11 @@ public:
 
       DECLARE_API_IMPL(
          (push_block)
-         (push_transaction) )
+         (push_transaction)
+         (get_write_queue_stats)
+         (get_block_log_append_metrics)
+         (get_block_cache_stats)
+         (get_remote_connection_stats) )
 
    appbase::application* _app;
 private:
@@ -73,6 +77,26 @@ DEFINE_API_IMPL( chain_api_impl, push_transaction )
    return result;
 }
 
+DEFINE_API_IMPL( chain_api_impl, get_write_queue_stats )
+{
+   return _chain.get_write_queue_stats();
+}
+
+DEFINE_API_IMPL( chain_api_impl, get_block_log_append_metrics )
+{
+   return _chain.get_block_log_append_metrics();
+}
+
+DEFINE_API_IMPL( chain_api_impl, get_block_cache_stats )
+{
+   return _chain.get_block_cache_stats();
+}
+
+DEFINE_API_IMPL( chain_api_impl, get_remote_connection_stats )
+{
+   return _chain.get_remote_connection_stats();
+}
+
 } // detail
 
 chain_api::chain_api(chain_api_plugin& plugin): my( new detail::chain_api_impl(plugin) )
@@ -88,6 +112,10 @@ chain_api::~chain_api()
 DEFINE_LOCKLESS_APIS( chain_api,
    (push_block)
    (push_transaction)
+   (get_write_queue_stats)
+   (get_block_log_append_metrics)
+   (get_block_cache_stats)
+   (get_remote_connection_stats)
 )
 
 } } } //sophiatx::plugins::chain
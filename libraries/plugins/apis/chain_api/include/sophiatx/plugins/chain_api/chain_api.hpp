@@ -1,5 +1,6 @@
 #pragma once
 #include <sophiatx/plugins/json_rpc/utility.hpp>
+#include <sophiatx/plugins/chain/chain_plugin.hpp>
 
 #include <sophiatx/protocol/types.hpp>
 
@@ -30,6 +31,18 @@ struct push_transaction_return
    optional<string>  error;
 };
 
+typedef json_rpc::void_type get_write_queue_stats_args;
+typedef write_queue_stats get_write_queue_stats_return;
+
+typedef json_rpc::void_type get_block_log_append_metrics_args;
+typedef block_log_append_metrics get_block_log_append_metrics_return;
+
+typedef json_rpc::void_type get_block_cache_stats_args;
+typedef block_cache_stats get_block_cache_stats_return;
+
+typedef json_rpc::void_type get_remote_connection_stats_args;
+typedef std::vector< remote::remote_connection_stats > get_remote_connection_stats_return;
+
 class chain_api_plugin;
 
 class chain_api
@@ -40,7 +53,27 @@ class chain_api
 
       DECLARE_API(
          (push_block)
-         (push_transaction) )
+         (push_transaction)
+
+         /**
+          * @brief Returns the number of requests processed by the write thread and the time they waited in its queue
+          */
+         (get_write_queue_stats)
+
+         /**
+          * @brief Returns the queue depth and the sync latency of the block log writer
+          */
+         (get_block_log_append_metrics)
+
+         /**
+          * @brief Returns the hits, the misses and the size of the cache of irreversible blocks
+          */
+         (get_block_cache_stats)
+
+         /**
+          * @brief Returns the state and the call latency of the connections of a lite node to the full node
+          */
+         (get_remote_connection_stats) )
       
    private:
       std::unique_ptr< detail::chain_api_impl > my;
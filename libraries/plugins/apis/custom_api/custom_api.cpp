@@ -18,6 +18,12 @@ public:
          (get_app_custom_messages)
    )
 
+   /** Resolves the payload of the received document, which may be read from the custom content archive */
+   received_object received( const chain::custom_content_object& obj )const
+   {
+      return received_object( obj, _db->get_custom_content_payload( _db->get( obj.payload ) ) );
+   }
+
    std::shared_ptr<chain::database_interface>  _db;
    appbase::application* _app;
 };
@@ -27,7 +33,8 @@ DEFINE_API_IMPL( custom_api_impl, get_received_document )
 {
    const auto& idx = _db->get_index< chain::custom_content_index, chain::by_id >();
    auto res = idx.find(args.id);
-   return *res;
+   FC_ASSERT( res != idx.end(), "Document ${id} not found", ("id", args.id) );
+   return received( *res );
 }
 
 DEFINE_API_IMPL( custom_api_impl, get_app_custom_messages)
@@ -44,7 +51,7 @@ DEFINE_API_IMPL( custom_api_impl, get_app_custom_messages)
 
    while( itr != end && result.size() < args.limit )
    {
-      result[ itr->app_message_sequence ] = *itr;
+      result[ itr->app_message_sequence ] = received( *itr );
       ++itr;
    }
    return result;
@@ -64,7 +71,7 @@ DEFINE_API_IMPL( custom_api_impl, list_received_documents )
       list_received_documents_return result; result.clear();
       while( itr != end && result.size() < args.count )
       {
-         result[ itr->sender_sequence ] = *itr;
+         result[ itr->sender_sequence ] = received( *itr );
          ++itr;
       }
       return result;
@@ -78,7 +85,7 @@ DEFINE_API_IMPL( custom_api_impl, list_received_documents )
       list_received_documents_return result; result.clear();
       while( itr != end && result.size() < args.count)
       {
-         result[ itr->recipient_sequence ] = *itr;
+         result[ itr->recipient_sequence ] = received( *itr );
          ++itr;
       }
 
@@ -92,7 +99,7 @@ DEFINE_API_IMPL( custom_api_impl, list_received_documents )
       list_received_documents_return result; result.clear();
       while( itr != end && result.size() < args.count)
       {
-         result[ itr->sender_sequence ] = *itr;
+         result[ itr->sender_sequence ] = received( *itr );
          ++itr;
       }
 
@@ -106,7 +113,7 @@ DEFINE_API_IMPL( custom_api_impl, list_received_documents )
       list_received_documents_return result; result.clear();
       while( itr != end && result.size() < args.count)
       {
-         result[ itr->recipient_sequence ] = *itr;
+         result[ itr->recipient_sequence ] = received( *itr );
          ++itr;
       }
 
@@ -123,7 +130,7 @@ DEFINE_API_IMPL( custom_api_impl, list_received_documents )
       while( itr != end && result.size() < args.count )
       {
          --itr;
-         result[ itr->sender_sequence ] = *itr;
+         result[ itr->sender_sequence ] = received( *itr );
       }
       return result;
    }else if(args.search_type == "by_recipient_reverse"){
@@ -137,7 +144,7 @@ DEFINE_API_IMPL( custom_api_impl, list_received_documents )
       while( itr != end && result.size() < args.count)
       {
          --itr;
-         result[ itr->recipient_sequence ] = *itr;
+         result[ itr->recipient_sequence ] = received( *itr );
       }
 
       return result;
@@ -151,7 +158,7 @@ DEFINE_API_IMPL( custom_api_impl, list_received_documents )
       while( itr != end && result.size() < args.count)
       {
          --itr;
-         result[ itr->sender_sequence ] = *itr;
+         result[ itr->sender_sequence ] = received( *itr );
       }
 
       return result;
@@ -165,7 +172,7 @@ DEFINE_API_IMPL( custom_api_impl, list_received_documents )
       result.clear();
       while( itr != end && result.size() < args.count ) {
          --itr;
-         result[ itr->recipient_sequence ] = *itr;
+         result[ itr->recipient_sequence ] = received( *itr );
       }
       return result;
    }else{
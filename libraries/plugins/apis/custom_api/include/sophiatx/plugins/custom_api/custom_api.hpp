@@ -20,18 +20,18 @@ namespace detail { class custom_api_impl; }
 struct received_object
 {
    received_object() {};
-   received_object( const sophiatx::chain::custom_content_object& obj ) :
+   received_object( const sophiatx::chain::custom_content_object& obj, const sophiatx::chain::custom_content_payload& payload ) :
          id(obj.id._id),
          sender( obj.sender ),
          app_id( obj.app_id ),
-         binary( obj.binary ),
+         binary( payload.binary ),
          received( obj.received)
    {
       if(binary)
-         data = fc::base64_encode(obj.data.data(), obj.data.size());
+         data = fc::base64_encode(payload.data.data(), payload.data.size());
       else
-         data = chain::to_string(obj.json);
-      for(auto r: obj.all_recipients)
+         data = payload.json;
+      for(auto r: payload.all_recipients)
          recipients.push_back(r);
    }
 
@@ -44,6 +44,24 @@ struct broadcast_transaction_synchronous_return
    bool                  expired   = false;
 };
 
+struct broadcast_transactions_args
+{
+   vector< signed_transaction >  trxs;
+   int32_t                       max_block_age = -1;
+};
+
+struct broadcast_transaction_result
+{
+   transaction_id_type   id;
+   bool                  success = false;
+   optional< string >    error;
+};
+
+struct broadcast_transactions_return
+{
+   vector< broadcast_transaction_result > results;      ///< in the order of the submitted transactions
+};
+
 struct broadcast_block_args
 {
    signed_block   block;
@@ -66,6 +84,13 @@ class network_broadcast_api
       DECLARE_API(
          (broadcast_transaction)
          (broadcast_transaction_synchronous)
+
+         /**
+          * @brief Applies the transactions in a single write lock pass and broadcasts the accepted ones
+          * @param trxs transactions, at most SOPHIATX_MAX_BROADCAST_BATCH_SIZE
+          * @return result of each transaction, a failed transaction does not affect the others
+          */
+         (broadcast_transactions)
          (broadcast_block)
       )
 
@@ -78,6 +103,15 @@ class network_broadcast_api
 FC_REFLECT( sophiatx::plugins::network_broadcast_api::broadcast_transaction_args,
    (trx)(max_block_age) )
 
+FC_REFLECT( sophiatx::plugins::network_broadcast_api::broadcast_transactions_args,
+   (trxs)(max_block_age) )
+
+FC_REFLECT( sophiatx::plugins::network_broadcast_api::broadcast_transaction_result,
+   (id)(success)(error) )
+
+FC_REFLECT( sophiatx::plugins::network_broadcast_api::broadcast_transactions_return,
+   (results) )
+
 FC_REFLECT( sophiatx::plugins::network_broadcast_api::broadcast_block_args,
    (block) )
 
@@ -26,6 +26,7 @@ namespace detail
          DECLARE_API_IMPL(
             (broadcast_transaction)
             (broadcast_transaction_synchronous)
+            (broadcast_transactions)
             (broadcast_block)
          )
 
@@ -112,6 +113,57 @@ namespace detail
       return p.get_future().get();
    }
 
+   DEFINE_API_IMPL( network_broadcast_api_impl, broadcast_transactions )
+   {
+      FC_ASSERT( !check_max_block_age( args.max_block_age ) );
+      FC_ASSERT( args.trxs.size() <= SOPHIATX_MAX_BROADCAST_BATCH_SIZE,
+                 "Too many transactions in a batch, the limit is ${l}", ("l", SOPHIATX_MAX_BROADCAST_BATCH_SIZE) );
+
+      broadcast_transactions_return result;
+      result.results.resize( args.trxs.size() );
+
+      vector< signed_transaction > trxs;
+      vector< size_t > positions;
+      trxs.reserve( args.trxs.size() );
+
+      for( size_t i = 0; i < args.trxs.size(); ++i )
+      {
+         result.results[i].id = args.trxs[i].id();
+
+         if( fc::raw::pack_size( args.trxs[i] ) > SOPHIATX_MAX_TRANSACTION_SIZE )
+         {
+            result.results[i].error = "Transaction size is bigger than SOPHIATX_MAX_TRANSACTION_SIZE";
+            continue;
+         }
+
+         trxs.push_back( args.trxs[i] );
+         positions.push_back( i );
+      }
+
+      auto errors = _chain.accept_transactions( trxs );
+
+      vector< signed_transaction > accepted;
+      accepted.reserve( trxs.size() );
+
+      for( size_t i = 0; i < trxs.size(); ++i )
+      {
+         auto& r = result.results[ positions[i] ];
+         if( errors[i] )
+         {
+            r.error = errors[i]->to_detail_string();
+            continue;
+         }
+
+         r.success = true;
+         accepted.push_back( std::move( trxs[i] ) );
+      }
+
+      if( accepted.size() )
+         _p2p.broadcast_transactions( accepted );
+
+      return result;
+   }
+
    DEFINE_API_IMPL( network_broadcast_api_impl, broadcast_block )
    {
       FC_ASSERT( fc::raw::pack_size(args.block) <= SOPHIATX_MAX_BLOCK_SIZE, "Block size is bigger than SOPHIATX_MAX_BLOCK_SIZE" );
@@ -195,6 +247,7 @@ network_broadcast_api::~network_broadcast_api()
 DEFINE_LOCKLESS_APIS( network_broadcast_api,
    (broadcast_transaction)
    (broadcast_transaction_synchronous)
+   (broadcast_transactions)
    (broadcast_block)
 )
 
@@ -20,12 +20,44 @@ struct custom_object_subscription_args{
    uint64_t return_id;
    uint32_t app_id;
    string   account_name;
-   string   search_type;
+   string   search_type; //"by_sender", "by_recipient", "by_app" (all messages of the app, account_name is ignored)
    uint64_t start;
+   bool     packed = false; //documents are pushed as packed_custom_document instead of pairs of sequence and received_object
+};
+
+/**
+ * Document pushed to subscriptions made with packed set, serialized with fc::raw and pushed as a base64 string. The
+ * whole document is encoded once instead of building a JSON received_object with base64 binary data, which saves work
+ * on the full node and on the lite nodes replicating app messages. Read by remote_db as remote::packed_received_object.
+ */
+struct packed_custom_document{
+   uint64_t       sequence = 0;   ///< sequence of the subscription search type
+   uint64_t       id = 0;
+   string         sender;
+   vector<string> recipients;
+   uint64_t       app_id = 0;
+   bool           binary = false;
+   vector<char>   data;           ///< content of binary documents
+   string         json;           ///< content of json documents
+   time_point_sec received;
+};
+
+struct custom_object_subscription_stats{
+   uint64_t return_id = 0;
+   uint64_t app_id = 0;
+   string   account_name;
+   string   search_type;
+   uint64_t position = 0;     ///< sequence of the last queued document
+   uint32_t queued = 0;       ///< documents waiting to be sent
+   uint64_t delivered = 0;
+   uint64_t lags = 0;         ///< number of times documents were held back by a full send queue
+   bool     lagging = false;
 };
 
 
 typedef uint64_t custom_object_subscription_return;
+typedef void_type get_subscription_stats_args;
+typedef vector< custom_object_subscription_stats > get_subscription_stats_return;
 class subscribe_api_plugin;
 
 class subscribe_api
@@ -37,6 +69,7 @@ public:
 
    DECLARE_API(
    (custom_object_subscription)
+   (get_subscription_stats)
    )
 
 private:
@@ -45,4 +78,6 @@ private:
 
 } } } // sophiatx::plugins::subscribe
 
-FC_REFLECT(sophiatx::plugins::subscribe::custom_object_subscription_args, (return_id)(app_id)(account_name)(search_type)(start))
+FC_REFLECT(sophiatx::plugins::subscribe::custom_object_subscription_args, (return_id)(app_id)(account_name)(search_type)(start)(packed))
+FC_REFLECT(sophiatx::plugins::subscribe::packed_custom_document, (sequence)(id)(sender)(recipients)(app_id)(binary)(data)(json)(received))
+FC_REFLECT(sophiatx::plugins::subscribe::custom_object_subscription_stats, (return_id)(app_id)(account_name)(search_type)(position)(queued)(delivered)(lags)(lagging))
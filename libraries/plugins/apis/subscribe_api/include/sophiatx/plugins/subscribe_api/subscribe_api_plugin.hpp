@@ -31,6 +31,7 @@ public:
    virtual void plugin_shutdown() override;
 
    std::shared_ptr< class subscribe_api > api;
+   uint32_t send_queue_size = 1000;      ///< documents queued for a single subscriber
 };
 
 } } } // sophiatx::plugins::subscribe
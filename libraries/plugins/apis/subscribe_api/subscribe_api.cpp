@@ -5,117 +5,405 @@
 #include <sophiatx/plugins/custom_api/custom_api_plugin.hpp>
 #include <sophiatx/plugins/custom_api/custom_api.hpp>
 
+#include <sophiatx/chain/util/signal.hpp>
+
+#include <fc/crypto/base64.hpp>
+#include <fc/io/raw.hpp>
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <tuple>
+
 
 namespace sophiatx { namespace plugins { namespace subscribe {
 
 namespace detail {
 
-struct custom_content_callback;
+/**
+ * Subscription to the documents of an app sent by or to an account, or to all messages of an app. Documents are
+ * queued as pairs of their sequence and the received document, or as packed_custom_document for packed subscriptions,
+ * in the order of the sequence, and sent by the delivery thread.
+ */
+struct custom_content_subscriber
+{
+   enum subscription_type
+   {
+      sender_subscription,
+      recipient_subscription,
+      app_subscription
+   };
+
+   uint64_t                                        return_id = 0;
+   uint64_t                                        app_id = 0;
+   chain::account_name_type                        account;             ///< empty for app_subscription
+   uint8_t                                         type = sender_subscription;
+   bool                                            packed = false;
+   std::function< void( fc::variant&, uint64_t ) > notify;
+
+   uint64_t                                        position = 0;        ///< sequence of the last queued document
+   std::deque< fc::variant >                       queue;               ///< documents waiting for the delivery thread
+   bool                                            scheduled = false;   ///< queued documents are checked at the end of the block
+   bool                                            ready = false;       ///< waiting for the delivery thread
+   bool                                            lagging = false;     ///< documents after position were held back by a full queue
+   bool                                            invalid = false;     ///< sending failed, the subscriber is removed
+
+   uint64_t                                        delivered = 0;
+   uint64_t                                        lags = 0;            ///< number of times documents were held back by a full queue
+};
 
+typedef std::shared_ptr< custom_content_subscriber > custom_content_subscriber_ptr;
+
+/// app id, account and subscription type
+typedef std::tuple< uint64_t, chain::account_name_type, uint8_t > subscription_key;
+
+static const std::map< string, uint8_t > subscription_types = {
+   { "by_sender", custom_content_subscriber::sender_subscription },
+   { "by_recipient", custom_content_subscriber::recipient_subscription },
+   { "by_app", custom_content_subscriber::app_subscription }
+};
 
 class subscribe_api_impl
 {
 public:
    subscribe_api_impl(subscribe_api_plugin& plugin) : _db( plugin.app()->get_plugin< sophiatx::plugins::chain::chain_plugin >().db() ),
-                                                     _json_api(plugin.app()->find_plugin< plugins::json_rpc::json_rpc_plugin >()),
-                                                     _app( plugin.app() )
+                                                     _app( plugin.app() ),
+                                                     _send_queue_size( plugin.send_queue_size )
    {
-      //TODO - bind on custom evaluator instead
       post_apply_connection = _db->post_apply_operation.connect( 0, [&]( const chain::operation_notification& note ){ on_operation(note); } );
+      applied_block_connection = _db->applied_block.connect( 0, [&]( const chain::signed_block& b ){ on_applied_block(b); } );
+      _delivery_thread = std::thread( [this](){ deliver(); } );
+   }
+
+   ~subscribe_api_impl()
+   {
+      chain::util::disconnect_signal( post_apply_connection );
+      chain::util::disconnect_signal( applied_block_connection );
+
+      {
+         std::lock_guard< std::mutex > lock( _mtx );
+         _stopped = true;
+      }
+      _cv.notify_all();
+      _delivery_thread.join();
    }
 
    DECLARE_API_IMPL(
          (custom_object_subscription)
+         (get_subscription_stats)
    )
 
    void on_operation( const chain::operation_notification& note );
+   void on_applied_block( const chain::signed_block& b );
+
+   template< typename Operation >
+   void schedule( const Operation& o );
+   void schedule( const custom_content_subscriber_ptr& s );
+
+   /** Queues the documents following the position of the subscriber, up to the send queue size */
+   void queue_documents( const custom_content_subscriber_ptr& s );
+
+   template< typename Tag, typename Key, typename Matches >
+   void queue_documents( custom_content_subscriber& s, const Key& position, Matches&& matches,
+                         uint64_t chain::custom_content_object::* sequence );
+
+   fc::variant document( const custom_content_subscriber& s, const chain::custom_content_object& o, uint64_t sequence )const;
+
+   /** Body of the delivery thread, sends queued documents outside of the database lock */
+   void deliver();
+   void remove( const custom_content_subscriber& s );
 
    std::shared_ptr<chain::database_interface>  _db;
    boost::signals2::connection      post_apply_connection;
-   std::vector<custom_content_callback>  _content_subscriptions;
-   plugins::json_rpc::json_rpc_plugin* _json_api;
+   boost::signals2::connection      applied_block_connection;
    appbase::application* _app;
 
+   uint32_t                                                          _send_queue_size;
+   std::map< subscription_key, std::vector< custom_content_subscriber_ptr > > _subscriptions;
+   std::vector< custom_content_subscriber_ptr >                      _scheduled;
+   std::deque< custom_content_subscriber_ptr >                       _ready;
+
+   std::mutex                                                        _mtx;
+   std::condition_variable                                           _cv;
+   bool                                                              _stopped = false;
+   std::thread                                                       _delivery_thread;
 };
 
-struct custom_content_callback{
-   uint64_t last_position=0;
-   std::function<void(fc::variant&)> notify;
-   bool invalid = false;
-   subscribe_api_impl& impl;
-   custom_object_subscription_args args;
+void subscribe_api_impl::on_operation( const chain::operation_notification& note ){
+   if( note.op.which() == sophiatx::protocol::operation::tag<sophiatx::protocol::custom_json_operation>::value )
+      schedule( note.op.get< sophiatx::protocol::custom_json_operation >() );
+   else if( note.op.which() == sophiatx::protocol::operation::tag<sophiatx::protocol::custom_binary_operation>::value )
+      schedule( note.op.get< sophiatx::protocol::custom_binary_operation >() );
+}
 
-   custom_content_callback(const custom_object_subscription_args& _args, subscribe_api_impl& _impl, std::function<void(fc::variant&)>& _notify ):notify(_notify), impl(_impl), args(_args) {
-      FC_ASSERT(_args.start > 0);
-      last_position = _args.start-1;
-   }
+template< typename Operation >
+void subscribe_api_impl::schedule( const Operation& o )
+{
+   std::lock_guard< std::mutex > lock( _mtx );
+   if( _subscriptions.empty() )
+      return;
 
-   void operator ()() {
-      custom::list_received_documents_args cb_args;
-      cb_args.app_id = args.app_id;
-      cb_args.account_name = args.account_name;
-      cb_args.search_type = args.search_type;
-      cb_args.count = 1;
-      cb_args.start = std::to_string(last_position+1);
-      auto vdocs = impl._json_api->call_api_method(impl._app->id, "custom_api", "list_received_documents", fc::variant(cb_args), [](fc::variant& v, uint64_t i){ FC_UNUSED(v) FC_UNUSED(i)} );
-      if(!vdocs)
+   auto schedule_key = [&]( const subscription_key& key )
+   {
+      auto itr = _subscriptions.find( key );
+      if( itr == _subscriptions.end() )
          return;
-      custom::list_received_documents_return docs;
-      fc::from_variant( *vdocs, docs );
-      while (docs.size()){
-         const auto d_itr = docs.find(last_position+1);
-         if(d_itr==docs.end())
-            return;
-
-         fc::variant v;
-         fc::to_variant(*d_itr,v);
-         notify(v);
-         last_position++;
-         cb_args.start = std::to_string(last_position+1);
-         vdocs = impl._json_api->call_api_method(impl._app->id, "custom_api", "list_received_documents", fc::variant(cb_args), [](fc::variant& v, uint64_t i){ FC_UNUSED(v) FC_UNUSED(i)} );
-         if(!vdocs)
-            break;
-         fc::from_variant( *vdocs, docs );
+
+      for( const auto& s : itr->second )
+         schedule( s );
+   };
+
+   schedule_key( subscription_key( o.app_id, chain::account_name_type(), custom_content_subscriber::app_subscription ) );
+   schedule_key( subscription_key( o.app_id, o.sender, custom_content_subscriber::sender_subscription ) );
+   for( const auto& r : o.recipients )
+      schedule_key( subscription_key( o.app_id, r, custom_content_subscriber::recipient_subscription ) );
+}
+
+void subscribe_api_impl::schedule( const custom_content_subscriber_ptr& s )
+{
+   if( s->scheduled )
+      return;
+
+   s->scheduled = true;
+   _scheduled.push_back( s );
+}
+
+void subscribe_api_impl::on_applied_block( const chain::signed_block& b )
+{
+   std::lock_guard< std::mutex > lock( _mtx );
+   if( _scheduled.empty() )
+      return;
+
+   // documents of the block are queued all at once, lagging subscribers are checked again after the next block
+   std::vector< custom_content_subscriber_ptr > scheduled;
+   scheduled.swap( _scheduled );
+   for( const auto& s : scheduled )
+   {
+      s->scheduled = false;
+      if( s->invalid )
+         continue;
+
+      try
+      {
+         queue_documents( s );
+      }
+      catch( const fc::exception& e )
+      {
+         elog( "Cannot queue documents of subscription ${id}: ${e}", ("id", s->return_id)("e", e.to_detail_string()) );
       }
+
+      if( s->lagging )
+         schedule( s );
    }
-};
 
-void subscribe_api_impl::on_operation( const chain::operation_notification& note ){
-   try {
-      if( note.op.which() == sophiatx::protocol::operation::tag<sophiatx::protocol::custom_json_operation>::value ||
-          note.op.which() == sophiatx::protocol::operation::tag<sophiatx::protocol::custom_binary_operation>::value ) {
-
-         auto itr = _content_subscriptions.begin();
-         while(itr!= _content_subscriptions.end() ) {
-            try {
-               if(!itr->invalid)
-                  (*itr)();
-            } catch ( fc::send_error_exception& e ) {
-               itr->invalid = true;
-            }
-            itr++;
-         }
+   _cv.notify_one();
+}
+
+void subscribe_api_impl::queue_documents( const custom_content_subscriber_ptr& s )
+{
+   switch( s->type )
+   {
+      case custom_content_subscriber::sender_subscription:
+         queue_documents< chain::by_sender >( *s, boost::make_tuple( s->account, s->app_id, s->position ),
+            [&]( const chain::custom_content_object& o ){ return o.sender == s->account && o.app_id == s->app_id; },
+            &chain::custom_content_object::sender_sequence );
+         break;
+      case custom_content_subscriber::recipient_subscription:
+         queue_documents< chain::by_recipient >( *s, boost::make_tuple( s->account, s->app_id, s->position ),
+            [&]( const chain::custom_content_object& o ){ return o.recipient == s->account && o.app_id == s->app_id; },
+            &chain::custom_content_object::recipient_sequence );
+         break;
+      default:
+         queue_documents< chain::by_app_id >( *s, boost::make_tuple( s->app_id, s->position ),
+            [&]( const chain::custom_content_object& o ){ return o.app_id == s->app_id; },
+            &chain::custom_content_object::app_message_sequence );
+   }
 
+   if( s->queue.size() && !s->ready )
+   {
+      s->ready = true;
+      _ready.push_back( s );
+   }
+}
+
+template< typename Tag, typename Key, typename Matches >
+void subscribe_api_impl::queue_documents( custom_content_subscriber& s, const Key& position, Matches&& matches,
+                                          uint64_t chain::custom_content_object::* sequence )
+{
+   const auto& idx = _db->get_index< chain::custom_content_index, Tag >();
+
+   // the index is ordered by descending sequence, documents following the position precede the lower bound
+   auto itr = idx.lower_bound( position );
+   s.lagging = false;
+
+   while( itr != idx.begin() )
+   {
+      --itr;
+      if( !matches( *itr ) )
+         break;
+
+      // the documents of all recipients of a message share its sender and app sequence, the message is queued once
+      if( (*itr).*sequence == s.position )
+         continue;
+
+      if( s.queue.size() >= _send_queue_size )
+      {
+         s.lagging = true;
+         s.lags++;
+         break;
       }
-   } catch (fc::assert_exception&){}
+
+      s.queue.push_back( document( s, *itr, (*itr).*sequence ) );
+      s.position = (*itr).*sequence;
+   }
 }
 
+fc::variant subscribe_api_impl::document( const custom_content_subscriber& s, const chain::custom_content_object& o, uint64_t sequence )const
+{
+   auto payload = _db->get_custom_content_payload( _db->get( o.payload ) );
+   fc::variant v;
 
-DEFINE_API_IMPL( subscribe_api_impl, custom_object_subscription )
+   if( !s.packed )
+   {
+      fc::to_variant( std::make_pair( sequence, custom::received_object( o, payload ) ), v );
+      return v;
+   }
+
+   packed_custom_document d;
+   d.sequence = sequence;
+   d.id = o.id._id;
+   d.sender = o.sender;
+   for( const auto& r : payload.all_recipients )
+      d.recipients.push_back( r );
+   d.app_id = o.app_id;
+   d.binary = payload.binary;
+   d.data = std::move( payload.data );
+   d.json = std::move( payload.json );
+   d.received = o.received;
+
+   // base64 rather than the hex of a variant of bytes, a third larger than the packed document instead of twice
+   auto packed = fc::raw::pack_to_vector( d );
+   v = fc::base64_encode( packed.data(), packed.size() );
+   return v;
+}
+
+void subscribe_api_impl::deliver()
+{
+   std::unique_lock< std::mutex > lock( _mtx );
+   while( true )
+   {
+      _cv.wait( lock, [this](){ return _stopped || !_ready.empty(); } );
+      if( _stopped )
+         return;
+
+      auto s = _ready.front();
+      _ready.pop_front();
+
+      std::deque< fc::variant > queue;
+      queue.swap( s->queue );
+      s->ready = false;
+
+      // the queue of a block is sent at once, still one document per notification as clients of the api expect
+      lock.unlock();
+      uint64_t delivered = 0;
+      bool failed = false;
+      for( auto& v : queue )
+      {
+         try
+         {
+            s->notify( v, s->return_id );
+            delivered++;
+         }
+         catch( const fc::send_error_exception& )
+         {
+            failed = true;
+            break;
+         }
+      }
+      lock.lock();
+
+      s->delivered += delivered;
+      if( failed )
+      {
+         s->invalid = true;
+         remove( *s );
+      }
+   }
+}
+
+void subscribe_api_impl::remove( const custom_content_subscriber& s )
 {
-   std::function<void(fc::variant&)> notify = [ notify_callback, args ](fc::variant& v )->void{ notify_callback(v, args.return_id);};
+   auto itr = _subscriptions.find( subscription_key( s.app_id, s.account, s.type ) );
+   if( itr == _subscriptions.end() )
+      return;
 
-   custom_content_callback cb(args, *this, notify );
+   auto& subscribers = itr->second;
+   subscribers.erase( std::remove_if( subscribers.begin(), subscribers.end(),
+      [&]( const custom_content_subscriber_ptr& p ){ return p.get() == &s; } ), subscribers.end() );
+
+   if( subscribers.empty() )
+      _subscriptions.erase( itr );
+}
 
-   cb();
 
-   _content_subscriptions.push_back(cb);
+DEFINE_API_IMPL( subscribe_api_impl, custom_object_subscription )
+{
+   FC_ASSERT( args.start > 0 );
+   auto type = subscription_types.find( args.search_type );
+   FC_ASSERT( type != subscription_types.end(), "Subscriptions support the by_sender, by_recipient and by_app search types" );
+
+   auto s = std::make_shared< custom_content_subscriber >();
+   s->return_id = args.return_id;
+   s->app_id = args.app_id;
+   s->type = type->second;
+   s->packed = args.packed;
+   if( s->type != custom_content_subscriber::app_subscription )
+      s->account = args.account_name;
+   s->notify = notify_callback;
+   s->position = args.start - 1;
+
+   std::lock_guard< std::mutex > lock( _mtx );
+
+   // documents already stored are queued right away, later ones at the end of the block adding them
+   queue_documents( s );
+   if( s->lagging )
+      schedule( s );
+
+   _subscriptions[ subscription_key( s->app_id, s->account, s->type ) ].push_back( s );
+   _cv.notify_one();
 
    return args.return_id;
 }
 
+DEFINE_API_IMPL( subscribe_api_impl, get_subscription_stats )
+{
+   std::lock_guard< std::mutex > lock( _mtx );
 
+   get_subscription_stats_return result;
+   for( const auto& subscribers : _subscriptions )
+   {
+      for( const auto& s : subscribers.second )
+      {
+         custom_object_subscription_stats stats;
+         stats.return_id = s->return_id;
+         stats.app_id = s->app_id;
+         stats.account_name = s->account;
+         for( const auto& t : subscription_types )
+            if( t.second == s->type )
+               stats.search_type = t.first;
+         stats.position = s->position;
+         stats.queued = s->queue.size();
+         stats.delivered = s->delivered;
+         stats.lags = s->lags;
+         stats.lagging = s->lagging;
+         result.push_back( stats );
+      }
+   }
 
+   return result;
+}
 
 
 } // namespace detail
@@ -137,4 +425,8 @@ DEFINE_READ_APIS( subscribe_api,
      (custom_object_subscription)
 )
 
+DEFINE_LOCKLESS_APIS( subscribe_api,
+     (get_subscription_stats)
+)
+
 } } } // sophiatx::plugins::subscribe
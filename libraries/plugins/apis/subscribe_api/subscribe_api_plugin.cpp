@@ -7,10 +7,18 @@ namespace sophiatx { namespace plugins { namespace subscribe {
 subscribe_api_plugin::subscribe_api_plugin() {}
 subscribe_api_plugin::~subscribe_api_plugin() {}
 
-void subscribe_api_plugin::set_program_options( options_description& cli, options_description& cfg ) {}
+void subscribe_api_plugin::set_program_options( options_description& cli, options_description& cfg )
+{
+   cfg.add_options()
+         ("subscribe-send-queue-size", boost::program_options::value<uint32_t>()->default_value(1000),
+            "Number of documents queued for a single subscriber. Documents of a subscriber with a full queue are held back until it catches up.")
+         ;
+}
 
 void subscribe_api_plugin::plugin_initialize( const variables_map& options )
 {
+   send_queue_size = options.at( "subscribe-send-queue-size" ).as<uint32_t>();
+   FC_ASSERT( send_queue_size > 0, "subscribe-send-queue-size must be positive" );
    api = std::make_shared< subscribe_api >(*this);
 }
 
@@ -29,7 +29,7 @@ using sophiatx::chain::block_id_type;
 namespace asio = boost::asio;
 
 
-chain_plugin_full::chain_plugin_full() : write_queue( 64 ) {
+chain_plugin_full::chain_plugin_full() {
    db_ = std::make_shared<database>();
 }
 
@@ -41,6 +41,7 @@ struct write_request_visitor
 
    std::shared_ptr<database> db;
    uint32_t  skip = 0;
+   const transaction_envelopes* envelopes = nullptr;
    fc::optional< fc::exception >* except;
 
    typedef bool result_type;
@@ -51,7 +52,10 @@ struct write_request_visitor
 
       try
       {
-         result = db->push_block( *block, skip );
+         if( envelopes )
+            result = db->push_block( *block, skip, *envelopes );
+         else
+            result = db->push_block( *block, skip );
       }
       catch( fc::exception& e )
       {
@@ -66,7 +70,7 @@ struct write_request_visitor
       return result;
    }
 
-   bool operator()( const signed_transaction* trx )
+   bool operator()( const transaction_envelope_ptr* trx )
    {
       bool result = false;
 
@@ -89,6 +93,34 @@ struct write_request_visitor
    }
 
 
+   bool operator()( transaction_batch_request* req )
+   {
+      const auto& trxs = *req->trxs;
+      auto& results = *req->results;
+
+      for( size_t i = 0; i < trxs.size(); ++i )
+      {
+         if( results[i] )
+            continue;
+
+         try
+         {
+            db->push_transaction( trxs[i] );
+         }
+         catch( fc::exception& e )
+         {
+            results[i] = e;
+         }
+         catch( ... )
+         {
+            results[i] = fc::unhandled_exception( FC_LOG_MESSAGE( warn, "Unexpected exception while pushing transaction." ),
+                                                  std::current_exception() );
+         }
+      }
+
+      return true;
+   }
+
    bool operator()( generate_block_request* req )
    {
       bool result = false;
@@ -129,6 +161,9 @@ struct request_promise_visitor
 
 void chain_plugin_full::start_write_processing()
 {
+   if( !write_queue )
+      write_queue.reset( new util::bounded_queue< write_context* >( write_queue_size ) );
+
    write_processor_thread = std::make_shared< std::thread >( [&](){
         bool is_syncing = true;
         write_context* cxt;
@@ -138,6 +173,18 @@ void chain_plugin_full::start_write_processing()
 
         request_promise_visitor prom_visitor;
 
+        auto record_wait = [&]( write_context* c )
+        {
+           c->queue_wait = fc::time_point::now() - c->enqueued;
+           uint64_t wait = c->queue_wait.count() > 0 ? c->queue_wait.count() : 0;
+
+           write_requests.fetch_add( 1, std::memory_order_relaxed );
+           write_queue_total_wait.fetch_add( wait, std::memory_order_relaxed );
+
+           uint64_t max_wait = write_queue_max_wait.load( std::memory_order_relaxed );
+           while( wait > max_wait && !write_queue_max_wait.compare_exchange_weak( max_wait, wait, std::memory_order_relaxed ) );
+        };
+
         /* This loop monitors the write request queue and performs writes to the database. These
          * can be blocks or pending transactions. Because the caller needs to know the success of
          * the write and any exceptions that are thrown, a write context is passed in the queue
@@ -145,57 +192,59 @@ void chain_plugin_full::start_write_processing()
          * caller's responsibility to ensure the pointer to the write context remains valid until
          * the contained promise is complete.
          *
+         * The thread blocks on the queue until a request arrives, so a request is picked up as soon
+         * as it is queued. Once it holds the write lock it drains the queue without waiting, batching
+         * the writes queued meanwhile under a single lock. The loop exits when the queue is closed and
+         * drained.
+         *
          * The loop has two modes, sync mode and live mode. In sync mode we want to process writes
-         * as quickly as possible with minimal overhead. The outer loop busy waits on the queue
-         * and the inner loop drains the queue as quickly as possible. We exit sync mode when the
-         * head block is within 1 minute of system time.
+         * as quickly as possible with minimal overhead and the batch ends only when the queue is empty.
+         * We exit sync mode when the head block is within 1 minute of system time.
          *
          * Live mode needs to balance between processing pending writes and allowing readers access
-         * to the database. It will batch writes together as much as possible to minimize lock
-         * overhead but will willingly give up the write lock after 500ms. The thread then sleeps for
-         * 10ms. This allows time for readers to access the database as well as more writes to come
-         * in. When the node is live the rate at which writes come in is slower and busy waiting is
-         * not an optimal use of system resources when we could give CPU time to read threads.
+         * to the database. It will willingly give up the write lock after write_lock_hold_time and then
+         * sleeps for 10ms, which allows time for readers to access the database before the remaining
+         * writes are processed.
          */
-        while( running )
+        while( write_queue->pop( cxt ) )
         {
            if( !is_syncing )
               start = fc::time_point::now();
 
-           if( write_queue.pop( cxt ) )
-           {
-              db_->with_write_lock( [&](){
-                   while( true )
+           bool hold_time_expired = false;
+
+           db_->with_write_lock( [&](){
+                while( true )
+                {
+                   record_wait( cxt );
+                   req_visitor.skip = cxt->skip;
+                   req_visitor.envelopes = cxt->envelopes;
+                   req_visitor.except = &(cxt->except);
+                   cxt->success = cxt->req_ptr.visit( req_visitor );
+                   head_block_time_sec = db_->head_block_num() > 0 ? db_->head_block_time().sec_since_epoch() : 0;
+                   cxt->prom_ptr.visit( prom_visitor );
+
+                   if( is_syncing && start - db_->head_block_time() < fc::minutes(1) )
                    {
-                      req_visitor.skip = cxt->skip;
-                      req_visitor.except = &(cxt->except);
-                      cxt->success = cxt->req_ptr.visit( req_visitor );
-                      cxt->prom_ptr.visit( prom_visitor );
-
-                      if( is_syncing && start - db_->head_block_time() < fc::minutes(1) )
-                      {
-                         start = fc::time_point::now();
-                         is_syncing = false;
-                      }
-
-                      if( !is_syncing && write_lock_hold_time >= 0 && fc::time_point::now() - start > fc::milliseconds( write_lock_hold_time ) )
-                      {
-                         break;
-                      }
-
-                      if( !write_queue.pop( cxt ) )
-                      {
-                         break;
-                      }
+                      start = fc::time_point::now();
+                      is_syncing = false;
                    }
-              });
 
-           }
+                   if( !is_syncing && write_lock_hold_time >= 0 && fc::time_point::now() - start > fc::milliseconds( write_lock_hold_time ) )
+                   {
+                      hold_time_expired = true;
+                      break;
+                   }
+
+                   if( !write_queue->try_pop( cxt ) )
+                   {
+                      break;
+                   }
+                }
+           });
 
-           if( !is_syncing ) {
+           if( hold_time_expired )
               boost::this_thread::sleep_for(boost::chrono::milliseconds(10));
-           } else
-              boost::this_thread::sleep_for(boost::chrono::milliseconds(1));
         }
    });
 }
@@ -204,10 +253,83 @@ void chain_plugin_full::stop_write_processing()
 {
    running = false;
 
+   if( write_queue )
+      write_queue->close();
+
    if( write_processor_thread )
       write_processor_thread->join();
 
    write_processor_thread.reset();
+
+   {
+      // waits for the callers which posted work to the pool, later callers prepare their envelopes themselves
+      boost::unique_lock< boost::shared_mutex > lock( signature_recovery_mtx );
+      signature_recovery_running = false;
+   }
+
+   signature_recovery_work.reset();
+   signature_recovery_ios.stop();
+   signature_recovery_pool.join_all();
+}
+
+void chain_plugin_full::prepare_transaction_envelopes( const std::vector< sophiatx::chain::signed_transaction >& trxs,
+                                                       transaction_envelopes& envelopes, bool recover_keys,
+                                                       std::vector< fc::optional< fc::exception > >* validation_errors )
+{
+   envelopes.resize( trxs.size() );
+   if( validation_errors )
+      validation_errors->resize( trxs.size() );
+
+   auto prepare = [&]( size_t i )
+   {
+      auto envelope = std::make_shared< transaction_envelope >( trxs[i], chain_id );
+
+      if( recover_keys )
+      {
+         // the write thread recovers the keys again and reports the error
+         try { envelope->signature_keys(); } catch( ... ) {}
+      }
+
+      if( validation_errors )
+      {
+         try
+         {
+            prevalidate_transaction( *envelope );
+         }
+         catch( fc::exception& e )
+         {
+            (*validation_errors)[i] = e;
+         }
+      }
+
+      envelopes[i] = std::move( envelope );
+   };
+
+   boost::shared_lock< boost::shared_mutex > lock( signature_recovery_mtx );
+   size_t workers = signature_recovery_running && !signature_recovery_ios.stopped()
+                    ? std::min< size_t >( signature_recovery_threads, trxs.size() ) : 0;
+   if( workers == 0 )
+   {
+      for( size_t i = 0; i < trxs.size(); ++i )
+         prepare( i );
+      return;
+   }
+
+   std::vector< boost::promise< void > > done( workers );
+
+   for( size_t w = 0; w < workers; ++w )
+   {
+      signature_recovery_ios.post( [&, w]()
+      {
+         for( size_t i = w; i < trxs.size(); i += workers )
+            prepare( i );
+
+         done[w].set_value();
+      });
+   }
+
+   for( auto& d : done )
+      d.get_future().get();
 }
 
 void chain_plugin_full::set_program_options(options_description& cli, options_description& cfg)
@@ -224,6 +346,8 @@ void chain_plugin_full::set_program_options(options_description& cli, options_de
             "flush shared memory changes to disk every N blocks")
          ("check-locks", bpo::bool_switch()->default_value(false), "Check correctness of chainbase locking" )
          ("validate-database-invariants", bpo::bool_switch()->default_value(false), "Validate all supply invariants check out" )
+         ("invariants-audit-interval", bpo::value<uint32_t>()->default_value(0),
+            "Recompute supply invariants by scanning all accounts and escrows every N blocks, 0 disables the audit. Per block checks use running totals." )
          ("initminer-mining-pubkey", bpo::value<std::string>(), "initminer public key for mining. Used only for private nets.")
          ("initminer-account-pubkey", bpo::value<std::string>(), "initminer public key for account operations. Used only for private nets.")
          ("set-benchmark-interval", bpo::value<uint32_t>(), "Print time and memory usage every given number of blocks")
@@ -231,6 +355,18 @@ void chain_plugin_full::set_program_options(options_description& cli, options_de
          ("replay-blockchain", bpo::bool_switch()->default_value(false), "clear chain database and replay all blocks" )
          ("resync-blockchain", bpo::bool_switch()->default_value(false), "clear chain database and block log" )
          ("stop-replay-at-block", bpo::value<uint32_t>(), "Stop and exit after reaching given block number")
+         ("replay-queue-size", bpo::value<uint32_t>()->default_value(1024), "Number of blocks read ahead of the applied block while replaying the blockchain")
+         ("block-log-queue-size", bpo::value<uint32_t>()->default_value(256), "Number of irreversible blocks queued for the background block log writer. 0 writes the block log on the write thread.")
+         ("block-log-compression", bpo::value<bool>()->default_value(false), "Create a new block log in the compressed format (version 2). Tools reading the block_log file directly must support version 2. An existing block log keeps its format, convert_block_log converts it.")
+         ("block-cache-size", bpo::value<string>()->default_value("64M"), "Packed size of the decoded irreversible blocks cached for API and p2p readers (e.g. 256M). 0 disables the cache.")
+         ("block-log-transaction-index", bpo::value<bool>()->default_value(false), "Maintain an index of transaction ids next to the block log, so block_api.get_transaction can find irreversible transactions without the account history plugin.")
+         ("custom-content-archive-age", bpo::value<string>()->default_value("0"), "Move irreversible custom content older than the given age out of the shared memory file into custom_content.archive. The age is a number of blocks, or of days with a d suffix (e.g. 30d). 0 disables the age limit.")
+         ("custom-content-memory-budget", bpo::value<string>()->default_value("0"), "Move the oldest irreversible custom content into custom_content.archive while the content in the shared memory file exceeds this size (e.g. 2G). 0 disables the budget.")
+         ("write-queue-size", bpo::value<uint32_t>()->default_value(1024), "Number of blocks and transactions waiting for the write thread. Further submissions wait until there is room in the queue.")
+         ("export-state", bpo::value<bfs::path>(), "Write a snapshot of the chain state into the given directory after the database is opened")
+         ("import-state", bpo::value<bfs::path>(), "Clear chain database and restore it from the state snapshot in the given directory instead of replaying the blockchain. The block log must contain the snapshot head block.")
+         ("signature-recovery-threads", bpo::value<uint32_t>()->default_value(4),
+            "Number of threads preparing transactions of incoming blocks (serialization, hashes and signature keys) before they are applied. 0 prepares them on the write thread." )
          ;
 }
 
@@ -300,11 +436,31 @@ void chain_plugin_full::plugin_initialize(const variables_map& options) {
    resync              = options.at( "resync-blockchain").as<bool>();
    stop_replay_at      =
       options.count( "stop-replay-at-block" ) ? options.at( "stop-replay-at-block" ).as<uint32_t>() : 0;
+   replay_queue_size   = options.at( "replay-queue-size" ).as<uint32_t>();
+   block_log_queue_size = options.at( "block-log-queue-size" ).as<uint32_t>();
+   block_log_compression = options.at( "block-log-compression" ).as<bool>();
+   block_cache_size = fc::parse_size( options.at( "block-cache-size" ).as< string >() );
+   block_log_transaction_index = options.at( "block-log-transaction-index" ).as<bool>();
+
+   auto archive_age = options.at( "custom-content-archive-age" ).as< string >();
+   if( !archive_age.empty() && archive_age.back() == 'd' )
+      custom_content_archive_age = fc::to_uint64( archive_age.substr( 0, archive_age.size() - 1 ) ) * SOPHIATX_BLOCKS_PER_DAY;
+   else
+      custom_content_archive_age = fc::to_uint64( archive_age );
+   custom_content_memory_budget = fc::parse_size( options.at( "custom-content-memory-budget" ).as< string >() );
+
+   write_queue_size = options.at( "write-queue-size" ).as<uint32_t>();
+   if( options.count( "export-state" ) )
+      export_state_dir = options.at( "export-state" ).as<bfs::path>();
+   if( options.count( "import-state" ) )
+      import_state_dir = options.at( "import-state" ).as<bfs::path>();
    benchmark_interval  =
       options.count( "set-benchmark-interval" ) ? options.at( "set-benchmark-interval" ).as<uint32_t>() : 0;
    check_locks         = options.at( "check-locks" ).as< bool >();
    validate_invariants = options.at( "validate-database-invariants" ).as<bool>();
+   invariants_audit_interval = options.at( "invariants-audit-interval" ).as<uint32_t>();
    dump_memory_details = options.at( "dump-memory-details" ).as<bool>();
+   signature_recovery_threads = options.at( "signature-recovery-threads" ).as<uint32_t>();
 
    if( options.count( "flush-state-interval" ) )
       flush_interval = options.at( "flush-state-interval" ).as<uint32_t>();
@@ -329,7 +485,7 @@ void chain_plugin_full::plugin_startup()
 {
    ilog( "Starting chain with shared_file_size: ${n} bytes", ("n", shared_memory_size) );
 
-   chain_id_type chain_id = genesis.compute_chain_id();
+   chain_id = genesis.compute_chain_id();
 
    shared_memory_dir = app_factory().data_dir / chain_id.str() / "blockchain";
 
@@ -343,6 +499,16 @@ void chain_plugin_full::plugin_startup()
 
    start_write_processing();
 
+   if( signature_recovery_threads > 0 )
+   {
+      signature_recovery_work.reset( new asio::io_service::work( signature_recovery_ios ) );
+      for( uint32_t i = 0; i < signature_recovery_threads; ++i )
+         signature_recovery_pool.create_thread( boost::bind( &asio::io_service::run, &signature_recovery_ios ) );
+
+      boost::unique_lock< boost::shared_mutex > lock( signature_recovery_mtx );
+      signature_recovery_running = true;
+   }
+
    if(resync)
    {
       wlog("resync requested: deleting block log and shared memory");
@@ -350,6 +516,7 @@ void chain_plugin_full::plugin_startup()
    }
 
    db_->set_flush_interval( flush_interval );
+   db_->set_invariants_audit_interval( invariants_audit_interval );
    db_->add_checkpoints( loaded_checkpoints );
    db_->set_require_locking( check_locks );
 
@@ -380,6 +547,13 @@ void chain_plugin_full::plugin_startup()
    db_open_args.shared_file_scale_rate = shared_file_scale_rate;
    db_open_args.do_validate_invariants = validate_invariants;
    db_open_args.stop_replay_at = stop_replay_at;
+   db_open_args.replay_queue_size = replay_queue_size;
+   db_open_args.block_log_queue_size = block_log_queue_size;
+   db_open_args.block_log_compression = block_log_compression;
+   db_open_args.block_cache_size = block_cache_size;
+   db_open_args.block_log_transaction_index = block_log_transaction_index;
+   db_open_args.custom_content_archive_age = custom_content_archive_age;
+   db_open_args.custom_content_memory_budget = custom_content_memory_budget;
 
    auto benchmark_lambda = [&dumper, &get_indexes_memory_details, dump_memory_details_] ( uint32_t current_block_number,
       const chainbase::database::abstract_index_cntr_t& abstract_index_cntr )
@@ -414,7 +588,12 @@ void chain_plugin_full::plugin_startup()
          ("pm", measure.peak_mem) );
    };
 
-   if(replay)
+   if( !import_state_dir.empty() )
+   {
+      ilog("Importing chain state on user request.");
+      std::static_pointer_cast<database>(db_)->import_state( db_open_args, import_state_dir, genesis, init_mining_pubkey );
+   }
+   else if(replay)
    {
       ilog("Replaying blockchain on user request.");
       uint32_t last_block_number = 0;
@@ -468,6 +647,15 @@ void chain_plugin_full::plugin_startup()
       }
    }
 
+   if( !export_state_dir.empty() )
+      std::static_pointer_cast<database>(db_)->export_state( export_state_dir );
+
+   // transactions are checked against the head block time before the write thread applies the first request
+   db_->with_read_lock( [&]()
+   {
+      head_block_time_sec = db_->head_block_num() > 0 ? db_->head_block_time().sec_since_epoch() : 0;
+   });
+
    ilog( "Started on blockchain with ${n} blocks", ("n", db_->head_block_num()) );
    on_sync();
 }
@@ -491,37 +679,92 @@ bool chain_plugin_full::accept_block( const sophiatx::chain::signed_block& block
 
    check_time_in_block( block );
 
-   boost::promise< void > prom;
+   transaction_envelopes envelopes;
+   if( signature_recovery_threads > 0 )
+      prepare_transaction_envelopes( block.transactions, envelopes,
+                                     !( skip & ( database::skip_transaction_signatures | database::skip_authority_check ) ) );
+
    write_context cxt;
    cxt.req_ptr = &block;
    cxt.skip = currently_syncing? skip | database::skip_validate_invariants : skip;
-   cxt.prom_ptr = &prom;
-
-   write_queue.push( &cxt );
+   if( envelopes.size() )
+      cxt.envelopes = &envelopes;
 
-   prom.get_future().get();
-
-   if( cxt.except ) throw *(cxt.except);
+   push_write_request( cxt );
 
    return cxt.success;
 }
 
 void chain_plugin_full::accept_transaction( const sophiatx::chain::signed_transaction& trx )
 {
-   boost::promise< void > prom;
+   accept_transaction( std::make_shared< transaction_envelope >( trx, chain_id ) );
+}
+
+void chain_plugin_full::accept_transaction( const sophiatx::chain::transaction_envelope_ptr& trx )
+{
+   prevalidate_transaction( *trx );
+
    write_context cxt;
    cxt.req_ptr = &trx;
+
+   push_write_request( cxt );
+}
+
+std::vector< fc::optional< fc::exception > > chain_plugin_full::accept_transactions( const std::vector< sophiatx::chain::signed_transaction >& trxs )
+{
+   std::vector< fc::optional< fc::exception > > results;
+   transaction_envelopes envelopes;
+   prepare_transaction_envelopes( trxs, envelopes, true, &results );
+
+   transaction_batch_request req;
+   req.trxs = &envelopes;
+   req.results = &results;
+
+   write_context cxt;
+   cxt.req_ptr = &req;
+
+   push_write_request( cxt );
+
+   return results;
+}
+
+void chain_plugin_full::push_write_request( write_context& cxt )
+{
+   FC_ASSERT( write_queue, "Write processing has not been started" );
+
+   boost::promise< void > prom;
    cxt.prom_ptr = &prom;
+   cxt.enqueued = fc::time_point::now();
 
-   write_queue.push( &cxt );
+   FC_ASSERT( write_queue->push( &cxt ), "Write queue is closed, the chain is shutting down" );
 
    prom.get_future().get();
 
    if( cxt.except ) throw *(cxt.except);
-
-   return;
 }
 
+void chain_plugin_full::prevalidate_transaction( const transaction_envelope& envelope )const
+{ try {
+   const auto& trx = envelope.get_transaction();
+
+   FC_ASSERT( envelope.packed_size() <= SOPHIATX_MAX_TRANSACTION_SIZE, "Transaction size is bigger than SOPHIATX_MAX_TRANSACTION_SIZE" );
+
+   fc::time_point_sec head_time( head_block_time_sec.load( std::memory_order_relaxed ) );
+   if( head_time != fc::time_point_sec() )
+   {
+      SOPHIATX_ASSERT( head_time < trx.expiration, transaction_expiration_exception, "", ("now",head_time)("trx.exp",trx.expiration) );
+
+      // the head block may not be more than allow_future_time ahead of the wall clock, see check_time_in_block()
+      fc::time_point_sec latest_head = std::max( head_time, fc::time_point_sec( fc::time_point::now() ) + allow_future_time );
+      SOPHIATX_ASSERT( trx.expiration <= latest_head + fc::seconds(SOPHIATX_MAX_TIME_UNTIL_EXPIRATION), transaction_expiration_exception,
+                       "", ("trx.expiration",trx.expiration)("now",head_time)("max_til_exp",SOPHIATX_MAX_TIME_UNTIL_EXPIRATION) );
+   }
+
+   // canonicity of the signatures and the authorities depend on the chain state and are checked by the write thread
+   envelope.signature_keys();
+   envelope.validate();
+} FC_CAPTURE_AND_RETHROW( (envelope.id()) ) }
+
 void chain_plugin_full::check_time_in_block( const sophiatx::chain::signed_block& block )
 {
    time_point_sec now = fc::time_point::now();
@@ -535,16 +778,10 @@ sophiatx::chain::signed_block chain_plugin_full::generate_block( const fc::time_
                                                          const fc::ecc::private_key& block_signing_private_key, uint32_t skip )
 {
    generate_block_request req( when, witness_owner, block_signing_private_key, skip );
-   boost::promise< void > prom;
    write_context cxt;
    cxt.req_ptr = &req;
-   cxt.prom_ptr = &prom;
 
-   write_queue.push( &cxt );
-
-   prom.get_future().get();
-
-   if( cxt.except ) throw *(cxt.except);
+   push_write_request( cxt );
 
    FC_ASSERT( cxt.success, "Block could not be generated" );
 
@@ -561,4 +798,28 @@ int16_t chain_plugin_full::set_write_lock_hold_time( int16_t new_time )
    return old_time;
 }
 
+write_queue_stats chain_plugin_full::get_write_queue_stats() const
+{
+   write_queue_stats result;
+   result.requests = write_requests.load( std::memory_order_relaxed );
+   result.total_wait_us = write_queue_total_wait.load( std::memory_order_relaxed );
+   result.max_wait_us = write_queue_max_wait.load( std::memory_order_relaxed );
+   if( write_queue )
+   {
+      result.size = write_queue->size();
+      result.capacity = write_queue->capacity();
+   }
+   return result;
+}
+
+block_log_append_metrics chain_plugin_full::get_block_log_append_metrics() const
+{
+   return std::static_pointer_cast<database>(db_)->get_block_log_append_metrics();
+}
+
+block_cache_stats chain_plugin_full::get_block_cache_stats() const
+{
+   return std::static_pointer_cast<database>(db_)->get_block_cache_stats();
+}
+
 } } } // namespace sophiatx::plugis::chain::chain_apis
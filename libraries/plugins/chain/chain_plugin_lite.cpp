@@ -23,8 +23,9 @@ chain_plugin_lite::~chain_plugin_lite() {}
 
 void chain_plugin_lite::set_program_options(options_description &cli, options_description &cfg) {
    cfg.add_options()
-         ("server-rpc-endpoint", bpo::value<string>()->default_value("ws://127.0.0.1:9191"),
-          "Server websocket RPC endpoint")
+         ("server-rpc-endpoint", bpo::value<vector<string>>()->composing()
+                ->default_value(vector<string>{"ws://127.0.0.1:9191"}, "ws://127.0.0.1:9191"),
+          "Server websocket RPC endpoint, may be given more than once. One connection is opened to each endpoint and calls are spread over them")
          ("app-id", bpo::value<uint64_t>()->default_value(1),
           "App id used by the hybrid DB")
          ("shared-file-dir", bpo::value<bfs::path>()->default_value("blockchain"),
@@ -57,7 +58,7 @@ void chain_plugin_lite::plugin_initialize(const variables_map &options) {
 
    resync = options.at("resync-blockchain").as<bool>();
 
-   ws_endpoint = options.at("server-rpc-endpoint").as<string>();
+   ws_endpoints = options.at("server-rpc-endpoint").as<vector<string>>();
    app_id = options.at("app-id").as<long long>();
 }
 
@@ -81,7 +82,7 @@ void chain_plugin_lite::plugin_startup() {
    db_open_args.shared_file_scale_rate = shared_file_scale_rate;
    db_open_args.app_id = app_id;
 
-   remote::remote_db::init(ws_endpoint);
+   remote::remote_db::init(ws_endpoints);
 
    db_->open(db_open_args, genesis_state_type(), public_key_type());
 }
@@ -92,6 +93,10 @@ void chain_plugin_lite::plugin_shutdown() {
    ilog("database closed successfully");
 }
 
+std::vector<remote::remote_connection_stats> chain_plugin_lite::get_remote_connection_stats() const {
+   return remote::remote_db::get_connection_stats();
+}
+
 }
 }
 } // namespace sophiatx::plugis::chain::chain_apis
@@ -6,6 +6,7 @@
 
 #include <appbase/application.hpp>
 #include <sophiatx/chain/database/database_interface.hpp>
+#include <sophiatx/remote_db/remote_db.hpp>
 
 #include <boost/signals2.hpp>
 
@@ -17,6 +18,15 @@ using std::unique_ptr;
 using namespace appbase;
 using namespace sophiatx::chain;
 
+struct write_queue_stats
+{
+   uint64_t          requests = 0;           ///< requests taken from the queue
+   uint64_t          total_wait_us = 0;      ///< time the requests waited in the queue
+   uint64_t          max_wait_us = 0;
+   uint32_t          size = 0;               ///< requests waiting in the queue
+   uint32_t          capacity = 0;
+};
+
 class chain_plugin : public plugin< chain_plugin >
 {
 public:
@@ -52,6 +62,18 @@ public:
       FC_ASSERT(false, "Not implemented for lite version of chain_plugin");
    }
 
+   virtual void accept_transaction( const sophiatx::chain::transaction_envelope_ptr& trx ) {
+      FC_ASSERT(false, "Not implemented for lite version of chain_plugin");
+   }
+
+   /**
+    * Applies the transactions in a single write request.
+    * @return the error of each transaction, empty for the accepted ones
+    */
+   virtual std::vector< fc::optional< fc::exception > > accept_transactions( const std::vector< sophiatx::chain::signed_transaction >& trxs ) {
+      FC_ASSERT(false, "Not implemented for lite version of chain_plugin");
+   }
+
    virtual sophiatx::chain::signed_block generate_block( const fc::time_point_sec& when,
                                                          const account_name_type& witness_owner,
                                                          const fc::ecc::private_key& block_signing_private_key,
@@ -63,6 +85,22 @@ public:
       FC_ASSERT(false, "Not implemented for lite version of chain_plugin");
    }
 
+   virtual write_queue_stats get_write_queue_stats() const {
+      FC_ASSERT(false, "Not implemented for lite version of chain_plugin");
+   }
+
+   virtual block_log_append_metrics get_block_log_append_metrics() const {
+      FC_ASSERT(false, "Not implemented for lite version of chain_plugin");
+   }
+
+   virtual block_cache_stats get_block_cache_stats() const {
+      FC_ASSERT(false, "Not implemented for lite version of chain_plugin");
+   }
+
+   virtual std::vector<remote::remote_connection_stats> get_remote_connection_stats() const {
+      FC_ASSERT(false, "Not implemented for full version of chain_plugin");
+   }
+
    template< typename MultiIndexType >
    bool has_index() const
    {
@@ -120,3 +158,5 @@ protected:
 };
 
 } } } // sophiatx::plugins::chain
+
+FC_REFLECT( sophiatx::plugins::chain::write_queue_stats, (requests)(total_wait_us)(max_wait_us)(size)(capacity) )
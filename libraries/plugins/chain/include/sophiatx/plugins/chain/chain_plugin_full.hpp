@@ -3,7 +3,14 @@
 #pragma once
 
 #include <sophiatx/plugins/chain/chain_plugin.hpp>
-#include <boost/lockfree/queue.hpp>
+#include <sophiatx/chain/database/database.hpp>
+#include <sophiatx/chain/util/bounded_queue.hpp>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <atomic>
 
 
 namespace sophiatx { namespace plugins { namespace chain {
@@ -27,17 +34,26 @@ struct generate_block_request
    signed_block block;
 };
 
-typedef fc::static_variant< const signed_block*, const signed_transaction*, generate_block_request* > write_request_ptr;
+/** Transactions applied in a single write request, entries with an error set are skipped */
+struct transaction_batch_request
+{
+   const transaction_envelopes*                  trxs = nullptr;
+   std::vector< fc::optional< fc::exception > >* results = nullptr;
+};
+
+typedef fc::static_variant< const signed_block*, const transaction_envelope_ptr*, generate_block_request*, transaction_batch_request* > write_request_ptr;
 typedef fc::static_variant< boost::promise< void >*, fc::future< void >* > promise_ptr;
 
 struct write_context
 {
    write_request_ptr             req_ptr;
    uint32_t                      skip = 0;
+   const transaction_envelopes*  envelopes = nullptr;
    bool                          success = true;
    fc::optional< fc::exception > except;
    promise_ptr                   prom_ptr;
-
+   fc::time_point                enqueued;
+   fc::microseconds              queue_wait;       ///< time the request waited for the write thread
 };
 
 class chain_plugin_full : public chain_plugin
@@ -55,6 +71,10 @@ public:
    bool accept_block( const sophiatx::chain::signed_block& block, bool currently_syncing, uint32_t skip ) override;
    void accept_transaction( const sophiatx::chain::signed_transaction& trx ) override;
 
+   /** Pre-validates the transaction on the calling thread and pushes it if it passes */
+   void accept_transaction( const sophiatx::chain::transaction_envelope_ptr& trx ) override;
+   std::vector< fc::optional< fc::exception > > accept_transactions( const std::vector< sophiatx::chain::signed_transaction >& trxs ) override;
+
    void check_time_in_block( const sophiatx::chain::signed_block& block );
 
    sophiatx::chain::signed_block generate_block( const fc::time_point_sec& when, const account_name_type& witness_owner,
@@ -63,23 +83,73 @@ public:
 
    int16_t set_write_lock_hold_time( int16_t new_time ) override;
 
+   write_queue_stats get_write_queue_stats() const override;
+
+   block_log_append_metrics get_block_log_append_metrics() const override;
+
+   block_cache_stats get_block_cache_stats() const override;
+
    void start_write_processing();
    void stop_write_processing();
 
+   /**
+    * Wraps the transactions into envelopes on the signature recovery thread pool, recovering their signing keys as
+    * well when recover_keys is set. When validation_errors is given, the transactions are pre-validated and the
+    * errors are stored at their positions. Called by accept_block() and accept_transactions() before the
+    * transactions enter the write queue. The envelopes are prepared on the calling thread while the pool is not
+    * running, before plugin_startup() and once stop_write_processing() has begun.
+    */
+   void prepare_transaction_envelopes( const std::vector< sophiatx::chain::signed_transaction >& trxs,
+                                       transaction_envelopes& envelopes, bool recover_keys,
+                                       std::vector< fc::optional< fc::exception > >* validation_errors = nullptr );
+
+   /**
+    * Runs the checks of a transaction that do not need the chain state: size limit, expiration bounds relative to the
+    * last seen head block time, duplicate signatures and operation validation. The signing keys and the validation
+    * result are remembered by the envelope, so the write thread does not compute them again.
+    */
+   void prevalidate_transaction( const transaction_envelope& trx )const;
+
 private:
+   /** Queues the request for the write thread and waits until it is processed, rethrowing its exception */
+   void push_write_request( write_context& cxt );
+
    bool                             replay = false;
    bool                             check_locks = false;
    bool                             validate_invariants = false;
+   uint32_t                         invariants_audit_interval = 0;
    bool                             dump_memory_details = false;
    uint32_t                         stop_replay_at = 0;
+   uint32_t                         replay_queue_size = 0;
+   uint32_t                         block_log_queue_size = 0;
+   bool                             block_log_compression = false;
+   uint64_t                         block_cache_size = 0;
+   bool                             block_log_transaction_index = false;
+   uint32_t                         custom_content_archive_age = 0;
+   uint64_t                         custom_content_memory_budget = 0;
+   bfs::path                        export_state_dir;
+   bfs::path                        import_state_dir;
    uint32_t                         benchmark_interval = 0;
    genesis_state_type               genesis;
+   chain_id_type                    chain_id;
    flat_map<uint32_t,block_id_type> loaded_checkpoints;
 
    int16_t                          write_lock_hold_time=500;
 
+   uint32_t                         write_queue_size = 1024;
    std::shared_ptr< std::thread >   write_processor_thread;
-   boost::lockfree::queue< write_context* > write_queue;
+   std::unique_ptr< util::bounded_queue< write_context* > > write_queue;
+   std::atomic< uint64_t >          write_requests{ 0 };
+   std::atomic< uint64_t >          write_queue_total_wait{ 0 };
+   std::atomic< uint64_t >          write_queue_max_wait{ 0 };
+   std::atomic< uint32_t >          head_block_time_sec{ 0 };   ///< head block time seen by the write thread, 0 before block 1
+
+   uint32_t                         signature_recovery_threads = 0;
+   boost::thread_group              signature_recovery_pool;
+   boost::asio::io_service          signature_recovery_ios;
+   std::unique_ptr< boost::asio::io_service::work > signature_recovery_work;
+   bool                             signature_recovery_running = false;
+   boost::shared_mutex              signature_recovery_mtx;     ///< held shared while work is posted to the pool
 
    // TODO: temporary solution. DELETE when proper solution is implemented -> shared config object, which will contain also initminer mining public key.
    public_key_type init_mining_pubkey;
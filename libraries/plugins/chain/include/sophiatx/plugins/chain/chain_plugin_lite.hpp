@@ -25,8 +25,10 @@ public:
 
    void plugin_shutdown() override;
 
+   std::vector<remote::remote_connection_stats> get_remote_connection_stats() const override;
+
 private:
-   string ws_endpoint;
+   vector<string> ws_endpoints;
    uint64_t app_id;
 };
 
@@ -47,6 +47,7 @@ class multiparty_messaging_plugin : public plugin< multiparty_messaging_plugin >
       virtual void plugin_shutdown() override;
 
       uint64_t app_id;
+      uint32_t shared_secret_cache_size = 10000;
       std::shared_ptr< class multiparty_messaging_api > api;
    private:
       std::shared_ptr< detail::multiparty_messaging_plugin_impl > _my;
@@ -10,6 +10,8 @@
 #include <fc/crypto/aes.hpp>
 #include <fc/io/raw.hpp>
 
+#include <list>
+
 namespace sophiatx { namespace plugins { namespace multiparty_messaging {
 
 namespace detail {
@@ -20,13 +22,15 @@ public:
    multiparty_messaging_plugin_impl( multiparty_messaging_plugin& _plugin ) :
          _db( _plugin.app()->get_plugin< sophiatx::plugins::chain::chain_plugin >().db() ),
          _self( _plugin ),
-         app_id(_plugin.app_id) { }
+         app_id(_plugin.app_id),
+         shared_secret_cache_size(_plugin.shared_secret_cache_size) { }
 
    virtual ~multiparty_messaging_plugin_impl(){}
    std::shared_ptr<database_interface>  _db;
    multiparty_messaging_plugin&  _self;
 
    uint64_t                      app_id;
+   uint32_t                      shared_secret_cache_size;
 
    virtual void apply( const protocol::custom_json_operation& op ) ;
    virtual void apply( const protocol::custom_binary_operation & op ) { };
@@ -35,6 +39,16 @@ private:
    template<typename T> void save_message(const group_object& go, const account_name_type sender, bool system_message, const T& data)const;
    fc::sha256 extract_key( const std::map<public_key_type, encrypted_key>& new_key_map, const fc::sha256& group_key, const fc::sha256& iv, const public_key_type& sender_key) const;
    const group_object* find_group(account_name_type name) const;
+
+   /// ECDH of the private key and the remote key, served from the cache of the recently used secrets
+   fc::sha512 get_shared_secret( const public_key_type& local_key, const fc::ecc::private_key& private_key, const public_key_type& remote_key ) const;
+
+   typedef std::pair< public_key_type, public_key_type >      shared_secret_key;   ///< local and remote key
+   typedef std::pair< shared_secret_key, fc::sha512 >         shared_secret_entry;
+
+   // messages are applied by the write thread only
+   mutable std::list< shared_secret_entry >                   _shared_secrets;     ///< most recently used first
+   mutable std::map< shared_secret_key, std::list< shared_secret_entry >::iterator > _shared_secret_index;
 };
 
 message_wrapper decode_message( const vector<char>& message, const fc::sha256& iv, const fc::sha256& key )
@@ -74,13 +88,35 @@ template<typename T> void multiparty_messaging_plugin_impl::save_message(const g
    });
 }
 
+fc::sha512 multiparty_messaging_plugin_impl::get_shared_secret( const public_key_type& local_key, const fc::ecc::private_key& private_key, const public_key_type& remote_key ) const
+{
+   shared_secret_key key( local_key, remote_key );
+   auto itr = _shared_secret_index.find( key );
+   if( itr != _shared_secret_index.end() ){
+      _shared_secrets.splice( _shared_secrets.begin(), _shared_secrets, itr->second );
+      return itr->second->second;
+   }
+
+   fc::sha512 secret = private_key.get_shared_secret( remote_key );
+   if( !shared_secret_cache_size )
+      return secret;
+
+   if( _shared_secrets.size() >= shared_secret_cache_size ){
+      _shared_secret_index.erase( _shared_secrets.back().first );
+      _shared_secrets.pop_back();
+   }
+   _shared_secrets.emplace_front( key, secret );
+   _shared_secret_index[ key ] = _shared_secrets.begin();
+   return secret;
+}
+
 fc::sha256 multiparty_messaging_plugin_impl::extract_key( const std::map<public_key_type, encrypted_key>& new_key_map, const fc::sha256& group_key, const fc::sha256& iv, const public_key_type& sender_key) const
 {
    //first look for shared secret key
    for( const auto& pk: _self._private_keys ){
       const auto &nkm_itr =  new_key_map.find(pk.first);
       if(  nkm_itr != new_key_map.end() ){
-         fc::sha512 sc = pk.second.get_shared_secret(sender_key);
+         fc::sha512 sc = get_shared_secret(pk.first, pk.second, sender_key);
          vector<char> key_data = fc::aes_decrypt( sc, nkm_itr->second );
          fc::sha256 key( key_data.data(), key_data.size());
          return key;
@@ -92,7 +128,7 @@ fc::sha256 multiparty_messaging_plugin_impl::extract_key( const std::map<public_
             nkm_itr++;
          if( nkm_itr== new_key_map.end() )
             continue;
-         fc::sha512 sc = pk.second.get_shared_secret(nkm_itr->first);
+         fc::sha512 sc = get_shared_secret(pk.first, pk.second, nkm_itr->first);
          vector<char> key_data = fc::aes_decrypt(sc, nkm_itr->second);
          fc::sha256 key(key_data.data(), key_data.size());
          return key;
@@ -168,9 +204,9 @@ void multiparty_messaging_plugin_impl::apply( const protocol::custom_json_operat
             auto pk_s = _self._private_keys.find(*message_meta.sender);
             fc::sha512 shared_secret;
             if( pk_r != _self._private_keys.end())
-               shared_secret = pk_r->second.get_shared_secret(*message_meta.sender);
+               shared_secret = get_shared_secret(pk_r->first, pk_r->second, *message_meta.sender);
             else if( pk_s != _self._private_keys.end())
-               shared_secret = pk_s->second.get_shared_secret(*message_meta.recipient);
+               shared_secret = get_shared_secret(pk_s->first, pk_s->second, *message_meta.recipient);
             else
                return;
 
@@ -211,6 +247,7 @@ void multiparty_messaging_plugin::set_program_options( options_description& cli,
          ("mpm-app-id", boost::program_options::value< uint64_t >()->default_value( 2 ), "App id used by the multiparty messaging" )
          ("mpm-account", boost::program_options::value<vector<string>>()->composing()->multitoken(), "Accounts tracked by the plugin. If not specified, tries to listen to all messages within the given app ID")
          ("mpm-private-key", bpo::value<vector<string>>()->composing()->multitoken(), "WIF MEMO PRIVATE KEY to be used by one or more tracked accounts" )
+         ("mpm-shared-secret-cache-size", boost::program_options::value< uint32_t >()->default_value( 10000 ), "Number of shared secrets of the private keys and the keys of the counterparties kept to spare their computation, 0 disables the cache" )
    ;
 }
 
@@ -223,6 +260,8 @@ void multiparty_messaging_plugin::plugin_initialize( const boost::program_option
       return;
    }
 
+   shared_secret_cache_size = options[ "mpm-shared-secret-cache-size" ].as< uint32_t >();
+
    _my = std::make_shared< detail::multiparty_messaging_plugin_impl >( *this );
    api = std::make_shared< multiparty_messaging_api >(*this);
 
@@ -29,6 +29,7 @@ public:
 
    void broadcast_block( const sophiatx::protocol::signed_block& block );
    void broadcast_transaction( const sophiatx::protocol::signed_transaction& tx );
+   void broadcast_transactions( const std::vector< sophiatx::protocol::signed_transaction >& trxs );
    void set_block_production( bool producing_blocks );
 
 private:
@@ -625,6 +625,12 @@ void p2p_plugin::broadcast_transaction( const sophiatx::protocol::signed_transac
    my->node->broadcast( graphene::net::trx_message( tx ) );
 }
 
+void p2p_plugin::broadcast_transactions( const std::vector< sophiatx::protocol::signed_transaction >& trxs )
+{
+   ulog("Broadcasting ${n} txs", ("n", trxs.size()));
+   my->node->broadcast_transactions( trxs );
+}
+
 void p2p_plugin::set_block_production( bool producing_blocks )
 {
    my->block_producer = producing_blocks;
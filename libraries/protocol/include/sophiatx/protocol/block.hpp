@@ -7,6 +7,8 @@ namespace sophiatx { namespace protocol {
    struct signed_block : public signed_block_header
    {
       checksum_type calculate_merkle_root()const;
+      /// Computes the merkle root of the block transactions from their merkle digests, in transaction order
+      static checksum_type calculate_merkle_root( vector< digest_type > merkle_digests );
       vector<signed_transaction> transactions;
    };
 
@@ -188,10 +188,12 @@
 #define SOPHIATX_SECONDS_PER_YEAR                (uint64_t(60*60*24*365ll))
 
 #define SOPHIATX_MAX_TRANSACTION_SIZE            (1024*8)
+#define SOPHIATX_MAX_BROADCAST_BATCH_SIZE        1000 /// transactions accepted by a single broadcast_transactions call
 #define SOPHIATX_MIN_BLOCK_SIZE_LIMIT            (SOPHIATX_MAX_TRANSACTION_SIZE*16)
 #define SOPHIATX_MAX_BLOCK_SIZE                  (SOPHIATX_MAX_TRANSACTION_SIZE * SOPHIATX_BLOCK_INTERVAL*2048)
 #define SOPHIATX_SOFT_MAX_BLOCK_SIZE             (20*1024*1024)
 #define SOPHIATX_MIN_BLOCK_SIZE                  115
+#define SOPHIATX_BLOCK_STATS_WINDOW              1000 /// number of recent blocks whose sizes and counts are kept in the state
 #define SOPHIATX_BLOCKS_PER_HOUR                 (60*60/SOPHIATX_BLOCK_INTERVAL)
 #define SOPHIATX_FEED_INTERVAL_BLOCKS            (SOPHIATX_BLOCKS_PER_HOUR)
 #define SOPHIATX_FEED_HISTORY_WINDOW             (12*7) // 3.5 days
@@ -1,12 +1,19 @@
 #ifndef SOPHIATX_REMOTE_DB_HPP
 #define SOPHIATX_REMOTE_DB_HPP
 
+#include <fc/crypto/base64.hpp>
+#include <fc/io/raw.hpp>
 #include <fc/reflect/reflect.hpp>
 #include <fc/variant.hpp>
 #include <fc/variant_object.hpp>
 #include <fc/rpc/websocket_api.hpp>
 #include <fc/network/http/websocket.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -24,6 +31,19 @@ struct received_object {
    fc::time_point_sec received;
 };
 
+/// app message pushed to packed subscriptions, binary data are not base64 encoded
+struct packed_received_object {
+   uint64_t sequence;
+   uint64_t id;
+   std::string sender;
+   std::vector<std::string> recipients;
+   uint64_t app_id;
+   bool binary;
+   std::vector<char> data;
+   std::string json;
+   fc::time_point_sec received;
+};
+
 struct get_app_custom_messages_args {
    uint64_t app_id;
    uint64_t start;
@@ -32,59 +52,289 @@ struct get_app_custom_messages_args {
 
 typedef std::map<uint64_t, received_object> get_app_custom_messages_return;
 
+struct custom_object_subscription_args {
+   uint64_t return_id;
+   uint32_t app_id;
+   std::string account_name;
+   std::string search_type;
+   uint64_t start;
+   bool packed;
+};
+
+/// state and latency of one connection of the pool
+struct remote_connection_stats {
+   std::string endpoint;
+   bool connected = false;
+   uint64_t calls = 0;
+   uint64_t failures = 0;           ///< calls which threw, including the ones lost with the connection
+   uint64_t reconnects = 0;
+   fc::microseconds last_latency;
+   fc::microseconds max_latency;
+   fc::microseconds total_latency;  ///< of all calls, the average is total_latency / calls
+};
+
+/**
+ * Client of the full node APIs, holding a pool of websocket connections with one connection per configured endpoint.
+ * An endpoint may be listed more than once for several connections to the same full node.
+ *
+ * Calls are spread round robin over the connected connections. Calls made from several threads are in flight at once,
+ * each connection matches the responses to the waiting calls by their ids. Lost connections are connected again by the
+ * next call or reconnect() once their backoff expires, the backoff doubles from 1 up to 64 seconds with every failed
+ * attempt.
+ */
 class remote_db {
 public:
-   inline static bool initialized() { return instance().remote_db_loaded_; }
-
-   inline static void init(const std::string &endpoint) {
-      FC_ASSERT(!instance().remote_db_loaded_, "remote_db already initialized!");
-      instance().connnection_ = instance().ws_client_.connect(endpoint);
-      instance().api_connection_ = std::make_shared<fc::rpc::websocket_api_connection>(*instance().connnection_);
-      instance().closed_connection_ = (instance().connnection_->closed.connect([ = ] {
-           elog("Server has disconnected us.");
-           instance().remote_db_loaded_ = false;
-      }));
-      instance().remote_db_loaded_ = true;
+   inline static bool initialized() { return instance().connected_ > 0; }
+
+   inline static void init(const std::vector<std::string> &endpoints) {
+      auto &self = instance();
+      FC_ASSERT(self.pool_.empty(), "remote_db already initialized!");
+      FC_ASSERT(!endpoints.empty(), "remote_db needs at least one endpoint!");
+
+      for( const auto &endpoint: endpoints ) {
+         self.pool_.emplace_back(new pooled_connection());
+         self.pool_.back()->stats.endpoint = endpoint;
+      }
+
+      self.connect_due();
+      FC_ASSERT(initialized(), "Cannot connect to any of the endpoints ${e}", ("e", endpoints));
+   }
+
+   /** Connects the lost connections whose backoff has expired, throws if none is connected */
+   inline static void reconnect() {
+      FC_ASSERT(!instance().pool_.empty(), "remote_db was never initialized!");
+      instance().connect_due();
+      FC_ASSERT(initialized(), "None of the remote_db endpoints is connected");
+   }
+
+   /**
+    * Subscribes to the messages of the app starting with the app message sequence start, replacing the previous
+    * subscription. The server pushes every message as it is applied, notify receives the fc::raw packed messages on
+    * the connection thread, they are read with unpack_app_custom_message().
+    *
+    * The subscription has a connection of its own to the endpoint of the next pooled connection. It ends with that
+    * connection, which is never connected again, see subscription_alive().
+    */
+   inline static void subscribe_app_custom_messages(uint64_t app_id, uint64_t start, const std::function<void(fc::variant)> &notify) {
+      auto &self = instance();
+      unsubscribe_app_custom_messages();
+
+      auto c = self.next_connection();
+      auto s = std::make_shared<subscription_connection>();
+      s->connection = s->ws_client.connect(c.pooled->stats.endpoint);
+      s->api_connection = std::make_shared<fc::rpc::websocket_api_connection>(*s->connection);
+      subscription_connection *p = s.get();
+      s->closed_connection = s->connection->closed.connect([ p ] { p->connected = false; });
+      s->connected = true;
+
+      custom_object_subscription_args args{ s->api_connection->register_callback(notify), static_cast<uint32_t>(app_id), "", "by_app", start, true };
+      s->api_connection->send_call("subscribe_api", "custom_object_subscription", true, {fc::variant(args)});
+
+      std::lock_guard<std::mutex> lock(self.mtx_);
+      self.subscription_ = s;
+   }
+
+   /**
+    * Ends the subscription by closing its connection, nothing is pushed once it returns. The full node drops the
+    * subscription when its next push fails.
+    */
+   inline static void unsubscribe_app_custom_messages() {
+      auto &self = instance();
+      std::shared_ptr<subscription_connection> s;
+      {
+         std::lock_guard<std::mutex> lock(self.mtx_);
+         s.swap(self.subscription_);
+      }
+      // the websocket client closes the connection and waits for it when destroyed
+      s.reset();
+   }
+
+   /// @return false once the connection of the last subscription is lost
+   inline static bool subscription_alive() {
+      auto &self = instance();
+      std::lock_guard<std::mutex> lock(self.mtx_);
+      return self.subscription_ && self.subscription_->connected;
+   }
+
+   /// reads a message pushed base64 encoded by subscribe_app_custom_messages()
+   inline static packed_received_object unpack_app_custom_message(const fc::variant &v) {
+      auto packed = fc::base64_decode(v.as_string());
+      return fc::raw::unpack_from_char_array<packed_received_object>(packed.data(), packed.size(), 0);
    }
 
    inline static fc::variant remote_call(const std::string &network_id, const std::string &api, const std::string call, const fc::variant &args) {
-      FC_ASSERT(instance().remote_db_loaded_, "remote_db is not initialized!");
-      return instance().api_connection_->send_call(network_id, api, call, args);
+      auto &self = instance();
+      auto c = self.next_connection();
+      return self.call(c, [ & ]() { return c.api_connection->send_call(network_id, api, call, args); });
+   }
+
+   /** Calls the method of the api of the full node with the arguments passed as an object */
+   inline static fc::variant remote_call(const std::string &api, const std::string call, const fc::variant &args) {
+      auto &self = instance();
+      auto c = self.next_connection();
+      return self.call(c, [ & ]() { return c.api_connection->send_call(api, call, true, {args}); });
    }
 
    inline static std::map<uint64_t, received_object>
    get_app_custom_messages(const get_app_custom_messages_args &args) {
-      FC_ASSERT(instance().remote_db_loaded_, "remote_db is not initialized!");
-      auto ret = instance().api_connection_->send_call("custom_api", "get_app_custom_messages", true, {fc::variant(args)});
+      auto &self = instance();
+      auto c = self.next_connection();
+      auto ret = self.call(c, [ & ]() { return c.api_connection->send_call("custom_api", "get_app_custom_messages", true, {fc::variant(args)}); });
       std::map<uint64_t, received_object> out;
       fc::from_variant(ret, out);
       return out;
    }
 
+   inline static std::vector<remote_connection_stats> get_connection_stats() {
+      auto &self = instance();
+      std::lock_guard<std::mutex> lock(self.mtx_);
+      std::vector<remote_connection_stats> result;
+      for( const auto &c: self.pool_ ) {
+         result.push_back(c->stats);
+         result.back().connected = c->connected;
+      }
+      return result;
+   }
+
    remote_db(remote_db const &) = delete;
 
    void operator=(remote_db const &) = delete;
 
 private:
-   remote_db() : remote_db_loaded_(false), connnection_(nullptr) {}
+   struct pooled_connection {
+      fc::http::websocket_client ws_client;
+      fc::http::websocket_connection_ptr connection;
+      std::shared_ptr<fc::rpc::websocket_api_connection> api_connection;
+      boost::signals2::scoped_connection closed_connection;
+      std::atomic<bool> connected{false};
+
+      fc::microseconds backoff;
+      fc::time_point retry_at;
+      remote_connection_stats stats;
+   };
+
+   /// connection used by a call, a reconnect replaces the pooled one while the call keeps its own
+   struct connection_ref {
+      pooled_connection *pooled = nullptr;
+      fc::http::websocket_connection_ptr connection;                      ///< outlives api_connection, which refers to it
+      std::shared_ptr<fc::rpc::websocket_api_connection> api_connection;
+   };
+
+   struct subscription_connection {
+      fc::http::websocket_client ws_client;
+      fc::http::websocket_connection_ptr connection;
+      std::shared_ptr<fc::rpc::websocket_api_connection> api_connection;
+      boost::signals2::scoped_connection closed_connection;
+      std::atomic<bool> connected{false};
+   };
+
+   remote_db() {}
    ~remote_db() {}
 
+   /** Connects the lost connections whose backoff has expired, a single thread connects at a time */
+   void connect_due() {
+      std::unique_lock<std::mutex> connecting(connect_mtx_, std::try_to_lock);
+      if( !connecting.owns_lock())
+         return;
+
+      for( auto &c: pool_ ) {
+         {
+            std::lock_guard<std::mutex> lock(mtx_);
+            if( c->connected || fc::time_point::now() < c->retry_at )
+               continue;
+         }
+
+         try {
+            auto connection = c->ws_client.connect(c->stats.endpoint);
+            auto api_connection = std::make_shared<fc::rpc::websocket_api_connection>(*connection);
+            pooled_connection *p = c.get();
+
+            std::lock_guard<std::mutex> lock(mtx_);
+            c->closed_connection = connection->closed.connect([ this, p ] {
+                 elog("Server ${e} has disconnected us.", ("e", p->stats.endpoint));
+                 std::lock_guard<std::mutex> lock(mtx_);
+                 if( p->connected.exchange(false))
+                    connected_--;
+            });
+            // the api connection refers to its websocket connection, it is replaced first
+            c->api_connection = api_connection;
+            c->connection = connection;
+            c->backoff = fc::microseconds();
+            if( c->stats.calls || c->stats.failures )
+               c->stats.reconnects++;
+            c->connected = true;
+            connected_++;
+         }
+         catch( const fc::exception &e ) {
+            std::lock_guard<std::mutex> lock(mtx_);
+            c->backoff = std::min(std::max(fc::microseconds(c->backoff.count() * 2), fc::seconds(1)), fc::seconds(64));
+            c->retry_at = fc::time_point::now() + c->backoff;
+            wlog("Cannot connect to ${ep}, next attempt in ${s}s: ${e}",
+                 ("ep", c->stats.endpoint)("s", c->backoff.count() / 1000000)("e", e.to_string()));
+         }
+      }
+   }
+
+   /// @return the next connected connection of the pool, connecting the lost ones which are due
+   connection_ref next_connection() {
+      FC_ASSERT(!pool_.empty(), "remote_db is not initialized!");
+      if( connected_ < pool_.size())
+         connect_due();
+
+      std::lock_guard<std::mutex> lock(mtx_);
+      for( size_t i = 0; i < pool_.size(); ++i ) {
+         auto &c = pool_[ next_++ % pool_.size() ];
+         if( c->connected )
+            return connection_ref{ c.get(), c->connection, c->api_connection };
+      }
+
+      FC_ASSERT(false, "None of the remote_db endpoints is connected");
+      return connection_ref();
+   }
+
+   template<typename Call>
+   fc::variant call(const connection_ref &c, Call &&send) {
+      auto start = fc::time_point::now();
+      try {
+         auto result = send();
+         auto latency = fc::time_point::now() - start;
+
+         std::lock_guard<std::mutex> lock(mtx_);
+         auto &stats = c.pooled->stats;
+         stats.calls++;
+         stats.last_latency = latency;
+         stats.max_latency = std::max(stats.max_latency, latency);
+         stats.total_latency += latency;
+         return result;
+      }
+      catch( ... ) {
+         std::lock_guard<std::mutex> lock(mtx_);
+         c.pooled->stats.failures++;
+         throw;
+      }
+   }
+
    inline static remote_db &instance() {
       static remote_db instance;
       return instance;
    }
 
-   bool remote_db_loaded_;
-   fc::http::websocket_client ws_client_;
-   fc::http::websocket_connection_ptr connnection_;
-   std::shared_ptr<fc::rpc::websocket_api_connection> api_connection_;
-   boost::signals2::scoped_connection closed_connection_;
+   std::vector<std::unique_ptr<pooled_connection>> pool_;    ///< fixed by init()
+   std::atomic<uint32_t> connected_{0};
+   std::shared_ptr<subscription_connection> subscription_;
+   uint64_t next_ = 0;
+
+   std::mutex mtx_;                                          ///< guards the connections, their stats and the subscription
+   std::mutex connect_mtx_;
 };
 
 }
 }
 
 FC_REFLECT(sophiatx::remote::received_object, (id)(sender)(recipients)(app_id)(data)(received)(binary))
+FC_REFLECT(sophiatx::remote::packed_received_object, (sequence)(id)(sender)(recipients)(app_id)(binary)(data)(json)(received))
 FC_REFLECT(sophiatx::remote::get_app_custom_messages_args, (app_id)(start)(limit))
+FC_REFLECT(sophiatx::remote::remote_connection_stats, (endpoint)(connected)(calls)(failures)(reconnects)(last_latency)(max_latency)(total_latency))
+FC_REFLECT(sophiatx::remote::custom_object_subscription_args, (return_id)(app_id)(account_name)(search_type)(start)(packed))
 
 #endif //SOPHIATX_REMOTE_DB_HPP
@@ -0,0 +1,65 @@
+#include <sophiatx/chain/block_log.hpp>
+
+#include <fc/exception/exception.hpp>
+#include <fc/filesystem.hpp>
+
+#include <iostream>
+#include <string>
+
+/**
+ * Rewrites a block log in the compressed (version 2) or the legacy (version 1) format. The source log is not modified,
+ * except for rebuilding its index when it is missing. The target must not exist yet.
+ */
+int main( int argc, char** argv, char** envp )
+{
+   try
+   {
+      if( argc < 3 || argc > 4 || ( argc == 4 && std::string( argv[3] ) != "--uncompressed" ) )
+      {
+         std::cerr << "Usage: " << argv[0] << " <source block_log> <target block_log> [--uncompressed]\n";
+         return 1;
+      }
+
+      fc::path source_file( argv[1] );
+      fc::path target_file( argv[2] );
+      bool compress = argc == 3;
+
+      FC_ASSERT( fc::exists( source_file ), "Source block log does not exist", ("file", source_file) );
+      FC_ASSERT( !fc::exists( target_file ), "Target block log already exists", ("file", target_file) );
+
+      sophiatx::chain::block_log source;
+      source.open( source_file, 0, false );
+      FC_ASSERT( source.head().valid(), "Source block log is empty" );
+
+      sophiatx::chain::block_log target;
+      target.open( target_file, 0, compress );
+
+      uint32_t head_num = source.head()->block_num();
+      std::cout << "Converting " << head_num << " blocks from version " << source.version()
+                << " to version " << target.version() << "\n";
+
+      uint64_t pos = source.get_block_pos( 1 );
+      for( uint32_t block_num = 1; block_num <= head_num; ++block_num )
+      {
+         auto itr = source.read_block( pos );
+         FC_ASSERT( itr.first.block_num() == block_num, "Unexpected block in source block log",
+            ("expected", block_num)("read", itr.first.block_num()) );
+         target.append( itr.first );
+         pos = itr.second;
+
+         if( block_num % 100000 == 0 )
+            std::cout << "   " << block_num << " of " << head_num << "\n";
+      }
+
+      target.flush();
+
+      std::cout << "Done, " << fc::file_size( source_file ) << " bytes converted to " << fc::file_size( target_file ) << " bytes\n";
+   }
+   catch( const fc::exception& e )
+   {
+      std::cerr << e.to_detail_string() << "\n";
+      return 1;
+   }
+
+   return 0;
+}
@@ -36,7 +36,7 @@ int main( int argc, char** argv, char** envp )
       idump( (log.head() ) );
       idump( (fc::raw::pack_size(b2)) );
 
-      auto r1 = log.read_block( 0 );
+      auto r1 = log.read_block( log.get_block_pos( 1 ) );
       idump( (r1) );
       idump( (fc::raw::pack_size(r1.first)) );
 
@@ -516,7 +516,10 @@ void database_fixture::fund(
          db->modify( db->get_dynamic_global_properties(), [&]( dynamic_global_property_object& gpo )
          {
             if( amount.symbol == SOPHIATX_SYMBOL )
+            {
                gpo.current_supply += amount;
+               gpo.total_account_balances += amount;
+            }
 
          });
 
@@ -680,6 +683,7 @@ void database_fixture::validate_database( void )
    try
    {
       db->validate_invariants();
+      db->audit_invariants();
    }
    FC_LOG_AND_RETHROW();
 }
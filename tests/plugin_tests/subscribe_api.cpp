@@ -0,0 +1,426 @@
+#include <boost/test/unit_test.hpp>
+#include <boost/program_options.hpp>
+
+#include <sophiatx/protocol/sophiatx_operations.hpp>
+#include <sophiatx/plugins/custom_api/custom_api.hpp>
+#include <sophiatx/plugins/subscribe_api/subscribe_api_plugin.hpp>
+#include <sophiatx/plugins/subscribe_api/subscribe_api.hpp>
+#include <sophiatx/remote_db/remote_db.hpp>
+
+#include "../db_fixture/database_fixture.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+
+using namespace sophiatx::chain;
+using namespace sophiatx::protocol;
+using namespace sophiatx::plugins;
+using namespace sophiatx::plugins::subscribe;
+
+/**
+ * Initializes the subscribe_api with a send queue of two documents and records the documents pushed to its
+ * subscriptions. The delivery thread can be held in its first notification to let the send queues fill up.
+ */
+struct subscribe_api_fixture : public json_rpc_database_fixture
+{
+   subscribe_api_fixture()
+   {
+      auto _plugin = app->get_register_plugin< subscribe_api_plugin >();
+      plugin = static_cast< subscribe_api_plugin* >( _plugin.get() );
+
+      boost::program_options::options_description cli, cfg;
+      subscribe_api_plugin::set_program_options( cli, cfg );
+      const char* argv[] = { "plugin_test", "--subscribe-send-queue-size=2" };
+      boost::program_options::variables_map options;
+      boost::program_options::store( boost::program_options::parse_command_line( 2, argv, cfg ), options );
+      boost::program_options::notify( options );
+      plugin->plugin_initialize( options );
+   }
+
+   ~subscribe_api_fixture()
+   {
+      // the delivery thread is stopped while the recorded documents still exist
+      release();
+      plugin->api.reset();
+   }
+
+   void subscribe( uint64_t return_id, uint32_t app_id, const string& account, const string& search_type, bool packed = false )
+   {
+      custom_object_subscription_args args;
+      args.return_id = return_id;
+      args.app_id = app_id;
+      args.account_name = account;
+      args.search_type = search_type;
+      args.start = 1;
+      args.packed = packed;
+
+      plugin->api->custom_object_subscription( args, [this]( fc::variant& v, uint64_t id ){ notify( v, id ); } );
+   }
+
+   void push_document( const string& sender, const fc::ecc::private_key& key, const string& recipient, uint32_t app_id, const string& json )
+   {
+      custom_json_operation op;
+      op.sender = sender;
+      op.recipients.insert( recipient );
+      op.app_id = app_id;
+      op.json = json;
+      op.fee = op.get_required_fee( SOPHIATX_SYMBOL );
+
+      signed_transaction tx;
+      tx.set_expiration( db->head_block_time() + SOPHIATX_MAX_TIME_UNTIL_EXPIRATION );
+      tx.operations.push_back( op );
+      sign( tx, key );
+      db->push_transaction( tx, 0 );
+   }
+
+   fc::optional< custom_object_subscription_stats > stats( uint64_t return_id )
+   {
+      for( const auto& s : plugin->api->get_subscription_stats( {} ) )
+         if( s.return_id == return_id )
+            return s;
+      return fc::optional< custom_object_subscription_stats >();
+   }
+
+   void notify( fc::variant& v, uint64_t return_id )
+   {
+      std::unique_lock< std::mutex > lock( mtx );
+      notifications++;
+      cv.notify_all();
+      cv.wait( lock, [this](){ return !blocked; } );
+
+      if( failing.count( return_id ) )
+         FC_THROW_EXCEPTION( fc::send_error_exception, "Connection closed" );
+
+      documents[ return_id ].push_back( v );
+   }
+
+   vector< fc::variant > pushed( uint64_t return_id )
+   {
+      std::lock_guard< std::mutex > lock( mtx );
+      return documents[ return_id ];
+   }
+
+   /// @return the content of the documents pushed to a subscription which is not packed
+   vector< string > received( uint64_t return_id )
+   {
+      vector< string > result;
+      for( const auto& v : pushed( return_id ) )
+         result.push_back( v.as< std::pair< uint64_t, custom::received_object > >().second.data );
+      return result;
+   }
+
+   template< typename Condition >
+   bool wait_for( Condition&& condition )
+   {
+      std::unique_lock< std::mutex > lock( mtx );
+      return cv.wait_for( lock, std::chrono::seconds( 10 ), condition );
+   }
+
+   /** Polls a condition depending on the delivery thread for up to ten seconds */
+   template< typename Condition >
+   bool eventually( Condition&& condition )
+   {
+      for( int i = 0; i < 1000; ++i )
+      {
+         if( condition() )
+            return true;
+         std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+      }
+      return condition();
+   }
+
+   bool wait_for_delivered( uint64_t return_id, uint64_t count )
+   {
+      return eventually( [&](){ auto s = stats( return_id ); return s.valid() && s->delivered == count; } );
+   }
+
+   void block()
+   {
+      std::lock_guard< std::mutex > lock( mtx );
+      blocked = true;
+   }
+
+   void release()
+   {
+      {
+         std::lock_guard< std::mutex > lock( mtx );
+         blocked = false;
+      }
+      cv.notify_all();
+   }
+
+   subscribe_api_plugin*                        plugin = nullptr;
+
+   std::mutex                                   mtx;
+   std::condition_variable                      cv;
+   bool                                         blocked = false;
+   uint32_t                                     notifications = 0;
+   std::set< uint64_t >                         failing;     ///< return ids of subscriptions whose sends fail
+   std::map< uint64_t, vector< fc::variant > >  documents;   ///< delivered documents by return id
+};
+
+BOOST_FIXTURE_TEST_SUITE( subscribe_api_tests, subscribe_api_fixture )
+
+BOOST_AUTO_TEST_CASE( subscription_fan_out )
+{
+   try
+   {
+      BOOST_TEST_MESSAGE( "Testing: subscription_fan_out" );
+
+      ACTORS( (alice)(bob) )
+      fund( AN("alice"), 10000000 );
+      fund( AN("bob"), 10000000 );
+
+      subscribe( 1, 1, "alice", "by_sender" );
+      subscribe( 2, 1, "bob", "by_recipient" );
+      subscribe( 3, 2, "alice", "by_sender" );
+      subscribe( 4, 1, "", "by_app" );
+      subscribe( 5, 1, "bob", "by_sender" );
+      subscribe( 6, 1, "alice", "by_recipient" );
+
+      push_document( "alice", alice_private_key, "bob", 1, "{\"document\":1}" );
+      push_document( "bob", bob_private_key, "alice", 1, "{\"document\":2}" );
+      push_document( "alice", alice_private_key, "bob", 2, "{\"document\":3}" );
+      generate_block();
+
+      BOOST_REQUIRE( wait_for_delivered( 4, 2 ) );
+      for( uint64_t id = 1; id <= 6; ++id )
+         if( id != 4 )
+            BOOST_REQUIRE( wait_for_delivered( id, 1 ) );
+
+      BOOST_REQUIRE( received( 1 ) == vector< string >{ "{\"document\":1}" } );
+      BOOST_REQUIRE( received( 2 ) == vector< string >{ "{\"document\":1}" } );
+      BOOST_REQUIRE( received( 3 ) == vector< string >{ "{\"document\":3}" } );
+      BOOST_REQUIRE( ( received( 4 ) == vector< string >{ "{\"document\":1}", "{\"document\":2}" } ) );
+      BOOST_REQUIRE( received( 5 ) == vector< string >{ "{\"document\":2}" } );
+      BOOST_REQUIRE( received( 6 ) == vector< string >{ "{\"document\":2}" } );
+
+      BOOST_TEST_MESSAGE( "--- Test documents are not pushed again by later blocks" );
+      generate_block();
+      push_document( "alice", alice_private_key, "bob", 2, "{\"document\":4}" );
+      generate_block();
+      BOOST_REQUIRE( wait_for_delivered( 3, 2 ) );
+      BOOST_REQUIRE_EQUAL( received( 1 ).size(), 1u );
+      BOOST_REQUIRE_EQUAL( received( 4 ).size(), 2u );
+      BOOST_REQUIRE_EQUAL( stats( 3 )->position, 2u );
+
+      validate_database();
+   }
+   FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE( subscription_lagging )
+{
+   try
+   {
+      BOOST_TEST_MESSAGE( "Testing: subscription_lagging" );
+
+      ACTORS( (alice)(bob) )
+      fund( AN("alice"), 10000000 );
+
+      block();
+      subscribe( 1, 1, "alice", "by_sender" );
+      for( int i = 1; i <= 5; ++i )
+         push_document( "alice", alice_private_key, "bob", 1, "{\"document\":" + std::to_string( i ) + "}" );
+      generate_block();
+
+      BOOST_TEST_MESSAGE( "--- Test a full send queue holds documents back" );
+      auto s = stats( 1 );
+      BOOST_REQUIRE( s.valid() );
+      BOOST_REQUIRE( s->lagging );
+      BOOST_REQUIRE_EQUAL( s->position, 2u );
+      BOOST_REQUIRE_EQUAL( s->lags, 1u );
+
+      // the delivery thread took the queue and is held in its first notification
+      BOOST_REQUIRE( wait_for( [this](){ return notifications == 1; } ) );
+      generate_block();
+      s = stats( 1 );
+      BOOST_REQUIRE( s->lagging );
+      BOOST_REQUIRE_EQUAL( s->position, 4u );
+      BOOST_REQUIRE_EQUAL( s->queued, 2u );
+      BOOST_REQUIRE_EQUAL( s->lags, 2u );
+
+      generate_block();
+      s = stats( 1 );
+      BOOST_REQUIRE( s->lagging );
+      BOOST_REQUIRE_EQUAL( s->position, 4u );
+      BOOST_REQUIRE_EQUAL( s->lags, 3u );
+
+      BOOST_TEST_MESSAGE( "--- Test the subscription resumes once the queue drains" );
+      release();
+      for( int i = 0; i < 20 && !wait_for_delivered( 1, 5 ); ++i )
+         generate_block();
+
+      vector< string > expected;
+      for( int i = 1; i <= 5; ++i )
+         expected.push_back( "{\"document\":" + std::to_string( i ) + "}" );
+      BOOST_REQUIRE( received( 1 ) == expected );
+
+      s = stats( 1 );
+      BOOST_REQUIRE( !s->lagging );
+      BOOST_REQUIRE_EQUAL( s->position, 5u );
+      BOOST_REQUIRE_EQUAL( s->queued, 0u );
+
+      validate_database();
+   }
+   FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE( subscription_send_error )
+{
+   try
+   {
+      BOOST_TEST_MESSAGE( "Testing: subscription_send_error" );
+
+      ACTORS( (alice)(bob) )
+      fund( AN("alice"), 10000000 );
+
+      {
+         std::lock_guard< std::mutex > lock( mtx );
+         failing.insert( 1 );
+      }
+      subscribe( 1, 1, "alice", "by_sender" );
+      subscribe( 2, 1, "alice", "by_sender" );
+
+      push_document( "alice", alice_private_key, "bob", 1, "{\"document\":1}" );
+      generate_block();
+
+      BOOST_REQUIRE( wait_for_delivered( 2, 1 ) );
+      BOOST_REQUIRE( eventually( [&](){ return !stats( 1 ).valid(); } ) );
+
+      BOOST_TEST_MESSAGE( "--- Test the remaining subscriber still receives documents" );
+      push_document( "alice", alice_private_key, "bob", 1, "{\"document\":2}" );
+      generate_block();
+      BOOST_REQUIRE( wait_for_delivered( 2, 2 ) );
+      BOOST_REQUIRE( received( 1 ).empty() );
+
+      validate_database();
+   }
+   FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE( packed_subscription )
+{
+   try
+   {
+      BOOST_TEST_MESSAGE( "Testing: packed_subscription" );
+
+      ACTORS( (alice)(bob)(sam) )
+      fund( AN("alice"), 10000000 );
+
+      subscribe( 1, 1, "", "by_app", true );
+
+      push_document( "alice", alice_private_key, "bob", 1, "{\"document\":1}" );
+
+      custom_binary_operation op;
+      op.sender = AN("alice");
+      op.recipients.insert( AN("bob") );
+      op.recipients.insert( AN("sam") );
+      op.app_id = 1;
+      op.data = { 0, 1, 2, char( 0xff ), 0 };
+      op.fee = op.get_required_fee( SOPHIATX_SYMBOL );
+
+      signed_transaction tx;
+      tx.set_expiration( db->head_block_time() + SOPHIATX_MAX_TIME_UNTIL_EXPIRATION );
+      tx.operations.push_back( op );
+      sign( tx, alice_private_key );
+      db->push_transaction( tx, 0 );
+      generate_block();
+
+      BOOST_REQUIRE( wait_for_delivered( 1, 2 ) );
+      auto documents = pushed( 1 );
+      BOOST_REQUIRE_EQUAL( documents.size(), 2u );
+
+      BOOST_TEST_MESSAGE( "--- Test the lite node reads the pushed documents" );
+      auto json = sophiatx::remote::remote_db::unpack_app_custom_message( documents[0] );
+      BOOST_REQUIRE_EQUAL( json.sequence, 1u );
+      BOOST_REQUIRE_EQUAL( json.sender, "alice" );
+      BOOST_REQUIRE( json.recipients == vector< string >{ "bob" } );
+      BOOST_REQUIRE_EQUAL( json.app_id, 1u );
+      BOOST_REQUIRE( !json.binary );
+      BOOST_REQUIRE_EQUAL( json.json, "{\"document\":1}" );
+      BOOST_REQUIRE( json.data.empty() );
+
+      auto binary = sophiatx::remote::remote_db::unpack_app_custom_message( documents[1] );
+      BOOST_REQUIRE_EQUAL( binary.sequence, 2u );
+      BOOST_REQUIRE( ( binary.recipients == vector< string >{ "bob", "sam" } ) );
+      BOOST_REQUIRE( binary.binary );
+      BOOST_REQUIRE( binary.data == op.data );
+      BOOST_REQUIRE( binary.json.empty() );
+      BOOST_REQUIRE_GT( binary.id, json.id );
+
+      // base64 of the packed document rather than its hex
+      auto packed = fc::raw::pack_to_vector( binary );
+      BOOST_REQUIRE_EQUAL( documents[1].as_string().size(), ( packed.size() + 2 ) / 3 * 4 );
+
+      validate_database();
+   }
+   FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE( subscribe_api_serialization )
+
+BOOST_AUTO_TEST_CASE( packed_document_layout )
+{
+   try
+   {
+      BOOST_TEST_MESSAGE( "Testing: packed_document_layout" );
+
+      // the full node packs packed_custom_document, lite nodes unpack it as remote::packed_received_object
+      packed_custom_document d;
+      d.sequence = 7;
+      d.id = 42;
+      d.sender = "alice";
+      d.recipients = { "bob", "sam" };
+      d.app_id = 3;
+      d.binary = true;
+      d.data = { 'a', 0, char( 0xff ) };
+      d.json = "{}";
+      d.received = fc::time_point_sec( 1500000000 );
+
+      auto packed = fc::raw::pack_to_vector( d );
+      auto r = fc::raw::unpack_from_vector< sophiatx::remote::packed_received_object >( packed, 0 );
+      BOOST_REQUIRE_EQUAL( r.sequence, d.sequence );
+      BOOST_REQUIRE_EQUAL( r.id, d.id );
+      BOOST_REQUIRE_EQUAL( r.sender, d.sender );
+      BOOST_REQUIRE( r.recipients == d.recipients );
+      BOOST_REQUIRE_EQUAL( r.app_id, d.app_id );
+      BOOST_REQUIRE_EQUAL( r.binary, d.binary );
+      BOOST_REQUIRE( r.data == d.data );
+      BOOST_REQUIRE_EQUAL( r.json, d.json );
+      BOOST_REQUIRE( r.received == d.received );
+      BOOST_REQUIRE( fc::raw::pack_to_vector( r ) == packed );
+   }
+   FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE( subscription_args_layout )
+{
+   try
+   {
+      BOOST_TEST_MESSAGE( "Testing: subscription_args_layout" );
+
+      // lite nodes send remote::custom_object_subscription_args, the full node reads custom_object_subscription_args
+      sophiatx::remote::custom_object_subscription_args remote_args{ 5, 3, "alice", "by_app", 11, true };
+      auto args = fc::variant( remote_args ).as< custom_object_subscription_args >();
+      BOOST_REQUIRE_EQUAL( args.return_id, remote_args.return_id );
+      BOOST_REQUIRE_EQUAL( args.app_id, remote_args.app_id );
+      BOOST_REQUIRE_EQUAL( args.account_name, remote_args.account_name );
+      BOOST_REQUIRE_EQUAL( args.search_type, remote_args.search_type );
+      BOOST_REQUIRE_EQUAL( args.start, remote_args.start );
+      BOOST_REQUIRE_EQUAL( args.packed, remote_args.packed );
+
+      fc::mutable_variant_object expected = fc::variant( args ).get_object();
+      fc::mutable_variant_object sent = fc::variant( remote_args ).get_object();
+      BOOST_REQUIRE_EQUAL( fc::json::to_string( sent ), fc::json::to_string( expected ) );
+   }
+   FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_SUITE_END()
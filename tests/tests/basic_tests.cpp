@@ -25,16 +25,22 @@
 #include <boost/test/unit_test.hpp>
 
 #include <sophiatx/chain/database/database_interface.hpp>
+#include <sophiatx/chain/database/database_exceptions.hpp>
+#include <sophiatx/chain/transaction_envelope.hpp>
+#include <sophiatx/chain/util/bounded_queue.hpp>
 #include <sophiatx/protocol/protocol.hpp>
 
 #include <sophiatx/protocol/sophiatx_operations.hpp>
 
+#include <sophiatx/plugins/chain/chain_plugin_full.hpp>
+
 #include <fc/crypto/digest.hpp>
 #include <fc/crypto/hex.hpp>
 #include "../db_fixture/database_fixture.hpp"
 
 #include <algorithm>
 #include <random>
+#include <thread>
 
 using namespace sophiatx;
 using namespace sophiatx::chain;
@@ -324,4 +330,152 @@ BOOST_AUTO_TEST_CASE( merkle_root )
    BOOST_CHECK( block.calculate_merkle_root() == c(dO) );
 }
 
+BOOST_AUTO_TEST_CASE( bounded_queue_test )
+{
+   sophiatx::chain::util::bounded_queue< uint32_t > queue( 4 );
+
+   std::thread producer( [&]()
+   {
+      for( uint32_t i = 1; i <= 100; ++i )
+         queue.push( i );
+      queue.close();
+   });
+
+   uint32_t expected = 1;
+   uint32_t item = 0;
+   while( queue.pop( item ) )
+   {
+      BOOST_CHECK_EQUAL( item, expected );
+      BOOST_CHECK( queue.size() <= queue.capacity() );
+      ++expected;
+   }
+   producer.join();
+
+   BOOST_CHECK_EQUAL( expected, 101u );
+   BOOST_CHECK( queue.is_closed() );
+   BOOST_CHECK( !queue.push( 1 ) );
+
+   sophiatx::chain::util::bounded_queue< uint32_t > batch( 4 );
+   BOOST_CHECK( !batch.try_pop( item ) );
+   batch.push( 1 );
+   batch.push( 2 );
+   BOOST_CHECK( batch.try_pop( item ) );
+   BOOST_CHECK_EQUAL( item, 1u );
+   BOOST_CHECK( batch.try_pop( item ) );
+   BOOST_CHECK_EQUAL( item, 2u );
+   BOOST_CHECK( !batch.try_pop( item ) );
+}
+
+BOOST_AUTO_TEST_CASE( transaction_envelope_test )
+{
+   chain_id_type chain_id = fc::sha256::hash( "transaction_envelope_test" );
+   fc::ecc::private_key alice_key = fc::ecc::private_key::regenerate( fc::sha256::hash( string( "alice" ) ) );
+   fc::ecc::private_key bob_key = fc::ecc::private_key::regenerate( fc::sha256::hash( string( "bob" ) ) );
+
+   signed_block block;
+   for( uint32_t i = 0; i < 5; i++ )
+   {
+      signed_transaction tx;
+      tx.ref_block_prefix = i;
+      tx.expiration = fc::time_point_sec( 1000 + i );
+      tx.sign( alice_key, chain_id, fc::ecc::fc_canonical );
+      if( i % 2 )
+         tx.sign( bob_key, chain_id, fc::ecc::fc_canonical );
+      block.transactions.push_back( tx );
+   }
+
+   auto envelopes = make_transaction_envelopes( block, chain_id );
+   BOOST_REQUIRE_EQUAL( envelopes.size(), block.transactions.size() );
+
+   for( size_t i = 0; i < envelopes.size(); i++ )
+   {
+      const auto& tx = block.transactions[i];
+      const auto& envelope = *envelopes[i];
+
+      BOOST_CHECK( envelope.id() == tx.id() );
+      BOOST_CHECK( envelope.sig_digest() == tx.sig_digest( chain_id ) );
+      BOOST_CHECK( envelope.merkle_digest() == tx.merkle_digest() );
+      BOOST_CHECK( envelope.packed() == fc::raw::pack_to_vector( tx ) );
+      BOOST_CHECK( !envelope.has_signature_keys() );
+      BOOST_CHECK( envelope.signature_keys() == tx.get_signature_keys( chain_id, fc::ecc::fc_canonical ) );
+      BOOST_CHECK( envelope.has_signature_keys() );
+   }
+
+   BOOST_CHECK( calculate_merkle_root( envelopes ) == block.calculate_merkle_root() );
+   BOOST_CHECK_EQUAL( packed_block_size( block, envelopes ), fc::raw::pack_size( block ) );
+   BOOST_CHECK( calculate_merkle_root( transaction_envelopes() ) == checksum_type() );
+
+   signed_transaction dup = block.transactions[0];
+   dup.signatures.push_back( dup.signatures[0] );
+   transaction_envelope dup_envelope( dup, chain_id );
+   SOPHIATX_REQUIRE_THROW( dup_envelope.signature_keys(), tx_duplicate_sig );
+
+   // the validation result is remembered, errors keep their type
+   const auto& no_ops_envelope = *envelopes[0];
+   BOOST_CHECK( !no_ops_envelope.is_validated() );
+   SOPHIATX_REQUIRE_THROW( no_ops_envelope.validate(), fc::assert_exception );
+   BOOST_CHECK( no_ops_envelope.is_validated() );
+   SOPHIATX_REQUIRE_THROW( no_ops_envelope.validate(), fc::assert_exception );
+
+   signed_transaction valid = block.transactions[0];
+   transfer_operation op;
+   op.from = "alice";
+   op.to = "bob";
+   op.amount = asset( 1, SOPHIATX_SYMBOL );
+   valid.operations.push_back( op );
+   transaction_envelope valid_envelope( valid, chain_id );
+   valid_envelope.validate();
+   BOOST_CHECK( valid_envelope.is_validated() );
+   valid_envelope.validate();
+}
+
+BOOST_AUTO_TEST_CASE( transaction_prevalidation_test )
+{
+   try
+   {
+      auto& chain = static_cast< sophiatx::plugins::chain::chain_plugin_full& >( app->get_plugin< sophiatx::plugins::chain::chain_plugin >() );
+      chain.start_write_processing();
+
+      // the write thread records the head block time for the checks of the submitting threads
+      chain.generate_block( db->get_slot_time( 1 ), db->get_scheduled_witness( 1 ), init_account_priv_key, database::skip_nothing );
+      uint64_t requests = chain.get_write_queue_stats().requests;
+      BOOST_REQUIRE_EQUAL( requests, 1u );
+
+      transfer_operation op;
+      op.from = SOPHIATX_INIT_MINER_NAME;
+      op.to = SOPHIATX_INIT_MINER_NAME;
+      op.fee = ASSET( "0.100000 SPHTX" );
+      op.amount = ASSET( "1.000000 SPHTX" );
+
+      BOOST_TEST_MESSAGE( "--- Rejecting an oversize transaction" );
+      signed_transaction oversize;
+      op.memo = std::string( SOPHIATX_MAX_TRANSACTION_SIZE, 'x' );
+      oversize.operations.push_back( op );
+      oversize.set_expiration( db->head_block_time() + SOPHIATX_MAX_TIME_UNTIL_EXPIRATION );
+      sign( oversize, init_account_priv_key );
+      SOPHIATX_REQUIRE_THROW( chain.accept_transaction( oversize ), fc::assert_exception );
+      op.memo.clear();
+
+      BOOST_TEST_MESSAGE( "--- Rejecting an expired transaction" );
+      signed_transaction expired;
+      expired.operations.push_back( op );
+      expired.set_expiration( db->head_block_time() );
+      sign( expired, init_account_priv_key );
+      SOPHIATX_REQUIRE_THROW( chain.accept_transaction( expired ), transaction_expiration_exception );
+
+      BOOST_TEST_MESSAGE( "--- Rejecting a transaction expiring too far in the future" );
+      signed_transaction future;
+      future.operations.push_back( op );
+      future.set_expiration( fc::time_point_sec( fc::time_point::now() ) + fc::days( 1 ) );
+      sign( future, init_account_priv_key );
+      SOPHIATX_REQUIRE_THROW( chain.accept_transaction( future ), transaction_expiration_exception );
+
+      // none of them took a slot in the write queue
+      BOOST_REQUIRE_EQUAL( chain.get_write_queue_stats().requests, requests );
+
+      chain.stop_write_processing();
+   }
+   FC_LOG_AND_RETHROW()
+}
+
 BOOST_AUTO_TEST_SUITE_END()
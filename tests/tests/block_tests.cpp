@@ -29,6 +29,8 @@
 #include <sophiatx/chain/database/database.hpp>
 #include <sophiatx/chain/sophiatx_objects.hpp>
 #include <sophiatx/chain/history_object.hpp>
+#include <sophiatx/chain/block_stats_object.hpp>
+#include <sophiatx/chain/custom_content_object.hpp>
 
 #include <sophiatx/plugins/account_history/account_history_plugin.hpp>
 #include <sophiatx/plugins/chain/chain_plugin_full.hpp>
@@ -39,6 +41,11 @@
 
 #include "../db_fixture/database_fixture.hpp"
 
+#include <atomic>
+#include <fstream>
+#include <functional>
+#include <thread>
+
 using namespace sophiatx;
 using namespace sophiatx::chain;
 using namespace sophiatx::protocol;
@@ -47,7 +54,8 @@ using namespace sophiatx::protocol;
 
 BOOST_AUTO_TEST_SUITE(block_tests)
 
-void open_test_database( const std::shared_ptr<database>& db, const fc::path& dir )
+void open_test_database( const std::shared_ptr<database>& db, const fc::path& dir,
+                         const std::function< void( database_interface::open_args& ) >& configure = {} )
 {
    fc::ecc::private_key init_account_priv_key = *(sophiatx::utilities::wif_to_key("5JPwY3bwFgfsGtxMeLkLqXzUrQDMAsqSyAZDnMBkg7PDDRhQgaV"));
    public_key_type init_account_pub_key = init_account_priv_key.get_public_key();
@@ -57,6 +65,8 @@ void open_test_database( const std::shared_ptr<database>& db, const fc::path& di
    database_interface::open_args args;
    args.shared_mem_dir = dir;
    args.shared_file_size = TEST_SHARED_MEM_SIZE;
+   if( configure )
+      configure( args );
    db->open( args, gen, public_key_type(init_account_pub_key) );
    db->modify( db->get_witness( "initminer" ), [&]( witness_object& a )
    {
@@ -69,6 +79,28 @@ void open_test_database( const std::shared_ptr<database>& db, const fc::path& di
    });
 }
 
+/**
+ * Builds a chain of blocks for the block log tests, fill adds the content of the i-th block before its successor
+ * links to it
+ */
+std::vector< signed_block > make_test_blocks( uint32_t count, const std::function< void( signed_block&, uint32_t ) >& fill = {} )
+{
+   std::vector< signed_block > blocks;
+   block_id_type previous;
+   for( uint32_t i = 0; i < count; ++i )
+   {
+      signed_block b;
+      b.previous = previous;
+      b.timestamp = fc::time_point_sec( SOPHIATX_BLOCK_INTERVAL * ( i + 1 ) );
+      b.witness = SOPHIATX_INIT_MINER_NAME;
+      if( fill )
+         fill( b, i );
+      blocks.push_back( b );
+      previous = b.id();
+   }
+   return blocks;
+}
+
 BOOST_AUTO_TEST_CASE( generate_empty_blocks )
 {
    try {
@@ -128,6 +160,583 @@ BOOST_AUTO_TEST_CASE( generate_empty_blocks )
    }
 }
 
+BOOST_AUTO_TEST_CASE( export_import_state )
+{
+   try {
+      fc::temp_directory data_dir( sophiatx::utilities::temp_directory_path() );
+      fc::temp_directory snapshot_dir( sophiatx::utilities::temp_directory_path() );
+      fc::ecc::private_key init_account_priv_key = *(sophiatx::utilities::wif_to_key("5JPwY3bwFgfsGtxMeLkLqXzUrQDMAsqSyAZDnMBkg7PDDRhQgaV"));
+
+      {
+         auto db = std::make_shared<database>();
+         db->_log_hardforks = false;
+         open_test_database( db, data_dir.path() );
+         while( db->get_dynamic_global_properties().last_irreversible_block_num < 50 )
+            db->generate_block( db->get_slot_time(1), db->get_scheduled_witness(1), init_account_priv_key, database::skip_nothing );
+         db->close();
+      }
+
+      uint32_t head_block_num = 0;
+      block_id_type head_block_id;
+      size_t account_count = 0;
+      asset current_supply;
+      {
+         auto db = std::make_shared<database>();
+         db->_log_hardforks = false;
+         open_test_database( db, data_dir.path() );
+         db->export_state( snapshot_dir.path() );
+         head_block_num = db->head_block_num();
+         head_block_id = db->head_block_id();
+         account_count = db->get_index< account_index >().indices().size();
+         current_supply = db->get_dynamic_global_properties().current_supply;
+         db->close();
+      }
+      {
+         // a corrupt snapshot is rejected and the current state is kept
+         fc::temp_directory corrupt_dir( sophiatx::utilities::temp_directory_path() );
+         for( fc::directory_iterator itr( snapshot_dir.path() ); itr != fc::directory_iterator(); ++itr )
+            fc::copy( *itr, corrupt_dir.path() / itr->filename() );
+         fc::path account_file = corrupt_dir.path() / "sophiatx__chain__account_object.bin";
+         BOOST_REQUIRE( fc::exists( account_file ) );
+         fc::resize_file( account_file, fc::file_size( account_file ) / 2 );
+
+         auto db = std::make_shared<database>();
+         db->_log_hardforks = false;
+
+         genesis_state_type gen;
+         gen.genesis_time = fc::time_point_sec(1530644400);
+         database_interface::open_args args;
+         args.shared_mem_dir = data_dir.path();
+         args.shared_file_size = TEST_SHARED_MEM_SIZE;
+
+         SOPHIATX_REQUIRE_THROW( db->import_state( args, corrupt_dir.path(), gen, init_account_priv_key.get_public_key() ), fc::exception );
+
+         db = std::make_shared<database>();
+         db->_log_hardforks = false;
+         open_test_database( db, data_dir.path() );
+         BOOST_CHECK( db->head_block_id() == head_block_id );
+         db->close();
+      }
+      {
+         auto db = std::make_shared<database>();
+         db->_log_hardforks = false;
+
+         genesis_state_type gen;
+         gen.genesis_time = fc::time_point_sec(1530644400);
+         database_interface::open_args args;
+         args.shared_mem_dir = data_dir.path();
+         args.shared_file_size = TEST_SHARED_MEM_SIZE;
+
+         BOOST_CHECK_EQUAL( db->import_state( args, snapshot_dir.path(), gen, init_account_priv_key.get_public_key() ), head_block_num );
+         BOOST_CHECK( db->head_block_id() == head_block_id );
+         BOOST_CHECK_EQUAL( db->get_index< account_index >().indices().size(), account_count );
+         BOOST_CHECK( db->get_dynamic_global_properties().current_supply == current_supply );
+         BOOST_CHECK( db->get_dynamic_global_properties().chain_id == gen.compute_chain_id() );
+         BOOST_CHECK( db->get_dynamic_global_properties().genesis_time == gen.genesis_time );
+         db->audit_invariants();
+         db->validate_invariants();
+
+         for( uint32_t i = 0; i < 5; ++i )
+            db->generate_block( db->get_slot_time(1), db->get_scheduled_witness(1), init_account_priv_key, database::skip_nothing );
+         BOOST_CHECK_EQUAL( db->head_block_num(), head_block_num + 5 );
+         db->close();
+      }
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( block_log_async_append )
+{
+   try {
+      fc::temp_directory data_dir( sophiatx::utilities::temp_directory_path() );
+      fc::path file = data_dir.path() / "block_log";
+      auto blocks = make_test_blocks( 100 );
+
+      {
+         block_log log;
+         log.open( file, 4 );
+
+         for( const auto& b : blocks )
+         {
+            log.append( b );
+
+            // blocks are readable as soon as they are appended, whether written or not
+            auto read = log.read_block_by_num( b.block_num() );
+            BOOST_REQUIRE( read.valid() && read->id() == b.id() );
+            BOOST_REQUIRE( log.durable_head_num() <= b.block_num() );
+         }
+
+         log.fence();
+         BOOST_REQUIRE_EQUAL( log.durable_head_num(), 100u );
+
+         auto metrics = log.get_append_metrics();
+         BOOST_CHECK_EQUAL( metrics.queue_depth, 0u );
+         BOOST_CHECK( metrics.max_queue_depth <= 4 );
+         BOOST_CHECK( metrics.sync_count > 0 );
+      }
+
+      BOOST_TEST_MESSAGE( "Reopening the block log synchronously" );
+      block_log log;
+      log.open( file );
+      BOOST_REQUIRE( log.head().valid() && log.head()->id() == blocks.back().id() );
+      for( const auto& b : blocks )
+      {
+         auto read = log.read_block_by_num( b.block_num() );
+         BOOST_REQUIRE( read.valid() && read->id() == b.id() );
+      }
+   }
+   FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE( block_log_sync_under_load )
+{
+   try {
+      fc::temp_directory data_dir( sophiatx::utilities::temp_directory_path() );
+      const uint32_t queue_size = 4;
+      const uint32_t max_unsynced_blocks = block_log::max_unsynced_blocks;
+      auto blocks = make_test_blocks( 5 * max_unsynced_blocks );
+
+      block_log log;
+      log.open( data_dir.path() / "block_log", queue_size );
+
+      // blocks are appended back to back, the writer keeps finding queued blocks and still has to sync. A block
+      // may wait in the queue, be taken by the writer or be written since the last sync.
+      for( const auto& b : blocks )
+      {
+         log.append( b );
+         BOOST_REQUIRE_GE( log.durable_head_num() + queue_size + 1 + max_unsynced_blocks, b.block_num() );
+      }
+
+      BOOST_REQUIRE_GE( log.get_append_metrics().sync_count, 4u );
+      log.fence();
+      BOOST_REQUIRE_EQUAL( log.durable_head_num(), blocks.back().block_num() );
+   }
+   FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE( block_log_versions )
+{
+   try {
+      fc::temp_directory data_dir( sophiatx::utilities::temp_directory_path() );
+      auto blocks = make_test_blocks( 50 );
+
+      auto check_log = [&]( block_log& log, uint32_t version )
+      {
+         BOOST_REQUIRE_EQUAL( log.version(), version );
+         BOOST_REQUIRE( log.head().valid() && log.head()->id() == blocks.back().id() );
+         BOOST_REQUIRE( log.read_head().id() == blocks.back().id() );
+
+         uint64_t pos = log.get_block_pos( 1 );
+         for( const auto& b : blocks )
+         {
+            auto read = log.read_block_by_num( b.block_num() );
+            BOOST_REQUIRE( read.valid() && read->id() == b.id() );
+
+            auto itr = log.read_block( pos );
+            BOOST_REQUIRE( itr.first.id() == b.id() );
+            pos = itr.second;
+         }
+      };
+
+      for( bool compress : { false, true } )
+      {
+         fc::path file = data_dir.path() / ( compress ? "compressed_log" : "legacy_log" );
+         uint32_t version = compress ? block_log::compressed_version : block_log::legacy_version;
+
+         {
+            block_log log;
+            log.open( file, 0, compress );
+            for( const auto& b : blocks )
+               log.append( b );
+            log.flush();
+            check_log( log, version );
+         }
+
+         BOOST_TEST_MESSAGE( "Reopening the block log with the other format requested keeps its format" );
+         {
+            block_log log;
+            log.open( file, 4, !compress );
+            check_log( log, version );
+         }
+
+         BOOST_TEST_MESSAGE( "Reconstructing the index" );
+         fc::remove_all( fc::path( file.generic_string() + ".index" ) );
+         block_log log;
+         log.open( file );
+         check_log( log, version );
+      }
+   }
+   FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE( block_log_transaction_index_lookup )
+{
+   try {
+      fc::temp_directory data_dir( sophiatx::utilities::temp_directory_path() );
+      fc::path file = data_dir.path() / "block_log";
+      fc::path index_file = data_dir.path() / "block_log.trx";
+      auto blocks = make_test_blocks( 20, []( signed_block& b, uint32_t i )
+      {
+         // every other block is empty
+         for( uint32_t t = 0; t < ( i % 2 ) * 3; ++t )
+         {
+            transfer_operation op;
+            op.from = SOPHIATX_INIT_MINER_NAME;
+            op.to = "alice";
+            op.amount = asset( i * 10 + t + 1, SOPHIATX_SYMBOL );
+            signed_transaction trx;
+            trx.operations.push_back( op );
+            trx.set_expiration( b.timestamp + SOPHIATX_MAX_TIME_UNTIL_EXPIRATION );
+            b.transactions.push_back( trx );
+         }
+      } );
+
+      auto check_index = [&]( const block_log_transaction_index& index, uint32_t head )
+      {
+         BOOST_REQUIRE_EQUAL( index.head_block_num(), head );
+         for( uint32_t i = 0; i < head; ++i )
+         {
+            for( uint32_t t = 0; t < blocks[i].transactions.size(); ++t )
+            {
+               const auto& trx = blocks[i].transactions[t];
+               auto found = index.read_transaction( trx.id() );
+               BOOST_REQUIRE( found.valid() );
+               BOOST_REQUIRE_EQUAL( found->location.block_num, i + 1 );
+               BOOST_REQUIRE_EQUAL( found->location.trx_in_block, t );
+               BOOST_REQUIRE( found->packed_trx == fc::raw::pack_to_vector( trx ) );
+            }
+         }
+         BOOST_REQUIRE( !index.find( transaction_id_type() ).valid() );
+      };
+
+      block_log log;
+      log.open( file );
+      for( uint32_t i = 0; i < 10; ++i )
+         log.append( blocks[i] );
+
+      {
+         block_log_transaction_index index;
+         index.open( index_file, log );
+         check_index( index, 10 );
+
+         for( uint32_t i = 10; i < 15; ++i )
+         {
+            log.append( blocks[i] );
+            index.append( blocks[i] );
+         }
+         check_index( index, 15 );
+      }
+
+      BOOST_TEST_MESSAGE( "Catching up with blocks appended while the index was closed" );
+      for( uint32_t i = 15; i < 20; ++i )
+         log.append( blocks[i] );
+      {
+         block_log_transaction_index index;
+         index.open( index_file, log );
+         check_index( index, 20 );
+      }
+
+      BOOST_TEST_MESSAGE( "Rebuilding a deleted hash table" );
+      fc::remove_all( fc::path( index_file.generic_string() + ".hash" ) );
+      {
+         block_log_transaction_index index;
+         index.open( index_file, log );
+         check_index( index, 20 );
+      }
+
+      BOOST_TEST_MESSAGE( "Rebuilding a deleted index" );
+      fc::remove_all( index_file );
+      block_log_transaction_index index;
+      index.open( index_file, log );
+      check_index( index, 20 );
+   }
+   FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE( block_log_concurrent_reads )
+{
+   try {
+      fc::temp_directory data_dir( sophiatx::utilities::temp_directory_path() );
+      fc::path file = data_dir.path() / "block_log";
+
+      block_log log;
+      log.open( file );
+
+      std::atomic< uint32_t > appended( 0 );
+      std::atomic< bool > done( false );
+      std::atomic< uint32_t > failures( 0 );
+
+      // readers do not take the block log lock and must always see complete blocks
+      std::thread reader( [&]()
+      {
+         while( !done.load() )
+         {
+            uint32_t num = appended.load();
+            if( num == 0 )
+               continue;
+
+            auto b = log.read_block_by_num( num );
+            if( !b.valid() || b->block_num() != num )
+               failures++;
+         }
+      } );
+
+      for( const auto& b : make_test_blocks( 500 ) )
+      {
+         log.append( b );
+         appended.store( b.block_num() );
+      }
+
+      done.store( true );
+      reader.join();
+      BOOST_REQUIRE_EQUAL( failures.load(), 0u );
+
+      auto pos = log.get_block_pos( 1 );
+      for( uint32_t num = 1; num <= 500; ++num )
+      {
+         auto result = log.read_block( pos );
+         BOOST_REQUIRE_EQUAL( result.first.block_num(), num );
+         pos = result.second;
+      }
+      BOOST_REQUIRE( !log.read_block_by_num( 501 ).valid() );
+   }
+   FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE( block_cache_eviction )
+{
+   try {
+      auto blocks = make_test_blocks( 4 );
+      // empty blocks differ only in their timestamps and ids, so they all have the same size
+      uint64_t block_size = fc::raw::pack_size( blocks[0] );
+      block_cache cache( 3 * block_size );
+
+      BOOST_REQUIRE( !cache.fetch_by_number( 1 ).valid() );
+      for( uint32_t i = 0; i < 3; ++i )
+         cache.insert( blocks[i] );
+
+      auto cached = cache.fetch_by_id( blocks[0].id() );
+      BOOST_REQUIRE( cached.valid() && cached->block_num() == 1 );
+
+      BOOST_TEST_MESSAGE( "Inserting a fourth block evicts the least recently used one" );
+      cache.insert( blocks[3] );
+      BOOST_REQUIRE( cache.fetch_by_number( 1 ).valid() );
+      BOOST_REQUIRE( !cache.fetch_by_number( 2 ).valid() );
+      BOOST_REQUIRE( !cache.fetch_by_id( blocks[1].id() ).valid() );
+      BOOST_REQUIRE( cache.fetch_by_id( blocks[3].id() ).valid() );
+
+      auto stats = cache.get_stats();
+      BOOST_CHECK_EQUAL( stats.hits, 3u );
+      BOOST_CHECK_EQUAL( stats.misses, 3u );
+      BOOST_CHECK_EQUAL( stats.size, 3u );
+      BOOST_CHECK_EQUAL( stats.bytes, 3 * block_size );
+
+      cache.set_capacity( 0 );
+      cache.insert( blocks[1] );
+      BOOST_CHECK_EQUAL( cache.get_stats().size, 0u );
+   }
+   FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE( custom_content_archive_append_read )
+{
+   try {
+      fc::temp_directory data_dir( sophiatx::utilities::temp_directory_path() );
+      fc::path file = data_dir.path() / "custom_content.archive";
+
+      std::vector< custom_content_payload > payloads( 2 );
+      payloads[0].all_recipients.push_back( "alice" );
+      payloads[0].json = "{\"document\":1}";
+      payloads[1].all_recipients.push_back( "bob" );
+      payloads[1].all_recipients.push_back( "sam" );
+      payloads[1].binary = true;
+      payloads[1].data = { 'a', 'b', 'c' };
+
+      std::vector< std::pair< uint64_t, uint32_t > > positions;
+      auto check_payloads = [&]( const custom_content_archive& archive )
+      {
+         for( size_t i = 0; i < positions.size(); ++i )
+         {
+            auto payload = fc::raw::unpack_from_vector< custom_content_payload >( archive.read( positions[i].first, positions[i].second ), 0 );
+            BOOST_REQUIRE( payload.all_recipients == payloads[i].all_recipients );
+            BOOST_REQUIRE_EQUAL( payload.binary, payloads[i].binary );
+            BOOST_REQUIRE( payload.data == payloads[i].data );
+            BOOST_REQUIRE_EQUAL( payload.json, payloads[i].json );
+         }
+      };
+
+      {
+         custom_content_archive archive;
+         archive.open( file );
+         for( const auto& p : payloads )
+         {
+            auto packed = fc::raw::pack_to_vector( p );
+            positions.emplace_back( archive.append( packed ), packed.size() );
+         }
+         check_payloads( archive );
+         SOPHIATX_REQUIRE_THROW( archive.read( archive.size(), 1 ), fc::exception );
+      }
+
+      BOOST_TEST_MESSAGE( "Reading payloads after reopening the archive" );
+      {
+         custom_content_archive archive;
+         archive.open( file );
+         check_payloads( archive );
+      }
+
+      BOOST_TEST_MESSAGE( "A file which is not an archive is not opened" );
+      {
+         std::ofstream out( ( data_dir.path() / "other" ).generic_string() );
+         out << "not a custom content archive";
+      }
+      custom_content_archive archive;
+      SOPHIATX_REQUIRE_THROW( archive.open( data_dir.path() / "other" ), fc::exception );
+   }
+   FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE( custom_content_archive_policy )
+{
+   try {
+      fc::temp_directory data_dir( sophiatx::utilities::temp_directory_path() );
+      fc::ecc::private_key init_account_priv_key = *(sophiatx::utilities::wif_to_key("5JPwY3bwFgfsGtxMeLkLqXzUrQDMAsqSyAZDnMBkg7PDDRhQgaV"));
+      std::shared_ptr< database > db;
+
+      auto open = [&]( uint32_t age, uint64_t budget )
+      {
+         if( db )
+            db->close();
+         db = std::make_shared< database >();
+         db->_log_hardforks = false;
+         open_test_database( db, data_dir.path(), [&]( database_interface::open_args& args )
+         {
+            args.custom_content_archive_age = age;
+            args.custom_content_memory_budget = budget;
+         } );
+      };
+
+      auto generate_block = [&]()
+      {
+         db->generate_block( db->get_slot_time(1), db->get_scheduled_witness(1), init_account_priv_key, database::skip_nothing );
+      };
+
+      // documents of equal size, so the budget maps to a number of payloads
+      uint32_t documents = 0;
+      auto push_documents = [&]( uint32_t count )
+      {
+         while( count )
+         {
+            signed_transaction tx;
+            for( ; count && tx.operations.size() < 50; --count, ++documents )
+            {
+               custom_json_operation op;
+               op.sender = SOPHIATX_INIT_MINER_NAME;
+               op.recipients.insert( SOPHIATX_INIT_MINER_NAME );
+               op.app_id = 1;
+               op.json = "{\"document\":" + std::to_string( 100000 + documents ) + "}";
+               op.fee = op.get_required_fee( SOPHIATX_SYMBOL );
+               tx.operations.push_back( op );
+            }
+            tx.set_expiration( db->head_block_time() + SOPHIATX_MAX_TIME_UNTIL_EXPIRATION );
+            tx.sign( init_account_priv_key, db->get_chain_id(), fc::ecc::fc_canonical );
+            db->push_transaction( tx, 0 );
+            generate_block();
+         }
+      };
+
+      auto generate_irreversible = [&]()
+      {
+         uint32_t head = db->head_block_num();
+         while( db->get_dynamic_global_properties().last_irreversible_block_num < head )
+            generate_block();
+      };
+
+      auto storage = [&]() -> const custom_content_storage_object& { return db->get< custom_content_storage_object >(); };
+
+      auto check_payloads = [&]()
+      {
+         const auto& idx = db->get_index< custom_content_index, by_app_id >();
+         uint32_t checked = 0;
+         for( auto itr = idx.lower_bound( uint64_t( 1 ) ); itr != idx.end() && itr->app_id == 1; ++itr, ++checked )
+         {
+            // the sequence is 1 based, the documents are numbered from 0
+            auto payload = db->get_custom_content_payload( db->get( itr->payload ) );
+            BOOST_REQUIRE_EQUAL( payload.json, "{\"document\":" + std::to_string( 100000 + itr->app_message_sequence - 1 ) + "}" );
+            BOOST_REQUIRE( payload.all_recipients.size() == 1 && payload.all_recipients[0] == SOPHIATX_INIT_MINER_NAME );
+         }
+         BOOST_REQUIRE_EQUAL( checked, documents );
+      };
+
+      open( 0, 0 );
+      push_documents( 1200 );
+      generate_irreversible();
+      BOOST_REQUIRE_EQUAL( storage().archived_payloads, 0u );
+      uint64_t payload_size = storage().memory_size / 1200;
+      BOOST_REQUIRE_EQUAL( storage().memory_size, 1200 * payload_size );
+
+      // a block hands the payloads to the archive writer, the first block after they are on disk archives them
+      auto generate_archiving_block = [&]()
+      {
+         db->fence_custom_content_archive();
+         generate_block();
+      };
+
+      BOOST_TEST_MESSAGE( "Archiving over the memory budget, at most 1000 payloads per block" );
+      open( 0, 100 * payload_size );
+      generate_block();
+      BOOST_REQUIRE_EQUAL( storage().archived_payloads, 0u );
+      generate_archiving_block();
+      BOOST_REQUIRE_EQUAL( storage().archived_payloads, 1000u );
+      BOOST_REQUIRE_EQUAL( storage().memory_size, 200 * payload_size );
+      generate_archiving_block();
+      BOOST_REQUIRE_EQUAL( storage().archived_payloads, 1100u );
+      BOOST_REQUIRE_EQUAL( storage().memory_size, 100 * payload_size );
+      generate_archiving_block();
+      BOOST_REQUIRE_EQUAL( storage().archived_payloads, 1100u );
+      check_payloads();
+
+      BOOST_TEST_MESSAGE( "Archiving again after popping the archiving block reuses the written payloads" );
+      uint64_t archive_size = fc::file_size( data_dir.path() / "custom_content.archive" );
+      db->pop_block();
+      db->pop_block();
+      db->clear_pending();
+      BOOST_REQUIRE_EQUAL( storage().archived_payloads, 1000u );
+      generate_block();
+      BOOST_REQUIRE_EQUAL( storage().archived_payloads, 1100u );
+      BOOST_REQUIRE_EQUAL( fc::file_size( data_dir.path() / "custom_content.archive" ), archive_size );
+      generate_irreversible();
+      check_payloads();
+
+      BOOST_TEST_MESSAGE( "Reading archived payloads after reopening the database" );
+      open( 0, 0 );
+      check_payloads();
+
+      BOOST_TEST_MESSAGE( "Archiving by age once the payloads are irreversible" );
+      const uint32_t age = 5;
+      open( age, 0 );
+      generate_block();
+      generate_archiving_block();
+      BOOST_REQUIRE_EQUAL( storage().archived_payloads, 1200u );
+
+      push_documents( 1 );
+      uint32_t block_num = db->head_block_num();
+      while( db->head_block_num() < block_num + age - 1 )
+         generate_block();
+      BOOST_REQUIRE_EQUAL( storage().archived_payloads, 1200u );
+      generate_irreversible();
+      generate_block();
+      generate_archiving_block();
+      BOOST_REQUIRE_EQUAL( storage().archived_payloads, 1201u );
+      BOOST_REQUIRE_EQUAL( storage().memory_size, 0u );
+      check_payloads();
+
+      db->close();
+   }
+   FC_LOG_AND_RETHROW()
+}
+
 BOOST_AUTO_TEST_CASE( undo_block )
 {
    try {
@@ -573,6 +1182,181 @@ BOOST_FIXTURE_TEST_CASE( pop_block_twice, clean_database_fixture )
    }
 }
 
+BOOST_FIXTURE_TEST_CASE( block_stats_window, clean_database_fixture )
+{
+   try
+   {
+      ACTORS( (alice)(bob) )
+      fund( AN("alice"), 10000000 );
+      generate_block();
+
+      transfer_operation op;
+      op.from = AN("alice");
+      op.to = AN("bob");
+      op.amount = ASSET( "1.000000 SPHTX" );
+      op.fee = ASSET( "0.100000 SPHTX" );
+      signed_transaction tx;
+      tx.operations.push_back( op );
+      tx.operations.push_back( op );
+      tx.set_expiration( db->head_block_time() + SOPHIATX_MAX_TIME_UNTIL_EXPIRATION );
+      sign( tx, alice_private_key );
+      db->push_transaction( tx, 0 );
+      generate_blocks( 5 );
+
+      auto check_window = [&]()
+      {
+         uint64_t total_size = 0, total_transactions = 0, total_operations = 0;
+         for( uint32_t block_num = 1; block_num <= db->head_block_num(); block_num++ )
+         {
+            auto b = db->fetch_block_by_number( block_num );
+            BOOST_REQUIRE( b.valid() );
+            total_size += fc::raw::pack_size( *b );
+            total_transactions += b->transactions.size();
+            for( const auto& trx : b->transactions )
+               total_operations += trx.operations.size();
+         }
+
+         const auto& window = db->get< block_stats_window_object >();
+         BOOST_REQUIRE_EQUAL( window.blocks, db->head_block_num() );
+         BOOST_REQUIRE_EQUAL( window.total_size, total_size );
+         BOOST_REQUIRE_EQUAL( window.total_transactions, total_transactions );
+         BOOST_REQUIRE_EQUAL( window.total_operations, total_operations );
+      };
+
+      check_window();
+      BOOST_REQUIRE( db->get< block_stats_window_object >().total_operations >= 2 );
+
+      BOOST_TEST_MESSAGE( "Popping a block reverts its stats" );
+      db->pop_block();
+      db->clear_pending();
+      check_window();
+   }
+   FC_LOG_AND_RETHROW()
+}
+
+BOOST_FIXTURE_TEST_CASE( pending_transactions_left_out, clean_database_fixture )
+{
+   try
+   {
+      ACTORS( (alice)(bob)(charlie)(dave) )
+      fund( AN("alice"), 10000000 );
+      fund( AN("bob"), 10000000 );
+      fund( AN("charlie"), 10000000 );
+      generate_block();
+      auto bob_balance = db->get_balance( AN("bob"), SOPHIATX_SYMBOL );
+      auto dave_balance = db->get_balance( AN("dave"), SOPHIATX_SYMBOL );
+
+      BOOST_TEST_MESSAGE( "Pushing a transaction expiring before the next block, one depending on it and an unrelated one" );
+
+      transfer_operation op;
+      op.from = AN("alice");
+      op.to = AN("bob");
+      op.amount = ASSET( "1.000000 SPHTX" );
+      op.fee = ASSET( "0.100000 SPHTX" );
+      signed_transaction expiring_tx;
+      expiring_tx.operations.push_back( op );
+      expiring_tx.set_expiration( db->head_block_time() + SOPHIATX_BLOCK_INTERVAL );
+      sign( expiring_tx, alice_private_key );
+      db->push_transaction( expiring_tx, 0 );
+
+      // bob can only afford this with the funds from the expiring transaction
+      op.from = AN("bob");
+      op.to = AN("alice");
+      op.amount = ASSET( "10.500000 SPHTX" );
+      signed_transaction dependent_tx;
+      dependent_tx.operations.push_back( op );
+      dependent_tx.set_expiration( db->head_block_time() + SOPHIATX_MAX_TIME_UNTIL_EXPIRATION );
+      sign( dependent_tx, bob_private_key );
+      db->push_transaction( dependent_tx, 0 );
+
+      op.from = AN("charlie");
+      op.to = AN("dave");
+      op.amount = ASSET( "1.000000 SPHTX" );
+      signed_transaction unrelated_tx;
+      unrelated_tx.operations.push_back( op );
+      unrelated_tx.set_expiration( db->head_block_time() + SOPHIATX_MAX_TIME_UNTIL_EXPIRATION );
+      sign( unrelated_tx, charlie_private_key );
+      db->push_transaction( unrelated_tx, 0 );
+
+      BOOST_REQUIRE_EQUAL( db->_pending_tx.size(), 3u );
+
+      BOOST_TEST_MESSAGE( "Generating a block after the first transaction expired" );
+      generate_block( 0, init_account_priv_key, 1 );
+
+      auto block = db->fetch_block_by_number( db->head_block_num() );
+      BOOST_REQUIRE( block.valid() );
+      BOOST_REQUIRE_EQUAL( block->transactions.size(), 1u );
+      BOOST_REQUIRE( block->transactions[0].id() == unrelated_tx.id() );
+      BOOST_REQUIRE( db->get_balance( AN("bob"), SOPHIATX_SYMBOL ) == bob_balance );
+      BOOST_REQUIRE( db->get_balance( AN("dave"), SOPHIATX_SYMBOL ) == dave_balance + ASSET( "1.000000 SPHTX" ) );
+      BOOST_REQUIRE( db->_pending_tx.empty() );
+
+      validate_database();
+   }
+   FC_LOG_AND_RETHROW()
+}
+
+BOOST_FIXTURE_TEST_CASE( pending_transactions_left_out_sponsor, clean_database_fixture )
+{
+   try
+   {
+      ACTORS( (alice)(bob)(charlie)(sam) )
+      fund( AN("alice"), 100000000 );
+      fund( AN("bob"), 10000000 );
+
+      sponsor_fees_operation sponsor_op;
+      sponsor_op.sponsor = AN("sam");
+      sponsor_op.sponsored = AN("bob");
+      sponsor_op.is_sponsoring = true;
+      signed_transaction tx;
+      tx.operations.push_back( sponsor_op );
+      tx.set_expiration( db->head_block_time() + SOPHIATX_MAX_TIME_UNTIL_EXPIRATION );
+      sign( tx, sam_private_key );
+      db->push_transaction( tx, 0 );
+      generate_block();
+
+      BOOST_TEST_MESSAGE( "Pushing a transaction funding the sponsor, expiring before the next block, and a sponsored one" );
+
+      // sam can only pay the fee of bob's transfer with the funds from the expiring transaction
+      asset fee = db->get_balance( AN("sam"), SOPHIATX_SYMBOL ) + ASSET( "0.100000 SPHTX" );
+
+      transfer_operation op;
+      op.from = AN("alice");
+      op.to = AN("sam");
+      op.amount = fee;
+      op.fee = ASSET( "0.100000 SPHTX" );
+      signed_transaction expiring_tx;
+      expiring_tx.operations.push_back( op );
+      expiring_tx.set_expiration( db->head_block_time() + SOPHIATX_BLOCK_INTERVAL );
+      sign( expiring_tx, alice_private_key );
+      db->push_transaction( expiring_tx, 0 );
+
+      op.from = AN("bob");
+      op.to = AN("charlie");
+      op.amount = ASSET( "1.000000 SPHTX" );
+      op.fee = fee;
+      signed_transaction sponsored_tx;
+      sponsored_tx.operations.push_back( op );
+      sponsored_tx.set_expiration( db->head_block_time() + SOPHIATX_MAX_TIME_UNTIL_EXPIRATION );
+      sign( sponsored_tx, bob_private_key );
+      db->push_transaction( sponsored_tx, 0 );
+
+      BOOST_REQUIRE_EQUAL( db->_pending_tx.size(), 2u );
+
+      BOOST_TEST_MESSAGE( "Generating a block after the first transaction expired" );
+      generate_block( 0, init_account_priv_key, 1 );
+
+      auto block = db->fetch_block_by_number( db->head_block_num() );
+      BOOST_REQUIRE( block.valid() );
+      BOOST_REQUIRE( block->transactions.empty() );
+      BOOST_REQUIRE( db->get_balance( AN("charlie"), SOPHIATX_SYMBOL ) == ASSET( "0.000000 SPHTX" ) );
+      BOOST_REQUIRE( db->_pending_tx.empty() );
+
+      validate_database();
+   }
+   FC_LOG_AND_RETHROW()
+}
+
 BOOST_FIXTURE_TEST_CASE( rsf_missed_blocks, clean_database_fixture )
 {
    try
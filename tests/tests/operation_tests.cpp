@@ -8,6 +8,7 @@
 #include <sophiatx/chain/database/database_exceptions.hpp>
 #include <sophiatx/chain/sophiatx_objects.hpp>
 #include <sophiatx/chain/application_object.hpp>
+#include <sophiatx/chain/custom_content_object.hpp>
 
 #include <sophiatx/plugins/witness/witness_objects.hpp>
 
@@ -1490,6 +1491,94 @@ BOOST_AUTO_TEST_CASE( custom_binary_authorities )
    BOOST_REQUIRE( auths == expected );
 }*/
 
+BOOST_AUTO_TEST_CASE( custom_json_apply )
+{
+   try
+   {
+      BOOST_TEST_MESSAGE( "Testing: custom_json_apply" );
+
+      ACTORS( (alice)(bob)(sam) )
+      fund( AN("alice"), 10000000 );
+
+      custom_json_operation op;
+      op.sender = AN("alice");
+      op.recipients.insert( AN("bob") );
+      op.recipients.insert( AN("sam") );
+      op.app_id = 1;
+      op.json = "{\"document\":1}";
+      op.fee = op.get_required_fee( SOPHIATX_SYMBOL );
+
+      signed_transaction tx;
+      tx.set_expiration( db->head_block_time() + SOPHIATX_MAX_TIME_UNTIL_EXPIRATION );
+      tx.operations.push_back( op );
+      sign( tx, alice_private_key );
+      db->push_transaction( tx, 0 );
+
+      BOOST_TEST_MESSAGE( "--- Test the payload is stored once for all recipients" );
+      const auto& payload_idx = db->get_index< custom_content_payload_index, by_id >();
+      BOOST_REQUIRE_EQUAL( payload_idx.size(), 1u );
+      const auto& payload = *payload_idx.begin();
+      BOOST_REQUIRE( !payload.binary );
+      BOOST_REQUIRE_EQUAL( to_string( payload.json ), op.json );
+      BOOST_REQUIRE_EQUAL( payload.all_recipients.size(), 2u );
+
+      const auto& content_idx = db->get_index< custom_content_index, by_recipient >();
+      for( const auto& r : op.recipients )
+      {
+         auto itr = content_idx.lower_bound( boost::make_tuple( r, op.app_id, uint64_t(-1) ) );
+         BOOST_REQUIRE( itr != content_idx.end() && itr->recipient == r );
+         BOOST_REQUIRE( itr->payload == payload.id );
+         BOOST_REQUIRE( itr->sender == AN("alice") );
+         BOOST_REQUIRE_EQUAL( itr->recipient_sequence, 1u );
+         BOOST_REQUIRE_EQUAL( itr->sender_sequence, 1u );
+         BOOST_REQUIRE_EQUAL( itr->app_message_sequence, 1u );
+      }
+
+      BOOST_TEST_MESSAGE( "--- Test sequence counters of a following message" );
+      op.recipients.erase( AN("sam") );
+      op.fee = op.get_required_fee( SOPHIATX_SYMBOL );
+      tx.clear();
+      tx.set_expiration( db->head_block_time() + SOPHIATX_MAX_TIME_UNTIL_EXPIRATION );
+      tx.operations.push_back( op );
+      sign( tx, alice_private_key );
+      db->push_transaction( tx, 0 );
+
+      auto itr = content_idx.lower_bound( boost::make_tuple( AN("bob"), op.app_id, uint64_t(-1) ) );
+      BOOST_REQUIRE( itr != content_idx.end() && itr->recipient == AN("bob") );
+      BOOST_REQUIRE_EQUAL( itr->recipient_sequence, 2u );
+      BOOST_REQUIRE_EQUAL( itr->sender_sequence, 2u );
+      BOOST_REQUIRE_EQUAL( itr->app_message_sequence, 2u );
+
+      const auto& sequence_idx = db->get_index< custom_content_sequence_index, by_sequence_key >();
+      BOOST_REQUIRE_EQUAL( sequence_idx.size(), 4u );
+      auto sam_sequence = sequence_idx.find( boost::make_tuple( uint8_t( custom_content_sequence_object::recipient_sequence ), AN("sam"), op.app_id ) );
+      BOOST_REQUIRE( sam_sequence != sequence_idx.end() );
+      BOOST_REQUIRE_EQUAL( sam_sequence->sequence, 1u );
+
+      BOOST_TEST_MESSAGE( "--- Test a message without recipients takes no sequence and stores no payload" );
+      op.recipients.clear();
+      op.fee = op.get_required_fee( SOPHIATX_SYMBOL );
+      tx.clear();
+      tx.set_expiration( db->head_block_time() + SOPHIATX_MAX_TIME_UNTIL_EXPIRATION );
+      tx.operations.push_back( op );
+      sign( tx, alice_private_key );
+      db->push_transaction( tx, 0 );
+
+      BOOST_REQUIRE_EQUAL( payload_idx.size(), 2u );
+      BOOST_REQUIRE_EQUAL( content_idx.size(), 3u );
+      BOOST_REQUIRE_EQUAL( sequence_idx.size(), 4u );
+      auto app_sequence = sequence_idx.find( boost::make_tuple( uint8_t( custom_content_sequence_object::app_sequence ), account_name_type(), op.app_id ) );
+      BOOST_REQUIRE( app_sequence != sequence_idx.end() );
+      BOOST_REQUIRE_EQUAL( app_sequence->sequence, 2u );
+      auto alice_sequence = sequence_idx.find( boost::make_tuple( uint8_t( custom_content_sequence_object::sender_sequence ), AN("alice"), op.app_id ) );
+      BOOST_REQUIRE( alice_sequence != sequence_idx.end() );
+      BOOST_REQUIRE_EQUAL( alice_sequence->sequence, 2u );
+
+      validate_database();
+   }
+   FC_LOG_AND_RETHROW()
+}
+
 BOOST_AUTO_TEST_CASE( feed_publish_validate )
 {
    try